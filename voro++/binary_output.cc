@@ -0,0 +1,174 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file binary_output.cc
+ * \brief Function implementations for the npy_file and binary_output classes.
+ */
+
+#include <cstring>
+#include <string>
+
+#include "binary_output.hh"
+
+namespace voro {
+
+/** The class constructor opens the file and reserves space for the header.
+ * \param[in] filename the name of the file to write to.
+ * \param[in] type_ the type of the values, which is 'i' for integers, 'l' for
+ *                 array offsets, and 'd' for floating point numbers.
+ * \param[in] width_ the number of columns, or 1 for a one-dimensional array. */
+npy_file::npy_file(const char *filename,char type_,int width_) :
+	fp(safe_fopen(filename,"wb")), ob(fp), type(type_), width(width_), ne(0) {
+	char h[npy_header_size];
+	memset(h,' ',npy_header_size);
+	ob.put(h,npy_header_size);
+}
+
+/** The class destructor writes out the remaining values, fills in the header,
+ * and closes the file. */
+npy_file::~npy_file() {
+	ob.flush();
+	write_header();
+	fclose(fp);
+}
+
+/** Writes the header of the file, which records the type and shape of the
+ * array. */
+void npy_file::write_header() {
+	const int one=1;
+	char h[npy_header_size],sh[32];
+	int l;
+
+	// Assemble the shape of the array, and the description of its type,
+	// which begins with a character giving the byte order
+	if(width==1) sprintf(sh,"(%lld,)",ne);
+	else sprintf(sh,"(%lld, %d)",ne/width,width);
+	l=sprintf(h+10,"{'descr': '%c%c%d', 'fortran_order': False, 'shape': %s, }",
+		  *reinterpret_cast<const char*>(&one)==1?'<':'>',type=='d'?'f':'i',
+		  type=='i'?int(sizeof(int)):8,sh)+10;
+
+	// Write the magic string and version number, and then pad the header
+	// with spaces so that the data starts at a multiple of 64 bytes
+	memcpy(h,"\x93NUMPY\x01\x00",8);
+	h[8]=(npy_header_size-10)&255;h[9]=(npy_header_size-10)>>8;
+	memset(h+l,' ',npy_header_size-1-l);
+	h[npy_header_size-1]='\n';
+	if(fseek(fp,0,SEEK_SET)!=0||fwrite(h,1,npy_header_size,fp)!=size_t(npy_header_size))
+		voro_fatal_error("File write error",VOROPP_FILE_ERROR);
+}
+
+const char *binary_output::letters="iqrwpPsFvcCafelnt";
+
+/** The class constructor opens the files for the chosen quantities.
+ * \param[in] columns a string containing the letters of the quantities to
+ *                    write. Percent signs and spaces are ignored, so a
+ *                    custom output format string of control sequences can
+ *                    also be used.
+ * \param[in] prefix the prefix of the filenames to write to. */
+binary_output::binary_output(const char *columns,const char *prefix) :
+	vo(NULL), fo(NULL), fvo(NULL), tv(0), tf(0), tfv(0) {
+	static const char *names[n_columns]={"id","position","radius",
+		"vertex_count","vertices","vertices_global","face_count",
+		"surface_area","volume","centroid","centroid_global",
+		"face_orders","face_areas","face_perimeters","normals",
+		"neighbors","face_vertices"};
+	static const char types[n_columns+1]="iddiddiddddidddii";
+	static const int widths[n_columns]={1,3,1,1,3,3,1,1,1,3,3,1,1,1,3,1,1};
+	std::string fmt,fn;
+	const char *cp;
+	int k;
+	for(k=0;k<n_columns;k++) nf[k]=NULL;
+
+	// Open a file for each of the chosen quantities, and assemble a
+	// custom format string that requests them
+	for(cp=columns;*cp!=0;cp++) {
+		if(*cp=='%'||*cp==' ') continue;
+		const char *lp=strchr(letters,*cp);
+		if(lp==NULL) voro_fatal_error("Unknown quantity in binary output",VOROPP_FILE_ERROR);
+		k=lp-letters;
+		if(nf[k]!=NULL) continue;
+		fn=std::string(prefix)+"_"+names[k]+".npy";
+		nf[k]=new npy_file(fn.c_str(),types[k],widths[k]);
+		fmt+='%';fmt+=*cp;
+	}
+	cf=new custom_format(fmt.c_str());
+	neighbor=cf->neighbor;
+
+	// Open the offset tables that are needed for the ragged arrays
+	if(nf[4]!=NULL||nf[5]!=NULL) {
+		vo=new npy_file((std::string(prefix)+"_vertex_offsets.npy").c_str(),'l',1);
+		vo->put_offset(0);
+	}
+	for(k=11;k<n_columns;k++) if(nf[k]!=NULL) {
+		fo=new npy_file((std::string(prefix)+"_face_offsets.npy").c_str(),'l',1);
+		fo->put_offset(0);
+		break;
+	}
+	if(nf[16]!=NULL) {
+		fvo=new npy_file((std::string(prefix)+"_face_vertex_offsets.npy").c_str(),'l',1);
+		fvo->put_offset(0);
+	}
+}
+
+/** The class destructor completes and closes all of the files. */
+binary_output::~binary_output() {
+	for(int k=0;k<n_columns;k++) if(nf[k]!=NULL) delete nf[k];
+	if(vo!=NULL) delete vo;
+	if(fo!=NULL) delete fo;
+	if(fvo!=NULL) delete fvo;
+	delete cf;
+}
+
+/** Writes the chosen quantities for a Voronoi cell.
+ * \param[in] c the Voronoi cell to output.
+ * \param[in] i the ID of the particle associated with the cell.
+ * \param[in] (x,y,z) the position of the particle.
+ * \param[in] r the radius of the particle. */
+template<class v_cell>
+void binary_output::output(v_cell &c,int i,double x,double y,double z,double r) {
+	unsigned int j,l;
+	double *ptsp,*pe=c.pts+3*c.p;
+	if(cf->fl!=0) cf->face_traversal(c);
+	if(nf[0]!=NULL) nf[0]->put_int(i);
+	if(nf[1]!=NULL) {nf[1]->put_double(x);nf[1]->put_double(y);nf[1]->put_double(z);}
+	if(nf[2]!=NULL) nf[2]->put_double(r);
+	if(nf[3]!=NULL) nf[3]->put_int(c.p);
+	if(nf[4]!=NULL) for(ptsp=c.pts;ptsp<pe;ptsp+=3) {
+		nf[4]->put_double(*ptsp*0.5);
+		nf[4]->put_double(ptsp[1]*0.5);
+		nf[4]->put_double(ptsp[2]*0.5);
+	}
+	if(nf[5]!=NULL) for(ptsp=c.pts;ptsp<pe;ptsp+=3) {
+		nf[5]->put_double(x+*ptsp*0.5);
+		nf[5]->put_double(y+ptsp[1]*0.5);
+		nf[5]->put_double(z+ptsp[2]*0.5);
+	}
+	if(nf[6]!=NULL) nf[6]->put_int(cf->nf);
+	if(nf[7]!=NULL) nf[7]->put_double(0.125*cf->sa);
+	if(nf[8]!=NULL) nf[8]->put_double(cf->vol*(1/48.0));
+	if(nf[9]!=NULL) {nf[9]->put_double(cf->cx);nf[9]->put_double(cf->cy);nf[9]->put_double(cf->cz);}
+	if(nf[10]!=NULL) {nf[10]->put_double(x+cf->cx);nf[10]->put_double(y+cf->cy);nf[10]->put_double(z+cf->cz);}
+	if(nf[11]!=NULL) for(j=0;j<cf->fo.size();j++) nf[11]->put_int(cf->fo[j]);
+	if(nf[12]!=NULL) for(j=0;j<cf->fa.size();j++) nf[12]->put_double(cf->fa[j]);
+	if(nf[13]!=NULL) for(j=0;j<cf->fp.size();j++) nf[13]->put_double(cf->fp[j]);
+	if(nf[14]!=NULL) for(j=0;j<cf->nv.size();j++) nf[14]->put_double(cf->nv[j]);
+	if(nf[15]!=NULL) for(j=0;j<cf->fn.size();j++) nf[15]->put_int(cf->fn[j]);
+	if(nf[16]!=NULL) for(j=0;j<cf->fv.size();j+=l+1) {
+		l=cf->fv[j];
+		for(unsigned int q=j+1;q<=j+l;q++) nf[16]->put_int(cf->fv[q]);
+		fvo->put_offset(tfv+=l);
+	}
+
+	// Extend the offset tables
+	if(vo!=NULL) vo->put_offset(tv+=c.p);
+	if(fo!=NULL) fo->put_offset(tf+=cf->nf);
+}
+
+// Explicit instantiation
+template void binary_output::output(voronoicell&,int,double,double,double,double);
+template void binary_output::output(voronoicell_neighbor&,int,double,double,double,double);
+
+}
@@ -0,0 +1,149 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file binary_output.hh
+ * \brief Header file for the npy_file and binary_output classes. */
+
+#ifndef VOROPP_BINARY_OUTPUT_HH
+#define VOROPP_BINARY_OUTPUT_HH
+
+#include <cstdio>
+
+#include "config.hh"
+#include "common.hh"
+#include "cell.hh"
+#include "custom_format.hh"
+
+namespace voro {
+
+/** \brief A class for writing a single array to a file in the NumPy .npy
+ * format.
+ *
+ * This class writes a one-dimensional array, or a two-dimensional array with a
+ * fixed number of columns, to a file in version 1.0 of the NumPy .npy format.
+ * Since the number of rows is not known in advance, a header of fixed size is
+ * reserved when the file is opened and filled in when it is closed. The values
+ * are written in the native byte order, which is recorded in the header. */
+class npy_file {
+	public:
+		npy_file(const char *filename,char type_,int width_);
+		~npy_file();
+		/** Adds an integer to the array.
+		 * \param[in] n the integer to add. */
+		inline void put_int(int n) {
+			ob.put(reinterpret_cast<const char*>(&n),sizeof(int));ne++;
+		}
+		/** Adds an array offset to the array.
+		 * \param[in] n the offset to add. */
+		inline void put_offset(long long n) {
+			ob.put(reinterpret_cast<const char*>(&n),sizeof(long long));ne++;
+		}
+		/** Adds a floating point number to the array.
+		 * \param[in] x the number to add. */
+		inline void put_double(double x) {
+			ob.put(reinterpret_cast<const char*>(&x),sizeof(double));ne++;
+		}
+	private:
+		/** The file handle to write to. */
+		FILE *fp;
+		/** The buffer used for writing to the file. */
+		voro_out_buffer ob;
+		/** The type of the values, which is 'i' for integers, 'l' for
+		 * array offsets, and 'd' for floating point numbers. */
+		const char type;
+		/** The number of columns, or 1 for a one-dimensional array.
+		 */
+		const int width;
+		/** The number of values that have been written. */
+		long long ne;
+		void write_header();
+		npy_file(const npy_file&);
+		npy_file& operator=(const npy_file&);
+};
+
+/** \brief A class for writing per-cell quantities to binary column files.
+ *
+ * This class writes a chosen set of per-cell quantities to a collection of
+ * NumPy .npy files, one for each quantity, which share a common filename
+ * prefix. The quantities are chosen with the same letters as in the custom
+ * output format, and are written to the following files, where n is the number
+ * of cells, F is the total number of faces, and V is the total number of
+ * vertices:
+ *
+ * - 'i': prefix_id.npy, the particle IDs, as n integers.
+ * - 'q': prefix_position.npy, the particle positions, as an n by 3 array.
+ * - 'r': prefix_radius.npy, the particle radii, as n doubles.
+ * - 'w': prefix_vertex_count.npy, the number of vertices, as n integers.
+ * - 'p': prefix_vertices.npy, the vertex positions relative to the particle,
+ *   as a V by 3 array.
+ * - 'P': prefix_vertices_global.npy, the vertex positions in the global
+ *   coordinate system, as a V by 3 array.
+ * - 's': prefix_face_count.npy, the number of faces, as n integers.
+ * - 'F': prefix_surface_area.npy, the surface areas, as n doubles.
+ * - 'v': prefix_volume.npy, the volumes, as n doubles.
+ * - 'c': prefix_centroid.npy, the centroids relative to the particle, as an
+ *   n by 3 array.
+ * - 'C': prefix_centroid_global.npy, the centroids in the global coordinate
+ *   system, as an n by 3 array.
+ * - 'a': prefix_face_orders.npy, the number of edges of each face, as F
+ *   integers.
+ * - 'f': prefix_face_areas.npy, the areas of each face, as F doubles.
+ * - 'e': prefix_face_perimeters.npy, the perimeters of each face, as F
+ *   doubles.
+ * - 'l': prefix_normals.npy, the unit normals of each face, as an F by 3
+ *   array.
+ * - 'n': prefix_neighbors.npy, the neighboring particle IDs of each face, as
+ *   F integers.
+ * - 't': prefix_face_vertices.npy, the vertex indices of each face, relative
+ *   to the first vertex of the cell, given one face after another.
+ *
+ * The per-vertex and per-face arrays are ragged, and are indexed by offset
+ * tables of 64-bit integers. The vertices of cell k are rows vertex_offsets[k]
+ * to vertex_offsets[k+1]-1 of the vertex arrays, in prefix_vertex_offsets.npy,
+ * and the faces of cell k are entries face_offsets[k] to face_offsets[k+1]-1
+ * of the face arrays, in prefix_face_offsets.npy. The vertex indices of face f
+ * are entries face_vertex_offsets[f] to face_vertex_offsets[f+1]-1 of the
+ * face vertex array, in prefix_face_vertex_offsets.npy. Each offset table
+ * begins with a zero. */
+class binary_output {
+	public:
+		/** Whether neighbor information is required, which is the case
+		 * if the neighbors are written. */
+		bool neighbor;
+		binary_output(const char *columns,const char *prefix);
+		~binary_output();
+		template<class v_cell>
+		void output(v_cell &c,int i,double x,double y,double z,double r);
+	private:
+		/** The letters of the quantities that can be written. */
+		static const char *letters;
+		/** The number of quantities that can be written. */
+		static const int n_columns=17;
+		/** The custom format class used to compute the per-face
+		 * quantities. */
+		custom_format *cf;
+		/** The files for each of the quantities, which are NULL for
+		 * quantities that are not being written. */
+		npy_file *nf[n_columns];
+		/** The file for the vertex offset table. */
+		npy_file *vo;
+		/** The file for the face offset table. */
+		npy_file *fo;
+		/** The file for the face vertex offset table. */
+		npy_file *fvo;
+		/** The total number of vertices written so far. */
+		long long tv;
+		/** The total number of faces written so far. */
+		long long tf;
+		/** The total number of face vertex indices written so far. */
+		long long tfv;
+		binary_output(const binary_output&);
+		binary_output& operator=(const binary_output&);
+};
+
+}
+
+#endif
@@ -7,6 +7,8 @@
 /** \file c_loops.cc
  * \brief Function implementations for the loop classes. */
 
+#include <algorithm>
+
 #include "c_loops.hh"
 
 namespace voro {
@@ -139,6 +141,25 @@ bool c_loop_subset::next_block() {
 	} else return false;
 }
 
+/** Reads the next batch of entries from the ordering class and sorts them by
+ * block, recording their original positions.
+ * \return True if there are any entries in the batch, false if the end of the
+ * ordering has been reached. */
+bool c_loop_order_sorted::next_batch() {
+	int l,n=int(vo.op-cp)>>1;
+	bi+=bn;
+	if(n==0) return false;
+	if(n>batch_size) n=batch_size;
+	ent.resize(n);
+	for(l=0;l<n;l++) {
+		ent[l].ijk=*(cp++);ent[l].q=*(cp++);ent[l].r=l;
+	}
+	std::sort(ent.begin(),ent.end());
+	bn=n;ep=0;
+	set_current();
+	return true;
+}
+
 /** Extends the memory available for storing the ordering. */
 void particle_order::add_ordering_memory() {
 	int *no=new int[size<<2],*nop=no,*opp=o;
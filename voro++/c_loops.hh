@@ -10,6 +10,8 @@
 #ifndef VOROPP_C_LOOPS_HH
 #define VOROPP_C_LOOPS_HH
 
+#include <vector>
+
 #include "config.hh"
 
 namespace voro {
@@ -68,6 +70,49 @@ class particle_order {
 		void add_ordering_memory();
 };
 
+/** \brief A class for looking up the location of a particle in a container
+ * from its ID.
+ *
+ * This class stores the block and the position within the block of every
+ * particle visited by a loop class, in a table indexed by particle ID. It is
+ * used by the compute_cell routines that take a list of candidate neighbors
+ * by ID. The table has an entry for every ID up to the largest one, so it is
+ * intended for particles with non-negative IDs that are numbered roughly
+ * consecutively. It must be rebuilt whenever particles are added to or
+ * removed from the container, and it keeps its memory allocation so that it
+ * can be rebuilt for a sequence of frames. */
+class particle_lookup {
+	public:
+		/** Fills the table with the particles visited by a loop class.
+		 * \param[in] vl the loop class to use. */
+		template<class c_loop>
+		void build(c_loop &vl) {
+			int pid;
+			for(std::vector<int>::iterator lp=loc.begin();lp!=loc.end();lp++) *lp=-1;
+			if(vl.start()) do {
+				pid=vl.pid();
+				if(pid<0) continue;
+				if(2*pid>=int(loc.size())) loc.resize(2*pid+2,-1);
+				loc[2*pid]=vl.ijk;loc[2*pid+1]=vl.q;
+			} while(vl.inc());
+		}
+		/** Finds the location of a particle.
+		 * \param[in] pid the ID of the particle.
+		 * \param[out] (ijk,q) the block that the particle is within,
+		 *                     and its index within the block.
+		 * \return True if the particle is in the table, false
+		 *         otherwise. */
+		inline bool find(int pid,int &ijk,int &q) const {
+			if(pid<0||2*pid>=int(loc.size())||loc[2*pid]<0) return false;
+			ijk=loc[2*pid];q=loc[2*pid+1];
+			return true;
+		}
+	private:
+		/** The block and index of each particle, indexed by twice the
+		 * particle ID, or -1 for IDs that are not present. */
+		std::vector<int> loc;
+};
+
 /** \brief Base class for looping over particles in a container.
  *
  * This class forms the base of all classes that can loop over a subset of
@@ -316,6 +361,105 @@ class c_loop_order : public c_loop_base {
 		}
 };
 
+/** \brief Class for looping over all of the particles specified in a
+ * pre-assembled particle_order class, visiting them in block order.
+ *
+ * The c_loop_order class visits particles in the order that they were stored,
+ * which for randomly ordered input means that successive cell computations
+ * access unrelated parts of the container. This class instead reads the
+ * ordering in batches, and visits the particles within each batch sorted by
+ * block, so that successive computations reuse the same nearby memory. The
+ * rank() function gives the original position of the current particle within
+ * its batch, so that results can be put back into the original order. The
+ * print_custom routines of the container classes do this automatically when
+ * they are passed this loop class; other routines will produce output in the
+ * sorted order. */
+class c_loop_order_sorted : public c_loop_base {
+	public:
+		/** A reference to the ordering class to use. */
+		particle_order &vo;
+		/** The maximum number of particles in each batch. */
+		const int batch_size;
+		/** The constructor copies several necessary constants from the
+		 * base class, and sets up a reference to the ordering class to
+		 * use.
+		 * \param[in] con the container class to use.
+		 * \param[in] vo_ the ordering class to use.
+		 * \param[in] batch_size_ the maximum number of particles in
+		 *                        each batch. */
+		template<class c_class>
+		c_loop_order_sorted(c_class &con,particle_order &vo_,int batch_size_=default_order_batch)
+		: c_loop_base(con), vo(vo_), batch_size(batch_size_), nx(con.nx), nxy(con.nxy) {}
+		/** Sets the class to consider the first particle.
+		 * \return True if there is any particle to consider, false
+		 * otherwise. */
+		inline bool start() {
+			cp=vo.o;
+			bi=0;bn=0;
+			return next_batch();
+		}
+		/** Finds the next particle to test.
+		 * \return True if there is another particle, false if no more
+		 * particles are available. */
+		inline bool inc() {
+			if(++ep==bn) return next_batch();
+			set_current();
+			return true;
+		}
+		/** Returns the original position of the current particle
+		 * within its batch. */
+		inline int rank() {return ent[ep].r;}
+		/** Returns the original position of the current particle
+		 * within the whole ordering. */
+		inline int index() {return bi+ent[ep].r;}
+		/** Returns whether the current particle is the last one to be
+		 * visited in its batch. */
+		inline bool last_in_batch() {return ep+1==bn;}
+	private:
+		/** \brief An entry of the ordering, together with its original
+		 * position within the batch. */
+		struct order_entry {
+			/** The block that the particle is within. */
+			int ijk;
+			/** The position of the particle within the block. */
+			int q;
+			/** The original position of the entry in the batch. */
+			int r;
+			/** Compares two entries by block and then by position.
+			 * \param[in] o the entry to compare to. */
+			inline bool operator<(const order_entry &o) const {
+				return ijk!=o.ijk?ijk<o.ijk:(q!=o.q?q<o.q:r<o.r);
+			}
+		};
+		/** The number of computational blocks in the x direction. */
+		const int nx;
+		/** The number of computational blocks in a z-slice. */
+		const int nxy;
+		/** A pointer to the next unread position in the ordering
+		 * class. */
+		int *cp;
+		/** The original position of the first particle of the current
+		 * batch within the whole ordering. */
+		int bi;
+		/** The number of particles in the current batch. */
+		int bn;
+		/** The index of the current entry in the sorted batch. */
+		int ep;
+		/** The sorted entries of the current batch. */
+		std::vector<order_entry> ent;
+		bool next_batch();
+		/** Sets the loop variables from the current sorted entry, and
+		 * computes the indices of its block in the x, y, and z
+		 * directions. */
+		inline void set_current() {
+			ijk=ent[ep].ijk;q=ent[ep].q;
+			k=ijk/nxy;
+			int ijkt=ijk-nxy*k;
+			j=ijkt/nx;
+			i=ijkt-j*nx;
+		}
+};
+
 /** \brief A class for looping over all particles in a container_periodic or
  * container_periodic_poly class.
  *
@@ -24,9 +24,13 @@ voronoicell_base::voronoicell_base() :
 	pts(new double[3*current_vertices]), mem(new int[current_vertex_order]),
 	mec(new int[current_vertex_order]), mep(new int*[current_vertex_order]),
 	ds(new int[current_delete_size]), stacke(ds+current_delete_size),
-	ds2(new int[current_delete2_size]), stacke2(ds2+current_delete_size),
-	current_marginal(init_marginal), marg(new int[current_marginal]) {
+	ds2(new int[current_delete2_size]), stacke2(ds2+current_delete2_size),
+	current_marginal(init_marginal), marg(new int[current_marginal]),
+	current_mark_vertices(init_vertices), current_marks(3*init_vertices),
+	eo(new int[current_mark_vertices]), em(new unsigned int[current_marks]),
+	epoch(0) {
 	int i;
+	memset(em,0,current_marks*sizeof(unsigned int));
 	for(i=0;i<3;i++) {
 		mem[i]=init_n_vertices;mec[i]=0;
 		mep[i]=new int[init_n_vertices*((i<<1)+1)];
@@ -42,6 +46,7 @@ voronoicell_base::voronoicell_base() :
 /** The voronoicell destructor deallocates all the dynamic memory. */
 voronoicell_base::~voronoicell_base() {
 	for(int i=current_vertex_order-1;i>=0;i--) if(mem[i]>0) delete [] mep[i];
+	delete [] em;delete [] eo;
 	delete [] marg;
 	delete [] ds2;delete [] ds;
 	delete [] mep;delete [] mec;
@@ -366,11 +371,14 @@ void voronoicell_base::construct_relations() {
  * \param[in,out] up */
 template<class vc_class>
 inline bool voronoicell_base::search_for_outside_edge(vc_class &vc,int &up) {
-	int i,lp,lw,*j(ds2),*stackp2(ds2);
+	int i,lp,lw,j=0,*stackp2(ds2);
 	double l;
 	*(stackp2++)=up;
-	while(j<stackp2) {
-		up=*(j++);
+
+	// The stack is indexed by position rather than by pointer, since
+	// add_to_stack may reallocate it
+	while(ds2+j<stackp2) {
+		up=ds2[j++];
 		for(i=0;i<nu[up];i++) {
 			lp=ed[up][i];
 			lw=m_test(lp,l);
@@ -1301,19 +1309,20 @@ double voronoicell_base::volume() {
 	double vol=0;
 	int i,j,k,l,m,n;
 	double ux,uy,uz,vx,vy,vz,wx,wy,wz;
+	start_traversal();
 	for(i=1;i<p;i++) {
 		ux=*pts-pts[3*i];
 		uy=pts[1]-pts[3*i+1];
 		uz=pts[2]-pts[3*i+2];
 		for(j=0;j<nu[i];j++) {
-			k=ed[i][j];
-			if(k>=0) {
-				ed[i][j]=-1-k;
+			if(!edge_marked(i,j)) {
+				k=ed[i][j];
+				mark_edge(i,j);
 				l=cycle_up(ed[i][nu[i]+j],k);
 				vx=pts[3*k]-*pts;
 				vy=pts[3*k+1]-pts[1];
 				vz=pts[3*k+2]-pts[2];
-				m=ed[k][l];ed[k][l]=-1-m;
+				m=ed[k][l];mark_edge(k,l);
 				while(m!=i) {
 					n=cycle_up(ed[k][nu[k]+l],m);
 					wx=pts[3*m]-*pts;
@@ -1321,12 +1330,11 @@ double voronoicell_base::volume() {
 					wz=pts[3*m+2]-pts[2];
 					vol+=ux*vy*wz+uy*vz*wx+uz*vx*wy-uz*vy*wx-uy*vx*wz-ux*vz*wy;
 					k=m;l=n;vx=wx;vy=wy;vz=wz;
-					m=ed[k][l];ed[k][l]=-1-m;
+					m=ed[k][l];mark_edge(k,l);
 				}
 			}
 		}
 	}
-	reset_edges();
 	return vol*fe;
 }
 
@@ -1338,13 +1346,14 @@ void voronoicell_base::face_areas(std::vector<double> &v) {
 	v.clear();
 	int i,j,k,l,m,n;
 	double ux,uy,uz,vx,vy,vz,wx,wy,wz;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			area=0;
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
-			m=ed[k][l];ed[k][l]=-1-m;
+			m=ed[k][l];mark_edge(k,l);
 			while(m!=i) {
 				n=cycle_up(ed[k][nu[k]+l],m);
 				ux=pts[3*k]-pts[3*i];
@@ -1358,12 +1367,11 @@ void voronoicell_base::face_areas(std::vector<double> &v) {
 				wz=ux*vy-uy*vx;
 				area+=sqrt(wx*wx+wy*wy+wz*wz);
 				k=m;l=n;
-				m=ed[k][l];ed[k][l]=-1-m;
+				m=ed[k][l];mark_edge(k,l);
 			}
 			v.push_back(0.125*area);
 		}
 	}
-	reset_edges();
 }
 
 
@@ -1373,12 +1381,13 @@ double voronoicell_base::surface_area() {
 	double area=0;
 	int i,j,k,l,m,n;
 	double ux,uy,uz,vx,vy,vz,wx,wy,wz;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
-			ed[i][j]=-1-k;
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
-			m=ed[k][l];ed[k][l]=-1-m;
+			m=ed[k][l];mark_edge(k,l);
 			while(m!=i) {
 				n=cycle_up(ed[k][nu[k]+l],m);
 				ux=pts[3*k]-pts[3*i];
@@ -1392,11 +1401,10 @@ double voronoicell_base::surface_area() {
 				wz=ux*vy-uy*vx;
 				area+=sqrt(wx*wx+wy*wy+wz*wz);
 				k=m;l=n;
-				m=ed[k][l];ed[k][l]=-1-m;
+				m=ed[k][l];mark_edge(k,l);
 			}
 		}
 	}
-	reset_edges();
 	return 0.125*area;
 }
 
@@ -1409,19 +1417,20 @@ void voronoicell_base::centroid(double &cx,double &cy,double &cz) {
 	double tvol,vol=0;cx=cy=cz=0;
 	int i,j,k,l,m,n;
 	double ux,uy,uz,vx,vy,vz,wx,wy,wz;
+	start_traversal();
 	for(i=1;i<p;i++) {
 		ux=*pts-pts[3*i];
 		uy=pts[1]-pts[3*i+1];
 		uz=pts[2]-pts[3*i+2];
 		for(j=0;j<nu[i];j++) {
-			k=ed[i][j];
-			if(k>=0) {
-				ed[i][j]=-1-k;
+			if(!edge_marked(i,j)) {
+				k=ed[i][j];
+				mark_edge(i,j);
 				l=cycle_up(ed[i][nu[i]+j],k);
 				vx=pts[3*k]-*pts;
 				vy=pts[3*k+1]-pts[1];
 				vz=pts[3*k+2]-pts[2];
-				m=ed[k][l];ed[k][l]=-1-m;
+				m=ed[k][l];mark_edge(k,l);
 				while(m!=i) {
 					n=cycle_up(ed[k][nu[k]+l],m);
 					wx=pts[3*m]-*pts;
@@ -1433,12 +1442,11 @@ void voronoicell_base::centroid(double &cx,double &cy,double &cz) {
 					cy+=(wy+vy-uy)*tvol;
 					cz+=(wz+vz-uz)*tvol;
 					k=m;l=n;vx=wx;vy=wy;vz=wz;
-					m=ed[k][l];ed[k][l]=-1-m;
+					m=ed[k][l];mark_edge(k,l);
 				}
 			}
 		}
 	}
-	reset_edges();
 	if(vol>tolerance_sq) {
 		vol=0.125/vol;
 		cx=cx*vol+0.5*(*pts);
@@ -1501,32 +1509,87 @@ void voronoicell_base::draw_pov(double x,double y,double z,FILE* fp) {
 	}
 }
 
+/** Outputs the edges of the Voronoi cell in POV-Ray format to an output
+ * buffer, displacing the cell by given vector. The output is the same as that
+ * of the version that writes to a file stream.
+ * \param[in] (x,y,z) a displacement vector to be added to the cell's position.
+ * \param[in] ob the buffer to write to. */
+void voronoicell_base::draw_pov(double x,double y,double z,voro_out_buffer &ob) {
+	int i,j,k,l1,l2;double *ptsp=pts,*pt2;
+	char posbuf1[128],posbuf2[128];
+	for(i=0;i<p;i++,ptsp+=3) {
+		l1=sprintf(posbuf1,"%g,%g,%g",x+*ptsp*0.5,y+ptsp[1]*0.5,z+ptsp[2]*0.5);
+		ob.put("sphere{<",8);ob.put(posbuf1,l1);ob.put(">,r}\n",5);
+		for(j=0;j<nu[i];j++) {
+			k=ed[i][j];
+			if(k<i) {
+				pt2=pts+3*k;
+				l2=sprintf(posbuf2,"%g,%g,%g",x+*pt2*0.5,y+0.5*pt2[1],z+0.5*pt2[2]);
+				if(strcmp(posbuf1,posbuf2)!=0) {
+					ob.put("cylinder{<",10);ob.put(posbuf1,l1);
+					ob.put(">,<",3);ob.put(posbuf2,l2);ob.put(">,r}\n",5);
+				}
+			}
+		}
+	}
+}
+
 /** Outputs the edges of the Voronoi cell in gnuplot format to an output stream.
  * \param[in] (x,y,z) a displacement vector to be added to the cell's position.
  * \param[in] fp a file handle to write to. */
 void voronoicell_base::draw_gnuplot(double x,double y,double z,FILE *fp) {
 	int i,j,k,l,m;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			fprintf(fp,"%g %g %g\n",x+0.5*pts[3*i],y+0.5*pts[3*i+1],z+0.5*pts[3*i+2]);
 			l=i;m=j;
 			do {
-				ed[k][ed[l][nu[l]+m]]=-1-l;
-				ed[l][m]=-1-k;
+				mark_edge(k,ed[l][nu[l]+m]);
+				mark_edge(l,m);
 				l=k;
 				fprintf(fp,"%g %g %g\n",x+0.5*pts[3*k],y+0.5*pts[3*k+1],z+0.5*pts[3*k+2]);
 			} while (search_edge(l,m,k));
 			fputs("\n\n",fp);
 		}
 	}
-	reset_edges();
+}
+
+/** Outputs the edges of the Voronoi cell in gnuplot format to an output
+ * buffer. The output is the same as that of the version that writes to a file
+ * stream.
+ * \param[in] (x,y,z) a displacement vector to be added to the cell's position.
+ * \param[in] ob the buffer to write to. */
+void voronoicell_base::draw_gnuplot(double x,double y,double z,voro_out_buffer &ob) {
+	int i,j,k,l,m;
+	start_traversal();
+	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
+			ob.put_double(x+0.5*pts[3*i]);ob.put(' ');
+			ob.put_double(y+0.5*pts[3*i+1]);ob.put(' ');
+			ob.put_double(z+0.5*pts[3*i+2]);ob.put('\n');
+			l=i;m=j;
+			do {
+				mark_edge(k,ed[l][nu[l]+m]);
+				mark_edge(l,m);
+				l=k;
+				ob.put_double(x+0.5*pts[3*k]);ob.put(' ');
+				ob.put_double(y+0.5*pts[3*k+1]);ob.put(' ');
+				ob.put_double(z+0.5*pts[3*k+2]);ob.put('\n');
+			} while (search_edge(l,m,k));
+			ob.put("\n\n",2);
+		}
+	}
 }
 
 inline bool voronoicell_base::search_edge(int l,int &m,int &k) {
 	for(m=0;m<nu[l];m++) {
-		k=ed[l][m];
-		if(k>=0) return true;
+		if(!edge_marked(l,m)) {
+			k=ed[l][m];
+			return true;
+		}
 	}
 	return false;
 }
@@ -1545,35 +1608,49 @@ void voronoicell_base::draw_pov_mesh(double x,double y,double z,FILE *fp) {
 	fprintf(fp,"mesh2 {\nvertex_vectors {\n%d\n",p);
 	for(i=0;i<p;i++,ptsp+=3) fprintf(fp,",<%g,%g,%g>\n",x+*ptsp*0.5,y+ptsp[1]*0.5,z+ptsp[2]*0.5);
 	fprintf(fp,"}\nface_indices {\n%d\n",(p-2)<<1);
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
-			ed[i][j]=-1-k;
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
-			m=ed[k][l];ed[k][l]=-1-m;
+			m=ed[k][l];mark_edge(k,l);
 			while(m!=i) {
 				n=cycle_up(ed[k][nu[k]+l],m);
 				fprintf(fp,",<%d,%d,%d>\n",i,k,m);
 				k=m;l=n;
-				m=ed[k][l];ed[k][l]=-1-m;
+				m=ed[k][l];mark_edge(k,l);
 			}
 		}
 	}
 	fputs("}\ninside_vector <0,0,1>\n}\n",fp);
-	reset_edges();
 }
 
-/** Several routines in the class that gather cell-based statistics internally
- * track their progress by flipping edges to negative so that they know what
- * parts of the cell have already been tested. This function resets them back
- * to positive. When it is called, it assumes that every edge in the routine
- * should have already been flipped to negative, and it bails out with an
- * internal error if it encounters a positive edge. */
-inline void voronoicell_base::reset_edges() {
-	int i,j;
-	for(i=0;i<p;i++) for(j=0;j<nu[i];j++) {
-		if(ed[i][j]>=0) voro_fatal_error("Edge reset routine found a previously untested edge",VOROPP_INTERNAL_ERROR);
-		ed[i][j]=-1-ed[i][j];
+/** Starts a traversal of the cell, in which the routines that gather
+ * statistics mark each edge as they visit it. Each vertex is assigned a range
+ * of entries in the em array, and a new epoch is started, so that the marks
+ * left by previous traversals are discarded without having to clear them. The
+ * edge table itself is not modified. */
+void voronoicell_base::start_traversal() {
+	int i,s=0;
+	if(p>current_mark_vertices) {
+		do current_mark_vertices<<=1; while(p>current_mark_vertices);
+		delete [] eo;
+		eo=new int[current_mark_vertices];
+	}
+	for(i=0;i<p;i++) {eo[i]=s;s+=nu[i];}
+	if(s>current_marks) {
+		do current_marks<<=1; while(s>current_marks);
+		delete [] em;
+		em=new unsigned int[current_marks];
+		memset(em,0,current_marks*sizeof(unsigned int));
+	}
+
+	// If the epoch counter wraps around, then clear the marks, since
+	// some of them may match the new epoch
+	if(++epoch==0) {
+		memset(em,0,current_marks*sizeof(unsigned int));
+		epoch=1;
 	}
 }
 
@@ -1637,13 +1714,11 @@ int voronoicell_base::check_marginal(int n,double &ans) {
  * that plane.
  * \param[out] v the vector to store the results in. */
 void voronoicell_base::normals(std::vector<double> &v) {
-	int i,j,k;
+	int i,j;
 	v.clear();
-	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) normals_search(v,i,j,k);
-	}
-	reset_edges();
+	start_traversal();
+	for(i=1;i<p;i++) for(j=0;j<nu[i];j++)
+		if(!edge_marked(i,j)) normals_search(v,i,j,ed[i][j]);
 }
 
 /** This inline routine is called by normals(). It attempts to construct a
@@ -1658,11 +1733,11 @@ void voronoicell_base::normals(std::vector<double> &v) {
  * \param[in] j the index of an edge of the vertex.
  * \param[in] k the neighboring vertex of i, set to ed[i][j]. */
 inline void voronoicell_base::normals_search(std::vector<double> &v,int i,int j,int k) {
-	ed[i][j]=-1-k;
+	mark_edge(i,j);
 	int l=cycle_up(ed[i][nu[i]+j],k),m;
 	double ux,uy,uz,vx,vy,vz,wx,wy,wz,wmag;
 	do {
-		m=ed[k][l];ed[k][l]=-1-m;
+		m=ed[k][l];mark_edge(k,l);
 		ux=pts[3*m]-pts[3*k];
 		uy=pts[3*m+1]-pts[3*k+1];
 		uz=pts[3*m+2]-pts[3*k+2];
@@ -1671,7 +1746,7 @@ inline void voronoicell_base::normals_search(std::vector<double> &v,int i,int j,
 		if(ux*ux+uy*uy+uz*uz>tolerance_sq) {
 			while(m!=i) {
 				l=cycle_up(ed[k][nu[k]+l],m);
-				k=m;m=ed[k][l];ed[k][l]=-1-m;
+				k=m;m=ed[k][l];mark_edge(k,l);
 				vx=pts[3*m]-pts[3*k];
 				vy=pts[3*m+1]-pts[3*k+1];
 				vz=pts[3*m+2]-pts[3*k+2];
@@ -1697,7 +1772,7 @@ inline void voronoicell_base::normals_search(std::vector<double> &v,int i,int j,
 					// face and exit
 					while(m!=i) {
 						l=cycle_up(ed[k][nu[k]+l],m);
-						k=m;m=ed[k][l];ed[k][l]=-1-m;
+						k=m;m=ed[k][l];mark_edge(k,l);
 					}
 					return;
 				}
@@ -1720,22 +1795,22 @@ inline void voronoicell_base::normals_search(std::vector<double> &v,int i,int j,
  * \return The number of faces. */
 int voronoicell_base::number_of_faces() {
 	int i,j,k,l,m,s=0;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			s++;
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
 
 		}
 	}
-	reset_edges();
 	return s;
 }
 
@@ -1808,14 +1883,15 @@ void voronoicell_base::face_perimeters(std::vector<double> &v) {
 	v.clear();
 	int i,j,k,l,m;
 	double dx,dy,dz,perim;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			dx=pts[3*k]-pts[3*i];
 			dy=pts[3*k+1]-pts[3*i+1];
 			dz=pts[3*k+2]-pts[3*i+2];
 			perim=sqrt(dx*dx+dy*dy+dz*dz);
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				m=ed[k][l];
@@ -1823,14 +1899,13 @@ void voronoicell_base::face_perimeters(std::vector<double> &v) {
 				dy=pts[3*m+1]-pts[3*k+1];
 				dz=pts[3*m+2]-pts[3*k+2];
 				perim+=sqrt(dx*dx+dy*dy+dz*dz);
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
 			v.push_back(0.5*perim);
 		}
 	}
-	reset_edges();
 }
 
 /** For each face, this routine outputs a bracketed sequence of numbers
@@ -1839,17 +1914,18 @@ void voronoicell_base::face_perimeters(std::vector<double> &v) {
 void voronoicell_base::face_vertices(std::vector<int> &v) {
 	int i,j,k,l,m,vp(0),vn;
 	v.clear();
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			v.push_back(0);
 			v.push_back(i);
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				v.push_back(k);
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
@@ -1858,7 +1934,6 @@ void voronoicell_base::face_vertices(std::vector<int> &v) {
 			vp=vn;
 		}
 	}
-	reset_edges();
 }
 
 /** Outputs a list of the number of edges in each face.
@@ -1866,23 +1941,23 @@ void voronoicell_base::face_vertices(std::vector<int> &v) {
 void voronoicell_base::face_orders(std::vector<int> &v) {
 	int i,j,k,l,m,q;
 	v.clear();
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			q=1;
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				q++;
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
 			v.push_back(q);;
 		}
 	}
-	reset_edges();
 }
 
 /** Computes the number of edges that each face has and outputs a frequency
@@ -1891,16 +1966,17 @@ void voronoicell_base::face_orders(std::vector<int> &v) {
 void voronoicell_base::face_freq_table(std::vector<int> &v) {
 	int i,j,k,l,m,q;
 	v.clear();
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			q=1;
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				q++;
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
@@ -1908,7 +1984,6 @@ void voronoicell_base::face_freq_table(std::vector<int> &v) {
 			v[q]++;
 		}
 	}
-	reset_edges();
 }
 
 /** This routine tests to see whether the cell intersects a plane by starting
@@ -2158,22 +2233,22 @@ void voronoicell_neighbor::init_tetrahedron(double x0,double y0,double z0,double
  * consistent. */
 void voronoicell_neighbor::check_facets() {
 	int i,j,k,l,m,q;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
-			ed[i][j]=-1-k;
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
+			mark_edge(i,j);
 			q=ne[i][j];
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				if(ne[k][l]!=q) fprintf(stderr,"Facet error at (%d,%d)=%d, started from (%d,%d)=%d\n",k,l,ne[k][l],i,j,q);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
 		}
 	}
-	reset_edges();
 }
 
 /** The class constructor allocates memory for storing neighbor information. */
@@ -2198,21 +2273,21 @@ voronoicell_neighbor::~voronoicell_neighbor() {
 void voronoicell_neighbor::neighbors(std::vector<int> &v) {
 	v.clear();
 	int i,j,k,l,m;
+	start_traversal();
 	for(i=1;i<p;i++) for(j=0;j<nu[i];j++) {
-		k=ed[i][j];
-		if(k>=0) {
+		if(!edge_marked(i,j)) {
+			k=ed[i][j];
 			v.push_back(ne[i][j]);
-			ed[i][j]=-1-k;
+			mark_edge(i,j);
 			l=cycle_up(ed[i][nu[i]+j],k);
 			do {
 				m=ed[k][l];
-				ed[k][l]=-1-m;
+				mark_edge(k,l);
 				l=cycle_up(ed[k][nu[k]+l],m);
 				k=m;
 			} while (k!=i);
 		}
 	}
-	reset_edges();
 }
 
 /** Prints the vertices, their edges, the relation table, and also notifies if
@@ -90,6 +90,7 @@ class voronoicell_base {
 		void init_tetrahedron_base(double x0,double y0,double z0,double x1,double y1,double z1,double x2,double y2,double z2,double x3,double y3,double z3);
 		void translate(double x,double y,double z);
 		void draw_pov(double x,double y,double z,FILE *fp=stdout);
+		void draw_pov(double x,double y,double z,voro_out_buffer &ob);
 		/** Outputs the cell in POV-Ray format, using cylinders for edges
 		 * and spheres for vertices, to a given file.
 		 * \param[in] (x,y,z) a displacement to add to the cell's
@@ -112,6 +113,7 @@ class voronoicell_base {
 			fclose(fp);
 		}
 		void draw_gnuplot(double x,double y,double z,FILE *fp=stdout);
+		void draw_gnuplot(double x,double y,double z,voro_out_buffer &ob);
 		/** Outputs the cell in Gnuplot format a given file.
 		 * \param[in] (x,y,z) a displacement to add to the cell's
 		 *                    position.
@@ -219,6 +221,16 @@ class voronoicell_base {
 		 * \param[in] p the number of the vertex.
 		 * \return nu[p]-1 if a=0, or a-1 otherwise. */
 		inline int cycle_down(int a,int p) {return a==0?nu[p]-1:a-1;}
+		void start_traversal();
+		/** Tests whether an edge has been visited during the current
+		 * traversal, which must have been set up with
+		 * start_traversal().
+		 * \param[in] (i,j) the vertex and the index of its edge.
+		 * \return True if the edge has been marked, false otherwise. */
+		inline bool edge_marked(int i,int j) {return em[eo[i]+j]==epoch;}
+		/** Marks an edge as visited during the current traversal.
+		 * \param[in] (i,j) the vertex and the index of its edge. */
+		inline void mark_edge(int i,int j) {em[eo[i]+j]=epoch;}
 	protected:
 		/** This a one dimensional array that holds the current sizes
 		 * of the memory allocations for them mep array.*/
@@ -235,7 +247,6 @@ class voronoicell_base {
 		 * on mep[p] is stored in mem[p]. If the space runs out, the
 		 * code allocates more using the add_memory() routine. */
 		int **mep;
-		inline void reset_edges();
 		template<class vc_class>
 		void check_memory_for_copy(vc_class &vc,voronoicell_base* vb);
 		void copy(voronoicell_base* vb);
@@ -264,6 +275,18 @@ class voronoicell_base {
 		double pz;
 		/** The magnitude of the normal vector to the test plane. */
 		double prsq;
+		/** This sets the size of the eo array. */
+		int current_mark_vertices;
+		/** This sets the size of the em array. */
+		int current_marks;
+		/** The offset of the first edge of each vertex within the em
+		 * array, set up by start_traversal(). */
+		int *eo;
+		/** The edge marks, holding the epoch of the traversal that
+		 * most recently visited each edge. */
+		unsigned int *em;
+		/** The epoch of the current traversal. */
+		unsigned int epoch;
 		template<class vc_class>
 		void add_memory(vc_class &vc,int i,int *stackp2);
 		template<class vc_class>
@@ -7,7 +7,9 @@
 /** \file cmd_line.cc
  * \brief Source code for the command-line utility. */
 
+#include <climits>
 #include <cstring>
+#include <vector>
 
 #include "voro++.hh"
 using namespace voro;
@@ -31,10 +33,20 @@ void help_message() {
 	     "computes the Voronoi cell for each, and then creates <filename.vol> with an\n"
 	     "additional column containing the volume of each Voronoi cell.\n\n"
 	     "Available options:\n"
+	     " -bi        : Read the particles in the binary format of the\n"
+	     "              pre_container::import_binary() routine\n"
+	     " -bo        : Save the quantities in the custom output string as binary\n"
+	     "              NumPy arrays in <filename_*.npy>, instead of <filename.vol>.\n"
+	     "              The cells are then computed by a single thread, and -j is\n"
+	     "              ignored\n"
 	     " -c <str>   : Specify a custom output string\n"
+	     " -d         : Estimate the internal grid size from the sampled particle\n"
+	     "              density, for clustered particle distributions\n"
 	     " -g         : Turn on the gnuplot output to <filename.gnu>\n"
 	     " -h/--help  : Print this information\n"
 	     " -hc        : Print information about custom output\n"
+	     " -j <n>     : Compute the Voronoi cells using n threads, or all available\n"
+	     "              hardware threads if n is zero (default 1)\n"
 	     " -l <len>   : Manually specify a length scale to configure the internal\n"
 	     "              computational grid\n"
 	     " -m <mem>   : Manually choose the memory allocation per grid block\n"
@@ -47,6 +59,12 @@ void help_message() {
 	     " -py        : Make container periodic in the y direction\n"
 	     " -pz        : Make container periodic in the z direction\n"
 	     " -r         : Assume the input file has an extra coordinate for radii\n"
+	     " -stream    : Read a sequence of frames from standard input, where each frame\n"
+	     "              is a line with the number of particles followed by the\n"
+	     "              particles, or a record in the -bi format. The output of each\n"
+	     "              frame is appended to <filename.vol>, followed by a blank line,\n"
+	     "              or is written to standard output if <filename> is \"-\". With\n"
+	     "              -bo, frame k is saved to <filename_k_*.npy>\n"
 	     " -v         : Verbose output\n"
 	     " --version  : Print version information\n"
 	     " -wb [6]    : Add six plane wall objects to make rectangular box containing\n"
@@ -59,6 +77,8 @@ void help_message() {
 	     "              with radius x4\n"
 	     " -wp [4]    : Add a plane wall object, with normal (x1,x2,x3),\n"
 	     "              and displacement x4\n"
+	     " -wm <file> : Add a wall object enclosed by the triangle mesh in an STL\n"
+	     "              file\n"
 	     " -y         : Save POV-Ray particles to <filename_p.pov> and POV-Ray Voronoi\n"
 	     "              cells to <filename_v.pov>\n"
 	     " -yp        : Save only POV-Ray particles to <filename_p.pov>\n"
@@ -120,55 +140,244 @@ void error_message() {
 	fputs("voro++: Unrecognized command-line options; type \"voro++ -h\" for more\ninformation.\n",stderr);
 }
 
+
+// The output files and settings that are used by the computation routines,
+// and the totals that are accumulated for the verbose output
+struct cmd_line_settings {
+	const char *format;
+	FILE *outfile,*gnu_file,*povp_file,*povv_file;
+	binary_output *bo;
+	int nt;
+	bool verbose;
+	double vol;
+	int vcc,tp;
+};
+
 // Carries out the Voronoi computation and outputs the results to the requested
 // files
 template<class c_loop,class c_class>
-void cmd_line_output(c_loop &vl,c_class &con,const char* format,FILE* outfile,FILE* gnu_file,FILE* povp_file,FILE* povv_file,bool verbose,double &vol,int &vcc,int &tp) {
+void cmd_line_output(c_loop &vl,c_class &con,cmd_line_settings &cs) {
 	int pid,ps=con.ps;double x,y,z,r;
-	if(con.contains_neighbor(format)) {
+	custom_format cf(cs.format);
+	voro_out_buffer ob(cs.outfile);
+	if(cf.neighbor||(cs.bo!=NULL&&cs.bo->neighbor)) {
 		voronoicell_neighbor c;
 		if(vl.start()) do if(con.compute_cell(c,vl)) {
 			vl.pos(pid,x,y,z,r);
-			if(outfile!=NULL) c.output_custom(format,pid,x,y,z,r,outfile);
-			if(gnu_file!=NULL) c.draw_gnuplot(x,y,z,gnu_file);
-			if(povp_file!=NULL) {
-				fprintf(povp_file,"// id %d\n",pid);
-				if(ps==4) fprintf(povp_file,"sphere{<%g,%g,%g>,%g}\n",x,y,z,r);
-				else fprintf(povp_file,"sphere{<%g,%g,%g>,s}\n",x,y,z);
+			if(cs.outfile!=NULL) cf.output(c,pid,x,y,z,r,ob);
+			if(cs.bo!=NULL) cs.bo->output(c,pid,x,y,z,r);
+			if(cs.gnu_file!=NULL) c.draw_gnuplot(x,y,z,cs.gnu_file);
+			if(cs.povp_file!=NULL) {
+				fprintf(cs.povp_file,"// id %d\n",pid);
+				if(ps==4) fprintf(cs.povp_file,"sphere{<%g,%g,%g>,%g}\n",x,y,z,r);
+				else fprintf(cs.povp_file,"sphere{<%g,%g,%g>,s}\n",x,y,z);
 			}
-			if(povv_file!=NULL) {
-				fprintf(povv_file,"// cell %d\n",pid);
-				c.draw_pov(x,y,z,povv_file);
+			if(cs.povv_file!=NULL) {
+				fprintf(cs.povv_file,"// cell %d\n",pid);
+				c.draw_pov(x,y,z,cs.povv_file);
 			}
-			if(verbose) {vol+=c.volume();vcc++;}
+			if(cs.verbose) {cs.vol+=c.volume();cs.vcc++;}
 		} while(vl.inc());
 	} else {
 		voronoicell c;
 		if(vl.start()) do if(con.compute_cell(c,vl)) {
 			vl.pos(pid,x,y,z,r);
-			if(outfile!=NULL) c.output_custom(format,pid,x,y,z,r,outfile);
-			if(gnu_file!=NULL) c.draw_gnuplot(x,y,z,gnu_file);
-			if(povp_file!=NULL) {
-				fprintf(povp_file,"// id %d\n",pid);
-				if(ps==4) fprintf(povp_file,"sphere{<%g,%g,%g>,%g}\n",x,y,z,r);
-				else fprintf(povp_file,"sphere{<%g,%g,%g>,s}\n",x,y,z);
+			if(cs.outfile!=NULL) cf.output(c,pid,x,y,z,r,ob);
+			if(cs.bo!=NULL) cs.bo->output(c,pid,x,y,z,r);
+			if(cs.gnu_file!=NULL) c.draw_gnuplot(x,y,z,cs.gnu_file);
+			if(cs.povp_file!=NULL) {
+				fprintf(cs.povp_file,"// id %d\n",pid);
+				if(ps==4) fprintf(cs.povp_file,"sphere{<%g,%g,%g>,%g}\n",x,y,z,r);
+				else fprintf(cs.povp_file,"sphere{<%g,%g,%g>,s}\n",x,y,z);
 			}
-			if(povv_file!=NULL) {
-				fprintf(povv_file,"// cell %d\n",pid);
-				c.draw_pov(x,y,z,povv_file);
+			if(cs.povv_file!=NULL) {
+				fprintf(cs.povv_file,"// cell %d\n",pid);
+				c.draw_pov(x,y,z,cs.povv_file);
 			}
-			if(verbose) {vol+=c.volume();vcc++;}
+			if(cs.verbose) {cs.vol+=c.volume();cs.vcc++;}
 		} while(vl.inc());
 	}
-	if(verbose) tp=con.total_particles();
+	if(cs.verbose) cs.tp+=con.total_particles();
+}
+
+// A formatting class for the parallel output routines that writes all of the
+// requested text outputs for each computed cell, so that each cell is only
+// computed once. The outputs are written to consecutive buffers, in the order
+// of the custom, gnuplot, POV-Ray particle, and POV-Ray cell files, skipping
+// those that were not requested. The volumes for the verbose output are summed
+// separately for each thread.
+struct cmd_line_format {
+	custom_format cf;
+	bool out,gnu,povp,povv,verbose;
+	std::vector<double> *vol;
+	std::vector<int> *vcc;
+	cmd_line_format(cmd_line_settings &cs,std::vector<double> &vol_,std::vector<int> &vcc_)
+		: cf(cs.format), out(cs.outfile!=NULL), gnu(cs.gnu_file!=NULL),
+		povp(cs.povp_file!=NULL), povv(cs.povv_file!=NULL),
+		verbose(cs.verbose), vol(&vol_), vcc(&vcc_) {}
+	template<class c_class,class v_cell>
+	inline void operator()(c_class &con,v_cell &c,int ijk,int q,int t,voro_out_buffer **ob) {
+		double *pp=con.p[ijk]+con.ps*q;
+		int pid=con.id[ijk][q];
+		if(out) cf.output(c,pid,*pp,pp[1],pp[2],con.ps==4?pp[3]:default_radius,**(ob++));
+		if(gnu) c.draw_gnuplot(*pp,pp[1],pp[2],**(ob++));
+		if(povp) {
+			voro_out_buffer &b=**(ob++);
+			b.put("// id ");b.put_int(pid);
+			b.put("\nsphere{<");b.put_double(*pp);
+			b.put(',');b.put_double(pp[1]);
+			b.put(',');b.put_double(pp[2]);
+			if(con.ps==4) {b.put(">,");b.put_double(pp[3]);b.put("}\n");}
+			else b.put(">,s}\n");
+		}
+		if(povv) {
+			voro_out_buffer &b=**ob;
+			b.put("// cell ");b.put_int(pid);b.put('\n');
+			c.draw_pov(*pp,pp[1],pp[2],b);
+		}
+		if(verbose) {(*vol)[t]+=c.volume();(*vcc)[t]++;}
+	}
+};
+
+// Carries out the Voronoi computation using several threads, and outputs the
+// results to the requested files. All of the outputs are made in a single
+// parallel pass over the cells, and are the same as those of the serial
+// routine.
+template<class c_loop,class c_class>
+void cmd_line_output_parallel(c_loop &vl,c_class &con,cmd_line_settings &cs) {
+	FILE *fl[4];int nf=0;
+	if(cs.outfile!=NULL) fl[nf++]=cs.outfile;
+	if(cs.gnu_file!=NULL) fl[nf++]=cs.gnu_file;
+	if(cs.povp_file!=NULL) fl[nf++]=cs.povp_file;
+	if(cs.povv_file!=NULL) fl[nf++]=cs.povv_file;
+	int nt=voro_thread_count(cs.nt);
+	std::vector<double> vol(nt,0);
+	std::vector<int> vcc(nt,0);
+	cmd_line_format f(cs,vol,vcc);
+	if(f.cf.neighbor) output_parallel_files<voronoicell_neighbor>(con,vl,f,nf,fl,nt);
+	else output_parallel_files<voronoicell>(con,vl,f,nf,fl,nt);
+	if(cs.verbose) {
+		for(int t=0;t<nt;t++) {cs.vol+=vol[t];cs.vcc+=vcc[t];}
+		cs.tp+=con.total_particles();
+	}
+}
+
+// Carries out the Voronoi computation with the requested number of threads.
+// The binary output is written by a single thread, so if it is requested,
+// all of the outputs are made by the serial routine.
+template<class c_loop,class c_class>
+inline void cmd_line_compute(c_loop &vl,c_class &con,cmd_line_settings &cs) {
+	if(cs.nt==1||cs.bo!=NULL) cmd_line_output(vl,con,cs);
+	else cmd_line_output_parallel(vl,con,cs);
+}
+
+// Reads the next frame of particles in text format, which is made up of the
+// number of particles followed by a line for each particle. Returns false if
+// the end of the file has been reached.
+bool read_frame_text(FILE *fp,int ps,std::vector<int> &id,std::vector<double> &pp) {
+	int k,n;
+	if(fscanf(fp,"%d",&n)!=1) {
+		if(feof(fp)) return false;
+		voro_fatal_error("Stream import error: unable to read the number of particles",VOROPP_FILE_ERROR);
+	}
+	if(n<0) voro_fatal_error("Stream import error: negative number of particles",VOROPP_FILE_ERROR);
+	id.resize(n);pp.resize(ps*n);
+	for(k=0;k<n;k++) {
+		double *p=&pp[ps*k];
+		if(fscanf(fp,"%d %lg %lg %lg",&id[k],p,p+1,p+2)!=4||(ps==4&&fscanf(fp,"%lg",p+3)!=1))
+			voro_fatal_error("Stream import error: unable to read a particle",VOROPP_FILE_ERROR);
+	}
+	return true;
+}
+
+// Reads the next frame of particles in the binary format of the
+// pre_container_base::import_binary() routine. Returns false if the end of the
+// file has been reached.
+bool read_frame_binary(FILE *fp,int ps,std::vector<int> &id,std::vector<double> &pp) {
+	char h[16];
+	int fps;long long n;
+	size_t l=fread(h,1,16,fp);
+	if(l==0&&feof(fp)) return false;
+	if(l!=16||memcmp(h,"VORO",4)!=0)
+		voro_fatal_error("Stream import error: unrecognized header",VOROPP_FILE_ERROR);
+	memcpy(&fps,h+4,4);memcpy(&n,h+8,8);
+	if(fps!=ps) voro_fatal_error("Stream import error: wrong number of values per particle",VOROPP_FILE_ERROR);
+	if(n<0||n>INT_MAX/ps) voro_fatal_error("Stream import error: invalid number of particles",VOROPP_FILE_ERROR);
+	id.resize(n);pp.resize(ps*n);
+
+	// Read the IDs, the padding that aligns the floating point values to
+	// eight bytes, and the floating point values
+	if(fread(&id[0],sizeof(int),n,fp)!=size_t(n)||((n&1)&&fread(h,1,4,fp)!=4)
+	   ||fread(&pp[0],sizeof(double),ps*n,fp)!=size_t(ps*n))
+		voro_fatal_error("Stream import error: frame is truncated",VOROPP_FILE_ERROR);
+	return true;
+}
+
+// Reads the next frame of particles in the requested format
+inline bool read_frame(FILE *fp,bool binary_in,int ps,std::vector<int> &id,std::vector<double> &pp) {
+	return binary_in?read_frame_binary(fp,ps,id,pp):read_frame_text(fp,ps,id,pp);
+}
+
+// Adds the particles of a frame to a container, recording their order if an
+// ordering class is supplied
+void cmd_line_put(container &con,particle_order *vo,std::vector<int> &id,std::vector<double> &pp) {
+	for(unsigned int k=0;k<id.size();k++) {
+		double *p=&pp[3*k];
+		if(vo!=NULL) con.put(*vo,id[k],*p,p[1],p[2]);
+		else con.put(id[k],*p,p[1],p[2]);
+	}
+}
+
+void cmd_line_put(container_poly &con,particle_order *vo,std::vector<int> &id,std::vector<double> &pp) {
+	for(unsigned int k=0;k<id.size();k++) {
+		double *p=&pp[4*k];
+		if(vo!=NULL) con.put(*vo,id[k],*p,p[1],p[2],p[3]);
+		else con.put(id[k],*p,p[1],p[2],p[3]);
+	}
+}
+
+// Processes a sequence of frames, starting with one that has already been read
+// in, and reading the rest from standard input. The container and the ordering
+// class are cleared and reused for each frame, so that their memory is only
+// allocated once. Returns the number of frames.
+template<class c_class>
+int cmd_line_stream(c_class &con,bool ordered,bool binary_in,bool binary_out,const char *prefix,cmd_line_settings &cs,std::vector<int> &id,std::vector<double> &pp) {
+	particle_order vo;
+	char *buffer=new char[strlen(prefix)+16];
+	int fr=0;
+	do {
+		con.clear();vo.op=vo.o;
+		cmd_line_put(con,ordered?&vo:NULL,id,pp);
+		if(binary_out) {
+			sprintf(buffer,"%s_%d",prefix,fr);
+			cs.bo=new binary_output(cs.format,buffer);
+		}
+		if(ordered) {
+			c_loop_order vlo(con,vo);
+			cmd_line_compute(vlo,con,cs);
+		} else {
+			c_loop_all vla(con);
+			cmd_line_compute(vla,con,cs);
+		}
+		if(binary_out) {delete cs.bo;cs.bo=NULL;}
+
+		// Mark the end of the frame in each text output, and flush
+		// them so that a program reading them can process the frame
+		FILE *fl[4]={cs.outfile,cs.gnu_file,cs.povp_file,cs.povv_file};
+		for(int k=0;k<4;k++) if(fl[k]!=NULL) {putc('\n',fl[k]);fflush(fl[k]);}
+		fr++;
+	} while(read_frame(stdin,binary_in,con.ps,id,pp));
+	delete [] buffer;
+	return fr;
 }
 
 int main(int argc,char **argv) {
-	int i=1,j=-7,custom_output=0,nx,ny,nz,init_mem(8);
+	int i=1,j=-7,k,custom_output=0,nx,ny,nz,init_mem(8),nt=1;
 	double ls=0;
 	blocks_mode bm=none;
 	bool gnuplot_output=false,povp_output=false,povv_output=false,polydisperse=false;
-	bool xperiodic=false,yperiodic=false,zperiodic=false,ordered=false,verbose=false;
+	bool xperiodic=false,yperiodic=false,zperiodic=false,ordered=false,verbose=false,density=false;
+	bool binary_in=false,binary_out=false,stream=false;
 	pre_container *pcon=NULL;pre_container_poly *pconp=NULL;
 	wall_list wl;
 
@@ -197,7 +406,11 @@ int main(int argc,char **argv) {
 	// We have enough arguments. Now start searching for command-line
 	// options.
 	while(i<argc-7) {
-		if(strcmp(argv[i],"-c")==0) {
+		if(strcmp(argv[i],"-bi")==0) {
+			binary_in=true;
+		} else if(strcmp(argv[i],"-bo")==0) {
+			binary_out=true;
+		} else if(strcmp(argv[i],"-c")==0) {
 			if(i>=argc-8) {error_message();wl.deallocate();return VOROPP_CMD_LINE_ERROR;}
 			if(custom_output==0) {
 				custom_output=++i;
@@ -206,12 +419,22 @@ int main(int argc,char **argv) {
 				wl.deallocate();
 				return VOROPP_CMD_LINE_ERROR;
 			}
+		} else if(strcmp(argv[i],"-d")==0) {
+			density=true;
 		} else if(strcmp(argv[i],"-g")==0) {
 			gnuplot_output=true;
 		} else if(strcmp(argv[i],"-h")==0||strcmp(argv[i],"--help")==0) {
 			help_message();wl.deallocate();return 0;
 		} else if(strcmp(argv[i],"-hc")==0) {
 			custom_output_message();wl.deallocate();return 0;
+		} else if(strcmp(argv[i],"-j")==0) {
+			if(i>=argc-8) {error_message();wl.deallocate();return VOROPP_CMD_LINE_ERROR;}
+			i++;nt=atoi(argv[i]);
+			if(nt<0) {
+				fputs("voro++: The number of threads must not be negative\n",stderr);
+				wl.deallocate();
+				return VOROPP_CMD_LINE_ERROR;
+			}
 		} else if(strcmp(argv[i],"-l")==0) {
 			if(i>=argc-8) {error_message();wl.deallocate();return VOROPP_CMD_LINE_ERROR;}
 			if(bm!=none) {
@@ -253,6 +476,8 @@ int main(int argc,char **argv) {
 			zperiodic=true;
 		} else if(strcmp(argv[i],"-r")==0) {
 			polydisperse=true;
+		} else if(strcmp(argv[i],"-stream")==0) {
+			stream=true;
 		} else if(strcmp(argv[i],"-v")==0) {
 			verbose=true;
 		} else if(strcmp(argv[i],"--version")==0) {
@@ -303,6 +528,10 @@ int main(int argc,char **argv) {
 			double w6=atof(argv[i]);
 			wl.add_wall(new wall_cone(w0,w1,w2,w3,w4,w5,w6,j));
 			j--;
+		} else if(strcmp(argv[i],"-wm")==0) {
+			if(i>=argc-8) {error_message();wl.deallocate();return VOROPP_CMD_LINE_ERROR;}
+			wl.add_wall(new wall_mesh(argv[++i],j));
+			j--;
 		} else if(strcmp(argv[i],"-y")==0) {
 			povp_output=povv_output=true;
 		} else if(strcmp(argv[i],"-yp")==0) {
@@ -348,17 +577,51 @@ int main(int argc,char **argv) {
 		return VOROPP_CMD_LINE_ERROR;
 	}
 
-	if(bm==none) {
+	// In stream mode, the output can be sent to standard output, but
+	// only if it is text in a single file
+	bool to_stdout=stream&&strcmp(argv[i+6],"-")==0;
+	if(to_stdout&&(binary_out||gnuplot_output||povp_output||povv_output)) {
+		fputs("voro++: Only the custom text output can be written to standard output\n",stderr);
+		wl.deallocate();
+		return VOROPP_CMD_LINE_ERROR;
+	}
+
+	// In stream mode, read in the first frame. If there are no frames,
+	// then there is nothing to do.
+	int ps=polydisperse?4:3;
+	std::vector<int> sid;std::vector<double> sp;
+	if(stream&&!read_frame(stdin,binary_in,ps,sid,sp)) {
+		wl.deallocate();
+		return 0;
+	}
+
+	// Read the particles into a pre_container class, if they are needed
+	// to estimate the grid size, or if they are in binary format. In
+	// stream mode, the grid size is estimated from the first frame.
+	if(bm==none||(binary_in&&!stream)) {
 		if(polydisperse) {
 			pconp=new pre_container_poly(ax,bx,ay,by,az,bz,xperiodic,yperiodic,zperiodic);
-			pconp->import(argv[i+6]);
-			pconp->guess_optimal(nx,ny,nz);
+			if(stream) for(k=0;k<int(sid.size());k++) pconp->put(sid[k],sp[4*k],sp[4*k+1],sp[4*k+2],sp[4*k+3]);
+			else if(binary_in) pconp->import_binary(argv[i+6]);
+			else pconp->import(argv[i+6]);
+			if(bm==none) {
+				if(density) pconp->guess_optimal_density(nx,ny,nz);
+				else pconp->guess_optimal(nx,ny,nz);
+			}
+			if(stream) {delete pconp;pconp=NULL;}
 		} else {
 			pcon=new pre_container(ax,bx,ay,by,az,bz,xperiodic,yperiodic,zperiodic);
-			pcon->import(argv[i+6]);
-			pcon->guess_optimal(nx,ny,nz);
+			if(stream) for(k=0;k<int(sid.size());k++) pcon->put(sid[k],sp[3*k],sp[3*k+1],sp[3*k+2]);
+			else if(binary_in) pcon->import_binary(argv[i+6]);
+			else pcon->import(argv[i+6]);
+			if(bm==none) {
+				if(density) pcon->guess_optimal_density(nx,ny,nz);
+				else pcon->guess_optimal(nx,ny,nz);
+			}
+			if(stream) {delete pcon;pcon=NULL;}
 		}
-	} else {
+	}
+	if(bm!=none) {
 		double nxf,nyf,nzf;
 		if(bm==length_scale) {
 
@@ -407,8 +670,13 @@ int main(int argc,char **argv) {
 
 	// Open files for output
 	char *buffer=new char[flen+7];
-	sprintf(buffer,"%s.vol",argv[i+6]);
-	FILE *outfile=safe_fopen(buffer,"w"),*gnu_file,*povp_file,*povv_file;
+	FILE *outfile,*gnu_file,*povp_file,*povv_file;
+	if(binary_out) outfile=NULL;
+	else if(to_stdout) outfile=stdout;
+	else {
+		sprintf(buffer,"%s.vol",argv[i+6]);
+		outfile=safe_fopen(buffer,"w");
+	}
 	if(gnuplot_output) {
 		sprintf(buffer,"%s.gnu",argv[i+6]);
 		gnu_file=safe_fopen(buffer,"w");
@@ -425,71 +693,79 @@ int main(int argc,char **argv) {
 
 	const char *c_str=(custom_output==0?(polydisperse?"%i %q %v %r":"%i %q %v"):argv[custom_output]);
 
-	// Now switch depending on whether polydispersity was enabled, and
-	// whether output ordering is requested
-	double vol=0;int tp=0,vcc=0;
+	// Now switch depending on whether polydispersity was enabled, whether
+	// output ordering is requested, and whether frames are being streamed
+	cmd_line_settings cs={c_str,outfile,gnu_file,povp_file,povv_file,NULL,nt,verbose,0,0,0};
+	if(binary_out&&!stream) cs.bo=new binary_output(c_str,argv[i+6]);
+	int frames=1;
 	if(polydisperse) {
-		if(ordered) {
+		container_poly con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
+		con.add_wall(wl);
+		if(stream) {
+			frames=cmd_line_stream(con,ordered,binary_in,binary_out,argv[i+6],cs,sid,sp);
+		} else if(ordered) {
 			particle_order vo;
-			container_poly con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
-			con.add_wall(wl);
-			if(bm==none) {
+			if(pconp!=NULL) {
 				pconp->setup(vo,con);delete pconp;
 			} else con.import(vo,argv[i+6]);
 
 			c_loop_order vlo(con,vo);
-			cmd_line_output(vlo,con,c_str,outfile,gnu_file,povp_file,povv_file,verbose,vol,vcc,tp);
+			cmd_line_compute(vlo,con,cs);
 		} else {
-			container_poly con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
-			con.add_wall(wl);
-
-			if(bm==none) {
+			if(pconp!=NULL) {
 				pconp->setup(con);delete pconp;
 			} else con.import(argv[i+6]);
 
 			c_loop_all vla(con);
-			cmd_line_output(vla,con,c_str,outfile,gnu_file,povp_file,povv_file,verbose,vol,vcc,tp);
+			cmd_line_compute(vla,con,cs);
 		}
 	} else {
-		if(ordered) {
+		container con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
+		con.add_wall(wl);
+		if(stream) {
+			frames=cmd_line_stream(con,ordered,binary_in,binary_out,argv[i+6],cs,sid,sp);
+		} else if(ordered) {
 			particle_order vo;
-			container con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
-			con.add_wall(wl);
-			if(bm==none) {
+			if(pcon!=NULL) {
 				pcon->setup(vo,con);delete pcon;
 			} else con.import(vo,argv[i+6]);
 
 			c_loop_order vlo(con,vo);
-			cmd_line_output(vlo,con,c_str,outfile,gnu_file,povp_file,povv_file,verbose,vol,vcc,tp);
+			cmd_line_compute(vlo,con,cs);
 		} else {
-			container con(ax,bx,ay,by,az,bz,nx,ny,nz,xperiodic,yperiodic,zperiodic,init_mem);
-			con.add_wall(wl);
-			if(bm==none) {
+			if(pcon!=NULL) {
 				pcon->setup(con);delete pcon;
 			} else con.import(argv[i+6]);
+
 			c_loop_all vla(con);
-			cmd_line_output(vla,con,c_str,outfile,gnu_file,povp_file,povv_file,verbose,vol,vcc,tp);
+			cmd_line_compute(vla,con,cs);
 		}
 	}
+	if(cs.bo!=NULL) delete cs.bo;
 
-	// Print information if verbose output requested
+	// Print information if verbose output requested. In stream mode, the
+	// totals are summed over all of the frames, and the information is
+	// printed to standard error if the output is on standard output.
 	if(verbose) {
-		printf("Container geometry        : [%g:%g] [%g:%g] [%g:%g]\n"
+		FILE *vf=to_stdout?stderr:stdout;
+		fprintf(vf,"Container geometry        : [%g:%g] [%g:%g] [%g:%g]\n"
 		       "Computational grid size   : %d by %d by %d (%s)\n"
 		       "Filename                  : %s\n"
 		       "Output string             : %s%s\n",ax,bx,ay,by,az,bz,nx,ny,nz,
-		       bm==none?"estimated from file":(bm==length_scale?
+		       bm==none?(stream?(density?"estimated from first frame density":"estimated from first frame")
+		       :(density?"estimated from file density":"estimated from file")):(bm==length_scale?
 		       "estimated using length scale":"directly specified"),
 		       argv[i+6],c_str,custom_output==0?" (default)":"");
-		printf("Total imported particles  : %d (%.2g per grid block)\n"
+		if(stream) fprintf(vf,"Frames processed          : %d\n",frames);
+		fprintf(vf,"Total imported particles  : %d (%.2g per grid block)\n"
 		       "Total V. cells computed   : %d\n"
 		       "Total container volume    : %g\n"
-		       "Total V. cell volume      : %g\n",tp,((double) tp)/(nx*ny*nz),
-		       vcc,(bx-ax)*(by-ay)*(bz-az),vol);
+		       "Total V. cell volume      : %g\n",cs.tp,((double) cs.tp)/(frames*nx*ny*nz),
+		       cs.vcc,frames*(bx-ax)*(by-ay)*(bz-az),cs.vol);
 	}
 			   
 	// Close output files
-	fclose(outfile);
+	if(outfile!=NULL&&outfile!=stdout) fclose(outfile);
 	if(gnu_file!=NULL) fclose(gnu_file);
 	if(povp_file!=NULL) fclose(povp_file);
 	if(povv_file!=NULL) fclose(povv_file);
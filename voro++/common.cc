@@ -7,8 +7,20 @@
 /** \file common.cc
  * \brief Implementations of the small helper functions. */
 
+#include <cstring>
+
 #include "common.hh"
 
+#if defined(__unix__)||defined(__APPLE__)
+#define VOROPP_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define VOROPP_MMAP 0
+#endif
+
 namespace voro {
 
 /** \brief Prints a vector of integers.
@@ -87,4 +99,257 @@ void voro_print_face_vertices(std::vector<int> &v,FILE *fp) {
 	}
 }
 
+/** \brief Reads a floating point number from a character buffer.
+ *
+ * Reads a floating point number from a character buffer that need not be
+ * null-terminated, advancing the position past it. Numbers with at most
+ * nineteen significant digits and a small decimal exponent are converted
+ * directly, since the result is then exactly rounded. Other numbers are passed
+ * to strtod.
+ * \param[in,out] p a pointer to the current position in the buffer.
+ * \param[in] e a pointer to the end of the buffer.
+ * \param[out] x the number that was read.
+ * \return True if a number was read, false otherwise. */
+bool voro_parse_double(const char *&p,const char *e,double &x) {
+	static const double pw[23]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,
+		1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+	const char *s=p;
+	unsigned long long m=0;
+	int nd=0,ex=0,ee=0;
+	bool neg=false,dig=false,slow=false,eneg=false;
+
+	// Read the sign, the integer digits, and the fractional digits,
+	// accumulating up to nineteen significant digits in the mantissa
+	if(p<e&&(*p=='-'||*p=='+')) neg=*(p++)=='-';
+	while(p<e&&*p>='0'&&*p<='9') {
+		if(nd<19) {m=10*m+(*p-'0');if(m>0) nd++;} else slow=true;
+		dig=true;p++;
+	}
+	if(p<e&&*p=='.') {
+		p++;
+		while(p<e&&*p>='0'&&*p<='9') {
+			if(nd<19) {m=10*m+(*p-'0');if(m>0) nd++;ex--;} else if(*p!='0') slow=true;
+			dig=true;p++;
+		}
+	}
+	if(!dig) {p=s;return false;}
+
+	// Read the exponent, if present
+	if(p<e&&(*p=='e'||*p=='E')) {
+		const char *q=p+1;
+		if(q<e&&(*q=='-'||*q=='+')) eneg=*(q++)=='-';
+		if(q<e&&*q>='0'&&*q<='9') {
+			while(q<e&&*q>='0'&&*q<='9') {
+				if(ee<100000) ee=10*ee+(*q-'0');
+				q++;
+			}
+			p=q;ex+=eneg?-ee:ee;
+		}
+	}
+
+	// If the mantissa and the power of ten are both exactly representable
+	// then a single multiplication or division gives the correctly
+	// rounded result. Otherwise, fall back to the library routine.
+	if(!slow&&m<=(1ULL<<53)&&ex>=-22&&ex<=22) {
+		x=double(m);
+		x=ex<0?x/pw[-ex]:x*pw[ex];
+		if(neg) x=-x;
+	} else {
+		char buf[128];
+		size_t l=p-s;
+		if(l>=sizeof(buf)) {
+			std::vector<char> lbuf(s,p);lbuf.push_back(0);
+			x=strtod(&lbuf[0],NULL);
+		} else {
+			memcpy(buf,s,l);buf[l]=0;
+			x=strtod(buf,NULL);
+		}
+	}
+	return true;
+}
+
+/** Makes the contents of a file available, memory-mapping it if possible.
+ * \param[in] filename the name of the file to open. */
+voro_mapped_file::voro_mapped_file(const char *filename) : data(NULL), size(0), mapped(false) {
+#if VOROPP_MMAP ==1
+	int fd=open(filename,O_RDONLY);
+	struct stat st;
+	if(fd>=0&&fstat(fd,&st)==0&&S_ISREG(st.st_mode)) {
+		size=st.st_size;
+		if(size>0) {
+			void *m=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+			if(m!=MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+				madvise(m,size,MADV_SEQUENTIAL);
+#endif
+				data=static_cast<const char*>(m);mapped=true;
+			}
+		}
+		close(fd);
+		if(mapped||size==0) return;
+	} else if(fd>=0) close(fd);
+#endif
+
+	// If the file could not be mapped, then read its contents into a
+	// single buffer
+	FILE *fp=safe_fopen(filename,"rb");
+	if(fseek(fp,0,SEEK_END)!=0) voro_fatal_error("File read error",VOROPP_FILE_ERROR);
+	long l=ftell(fp);
+	if(l<0) voro_fatal_error("File read error",VOROPP_FILE_ERROR);
+	rewind(fp);
+	size=l;
+	if(size>0) {
+		char *d=new char[size];
+		if(fread(d,1,size,fp)!=size) voro_fatal_error("File read error",VOROPP_FILE_ERROR);
+		data=d;
+	}
+	fclose(fp);
+}
+
+/** The destructor unmaps or frees the file contents. */
+voro_mapped_file::~voro_mapped_file() {
+	if(mapped) {
+#if VOROPP_MMAP ==1
+		munmap(const_cast<char*>(data),size);
+#endif
+	} else delete [] data;
+}
+
+/** The class constructor allocates the buffer.
+ * \param[in] fp_ the file handle to write to, or NULL to hold all of the text
+ *                in memory.
+ * \param[in] bsize the initial size of the buffer. */
+voro_out_buffer::voro_out_buffer(FILE *fp_,size_t bsize) : fp(fp_),
+	buf(new char[bsize]), bp(buf), be(buf+bsize) {}
+
+/** Makes space for a given number of characters, either by writing out the
+ * contents of the buffer, or by extending it.
+ * \param[in] n the number of characters to make space for. */
+void voro_out_buffer::reserve(size_t n) {
+	if(fp!=NULL) {
+		flush();
+		if(size_t(be-bp)>=n) return;
+	}
+	size_t l=bp-buf,s=be-buf;
+	while(s-l<n) s<<=1;
+	char *nb=new char[s];
+	memcpy(nb,buf,l);
+	delete [] buf;
+	buf=nb;bp=buf+l;be=buf+s;
+}
+
+/** Adds a sequence of characters to the buffer.
+ * \param[in] s a pointer to the characters.
+ * \param[in] n the number of characters. */
+void voro_out_buffer::put(const char *s,size_t n) {
+	if(size_t(be-bp)<n) reserve(n);
+	memcpy(bp,s,n);bp+=n;
+}
+
+/** Adds a vector of integers to the buffer, separated by spaces, in the same
+ * form as voro_print_vector().
+ * \param[in] v the vector to add. */
+void voro_out_buffer::put_vector(std::vector<int> &v) {
+	for(unsigned int k=0;k<v.size();k++) {
+		if(k>0) put(' ');
+		put_int(v[k]);
+	}
+}
+
+/** Adds a vector of floating point numbers to the buffer, separated by spaces,
+ * in the same form as voro_print_vector().
+ * \param[in] v the vector to add. */
+void voro_out_buffer::put_vector(std::vector<double> &v) {
+	for(unsigned int k=0;k<v.size();k++) {
+		if(k>0) put(' ');
+		put_double(v[k]);
+	}
+}
+
+/** Adds a vector of positions to the buffer as bracketed triplets, in the
+ * same form as voro_print_positions().
+ * \param[in] v the vector to add. */
+void voro_out_buffer::put_positions(std::vector<double> &v) {
+	for(unsigned int k=0;k+2<v.size();k+=3) {
+		put(k>0?" (":"(",k>0?2:1);
+		put_double(v[k]);put(',');
+		put_double(v[k+1]);put(',');
+		put_double(v[k+2]);put(')');
+	}
+}
+
+/** Adds a vector of face vertex information to the buffer, in the same form as
+ * voro_print_face_vertices().
+ * \param[in] v the vector to interpret and add. */
+void voro_out_buffer::put_face_vertices(std::vector<int> &v) {
+	unsigned int j,k=0;
+	while(k<v.size()) {
+		if(k>0) put(' ');
+		put('(');
+		j=k+1+v[k];k++;
+		if(k<j) {
+			put_int(v[k++]);
+			while(k<j) {put(',');put_int(v[k++]);}
+		}
+		put(')');
+	}
+}
+
+/** Writes the contents of the buffer to the file handle and empties the
+ * buffer. If the text is held in memory, this routine does nothing. */
+void voro_out_buffer::flush() {
+	if(fp==NULL) return;
+	if(bp>buf&&fwrite(buf,1,bp-buf,fp)!=size_t(bp-buf))
+		voro_fatal_error("File write error",VOROPP_FILE_ERROR);
+	bp=buf;
+}
+
+/** The class constructor opens the file handle that the text is written to. */
+voro_reorder_buffer::voro_reorder_buffer() : buf(NULL), bsize(0), cr(-1) {
+#if VOROPP_MMAP ==1
+	fp=open_memstream(&buf,&bsize);
+#else
+	fp=tmpfile();
+#endif
+	if(fp==NULL) voro_fatal_error("Unable to open output buffer",VOROPP_FILE_ERROR);
+}
+
+/** The destructor closes the file handle and frees the memory. */
+voro_reorder_buffer::~voro_reorder_buffer() {
+	fclose(fp);
+	free(buf);
+}
+
+/** Starts a new piece of text.
+ * \param[in] r the rank of the piece, which sets the position that the piece
+ *              is written in by the flush() routine. */
+void voro_reorder_buffer::mark(int r) {
+	long l=ftell(fp);
+	if(cr>=0) en[cr]=l;
+	if(r>=int(st.size())) {st.resize(r+1,-1);en.resize(r+1,-1);}
+	st[r]=l;cr=r;
+}
+
+/** Writes all of the pieces of text in order of increasing rank, and then
+ * empties the buffer.
+ * \param[in] outfp the file handle to write to. */
+void voro_reorder_buffer::flush(FILE *outfp) {
+	long l=ftell(fp);
+	if(cr>=0) en[cr]=l;
+	fflush(fp);
+#if VOROPP_MMAP ==1
+	const char *d=buf;
+#else
+	std::vector<char> v(l+1);
+	const char *d=&v[0];
+	rewind(fp);
+	if(fread(&v[0],1,l,fp)!=size_t(l)) voro_fatal_error("Output buffer read error",VOROPP_FILE_ERROR);
+#endif
+	for(unsigned int i=0;i<st.size();i++) if(st[i]>=0) {
+		fwrite(d+st[i],1,en[i]-st[i],outfp);
+		st[i]=-1;
+	}
+	rewind(fp);cr=-1;
+}
+
 }
@@ -12,10 +12,15 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <vector>
 
 #include "config.hh"
 
+#if VOROPP_THREADS ==1
+#include <thread>
+#endif
+
 namespace voro {
 
 /** \brief Function for printing fatal error messages and exiting.
@@ -58,10 +63,177 @@ inline FILE* safe_fopen(const char *filename,const char *mode) {
 	return fp;
 }
 
+/** \brief Chooses the number of threads to use in a parallel routine.
+ *
+ * Chooses the number of threads to use in a parallel routine. If threading
+ * support is disabled, this always returns one.
+ * \param[in] nt the requested number of threads, or zero or less to use the
+ *               number of hardware threads that are available.
+ * \return The number of threads to use. */
+inline int voro_thread_count(int nt) {
+#if VOROPP_THREADS ==1
+	if(nt<=0) {
+		nt=std::thread::hardware_concurrency();
+		if(nt<=0) nt=1;
+	}
+	return nt;
+#else
+	return 1;
+#endif
+}
+
+/** \brief Skips over whitespace in a character buffer.
+ *
+ * Skips over whitespace in a character buffer.
+ * \param[in,out] p a pointer to the current position in the buffer.
+ * \param[in] e a pointer to the end of the buffer. */
+inline void voro_skip_space(const char *&p,const char *e) {
+	while(p<e&&(*p==' '||(*p>='\t'&&*p<='\r'))) p++;
+}
+
+/** \brief Reads an integer from a character buffer.
+ *
+ * Reads an integer from a character buffer that need not be null-terminated,
+ * advancing the position past it.
+ * \param[in,out] p a pointer to the current position in the buffer.
+ * \param[in] e a pointer to the end of the buffer.
+ * \param[out] n the integer that was read.
+ * \return True if an integer was read, false otherwise. */
+inline bool voro_parse_int(const char *&p,const char *e,int &n) {
+	const char *s=p;
+	bool neg=false;
+	if(p<e&&(*p=='-'||*p=='+')) neg=*(p++)=='-';
+	if(p==e||*p<'0'||*p>'9') {p=s;return false;}
+	n=0;
+	while(p<e&&*p>='0'&&*p<='9') n=10*n+(*(p++)-'0');
+	if(neg) n=-n;
+	return true;
+}
+
+bool voro_parse_double(const char *&p,const char *e,double &x);
 void voro_print_vector(std::vector<int> &v,FILE *fp=stdout);
 void voro_print_vector(std::vector<double> &v,FILE *fp=stdout);
 void voro_print_face_vertices(std::vector<int> &v,FILE *fp=stdout);
 
+/** \brief A class giving read-only access to the contents of a file.
+ *
+ * This class gives read-only access to the whole contents of a file. Where
+ * the operating system supports it, the file is memory-mapped, so that large
+ * particle files can be scanned without an intermediate copy. Otherwise, the
+ * file is read into a single buffer. */
+class voro_mapped_file {
+	public:
+		/** A pointer to the start of the file contents. */
+		const char *data;
+		/** The size of the file in bytes. */
+		size_t size;
+		voro_mapped_file(const char *filename);
+		~voro_mapped_file();
+	private:
+		/** Whether the file contents are memory-mapped, as opposed to
+		 * being stored in a buffer allocated by the class. */
+		bool mapped;
+};
+
+/** \brief A class for writing formatted output through a large memory
+ * buffer.
+ *
+ * This class collects text in a memory buffer and writes it to a file in large
+ * blocks, avoiding the per-call locking and formatting overhead of the cstdio
+ * routines. Integers are converted directly. If no file handle is given, the
+ * buffer grows to hold all of the text, which can then be retrieved with the
+ * data() and size() routines. */
+class voro_out_buffer {
+	public:
+		voro_out_buffer(FILE *fp_=NULL,size_t bsize=out_buffer_size);
+		/** The destructor writes out any remaining text and frees the
+		 * buffer. */
+		~voro_out_buffer() {flush();delete [] buf;}
+		/** Adds a character to the buffer.
+		 * \param[in] c the character to add. */
+		inline void put(char c) {
+			if(bp==be) reserve(1);
+			*(bp++)=c;
+		}
+		void put(const char *s,size_t n);
+		/** Adds a null-terminated string to the buffer.
+		 * \param[in] s the string to add. */
+		inline void put(const char *s) {put(s,strlen(s));}
+		/** Adds an integer to the buffer, in the same form as the
+		 * "%d" format of printf.
+		 * \param[in] n the integer to add. */
+		inline void put_int(int n) {
+			char t[12],*tp=t+12;
+			unsigned int u=n<0?0u-static_cast<unsigned int>(n):n;
+			do {*(--tp)='0'+u%10;u/=10;} while(u>0);
+			if(n<0) *(--tp)='-';
+			put(tp,t+12-tp);
+		}
+		/** Adds a floating point number to the buffer, in the same form
+		 * as the "%g" format of printf.
+		 * \param[in] x the number to add. */
+		inline void put_double(double x) {
+			if(be-bp<32) reserve(32);
+			bp+=snprintf(bp,32,"%g",x);
+		}
+		void put_vector(std::vector<int> &v);
+		void put_vector(std::vector<double> &v);
+		void put_positions(std::vector<double> &v);
+		void put_face_vertices(std::vector<int> &v);
+		void flush();
+		/** Returns a pointer to the text held in the buffer. */
+		inline const char* data() {return buf;}
+		/** Returns the number of characters held in the buffer. */
+		inline size_t size() {return bp-buf;}
+		/** Empties the buffer without writing out the text. */
+		inline void clear() {bp=buf;}
+	private:
+		/** The file handle to write to, or NULL if the text is held in
+		 * memory. */
+		FILE *fp;
+		/** A pointer to the start of the buffer. */
+		char *buf;
+		/** A pointer to the current position in the buffer. */
+		char *bp;
+		/** A pointer to the end of the buffer. */
+		char *be;
+		void reserve(size_t n);
+		voro_out_buffer(const voro_out_buffer&);
+		voro_out_buffer& operator=(const voro_out_buffer&);
+};
+
+/** \brief A class for collecting pieces of text output and writing them out
+ * in a different order.
+ *
+ * Pieces of text are written to the fp file handle, with each piece started
+ * by a call to mark() giving the rank of the piece. The flush() routine then
+ * writes the pieces to another file in increasing order of rank. The text is
+ * held in memory where the operating system supports it, and in a temporary
+ * file otherwise. */
+class voro_reorder_buffer {
+	public:
+		/** The file handle to write the pieces of text to. */
+		FILE *fp;
+		voro_reorder_buffer();
+		~voro_reorder_buffer();
+		void mark(int r);
+		void flush(FILE *outfp);
+	private:
+		/** A pointer to the memory holding the text, if it is held in
+		 * memory. */
+		char *buf;
+		/** The size of the memory holding the text. */
+		size_t bsize;
+		/** The rank of the current piece of text, or -1 if there is
+		 * none. */
+		int cr;
+		/** The start offsets of the pieces of text for each rank, or
+		 * -1 for ranks with no text. */
+		std::vector<long> st;
+		/** The end offsets of the pieces of text for each rank. */
+		std::vector<long> en;
+};
+
 }
 
 #endif
@@ -33,6 +33,9 @@ const int init_delete2_size=256;
 const int init_wall_size=32;
 /** The default initial size for the ordering class. */
 const int init_ordering_size=4096;
+/** The default number of particles in each batch of the sorted ordering loop
+ * class. */
+const int default_order_batch=65536;
 /** The initial size of the pre_container chunk index. */
 const int init_chunk_size=256;
 
@@ -62,6 +65,33 @@ const int max_chunk_size=65536;
 /** The chunk size in the pre_container classes. */
 const int pre_container_chunk_size=1024;
 
+/** The approximate number of particles in each task that is scheduled by the
+ * parallel loop routines. */
+const int parallel_task_particles=256;
+
+/** The maximum number of tasks for each thread whose output can be waiting to
+ * be written in the parallel output routines. */
+const int parallel_output_window=4;
+
+/** The initial size of the buffer holding the output of each task in the
+ * parallel output routines. */
+const int parallel_out_buffer_size=1<<16;
+
+/** The maximum number of triangles in each leaf of the bounding volume
+ * hierarchy of a mesh wall. */
+const int mesh_leaf_triangles=4;
+
+/** The minimum number of bytes of text that each thread is given to parse
+ * during a parallel import. Smaller files are read with fewer threads. */
+const int min_import_thread_bytes=1<<20;
+
+/** The size of the memory buffer used when writing formatted output. */
+const int out_buffer_size=1<<20;
+
+/** The size of the header of the NumPy .npy files written by the binary
+ * output routines, which must be a multiple of 64. */
+const int npy_header_size=128;
+
 #ifndef VOROPP_VERBOSE
 /** Voro++ can print a number of different status and debugging messages to
  * notify the user of special behavior, and this macro sets the amount which
@@ -73,6 +103,19 @@ const int pre_container_chunk_size=1024;
 #define VOROPP_VERBOSE 0
 #endif
 
+#ifndef VOROPP_THREADS
+/** If this is set to 1, then the routines that can make use of multiple
+ * threads (such as the parallel file import) are compiled with C++11 thread
+ * support. It is switched off by default for Emscripten builds that do not
+ * have pthreads enabled, in which case the routines fall back to running on
+ * a single thread. */
+#if defined(__EMSCRIPTEN__)&&!defined(__EMSCRIPTEN_PTHREADS__)
+#define VOROPP_THREADS 0
+#else
+#define VOROPP_THREADS 1
+#endif
+#endif
+
 /** If a point is within this distance of a cutting plane, then the code
  * assumes that point exactly lies on the plane. */
 const double tolerance=1e-11;
@@ -100,6 +143,26 @@ const int max_unit_voro_shells=10;
  * container grid. */
 const double optimal_particles=5.6;
 
+/** The maximum number of particle positions that are sampled when estimating
+ * the particle density to set up the container grid. */
+const int density_sample_size=262144;
+
+#ifndef VOROPP_NEAREST_FIRST
+/** If this is set to 1, then the voro_compute template gathers the particles
+ * in the block of the particle whose cell is being computed and in the ring of
+ * 26 blocks around it, and cuts the cell by them in order of increasing
+ * distance before carrying out the rest of the search. The cell then shrinks
+ * to nearly its final shape with the first few cuts, so that fewer vertices
+ * are created and later deleted. If it is set to 0, then the particles are
+ * cut in the order that they are stored. */
+#define VOROPP_NEAREST_FIRST 0
+#endif
+
+/** The maximum number of particles in the ring of blocks for which the
+ * nearest-first ordering is used. For more particles, sorting them costs more
+ * than it saves, and the usual order is used. */
+const int nearest_first_max=256;
+
 /** If this is set to 1, then the code reports any instances of particles being
  * put outside of the container geometry. */
 #define VOROPP_REPORT_OUT_OF_BOUNDS 0
@@ -12,6 +12,12 @@
 
 namespace voro {
 
+#if VOROPP_THREADS ==1
+thread_local double radius_poly::r_rad;
+thread_local double radius_poly::r_mul;
+thread_local double radius_poly::r_val;
+#endif
+
 /** The class constructor sets up the geometry of container, initializing the
  * minimum and maximum coordinates in each direction, and setting whether each
  * direction is periodic or not. It divides the container into a rectangular
@@ -33,8 +39,13 @@ container_base::container_base(double ax_,double bx_,double ay_,double by_,doubl
 	: voro_base(nx_,ny_,nz_,(bx_-ax_)/nx_,(by_-ay_)/ny_,(bz_-az_)/nz_),
 	ax(ax_), bx(bx_), ay(ay_), by(by_), az(az_), bz(bz_),
 	xperiodic(xperiodic_), yperiodic(yperiodic_), zperiodic(zperiodic_),
-	id(new int*[nxyz]), p(new double*[nxyz]), co(new int[nxyz]), mem(new int[nxyz]), ps(ps_) {
+	id(new int*[nxyz]), p(new double*[nxyz]), co(new int[nxyz]), mem(new int[nxyz]), ps(ps_),
+	wnear_s(new int[nxyz+1]), wnear(new int[1]), wmask(new unsigned int[1]), wlate(new bool[1]),
+	wfull(new unsigned int[1]), wpart(new bool[nxyz]), nlate(0),
+	wall_margin_sq(4*(boxx<boxy?(boxx<boxz?boxx*boxx:boxz*boxz):(boxy<boxz?boxy*boxy:boxz*boxz))) {
 	int l;
+	for(l=0;l<=nxyz;l++) wnear_s[l]=0;
+	for(l=0;l<nxyz;l++) wpart[l]=false;
 	for(l=0;l<nxyz;l++) co[l]=0;
 	for(l=0;l<nxyz;l++) mem[l]=init_mem;
 	for(l=0;l<nxyz;l++) id[l]=new int[init_mem];
@@ -50,6 +61,66 @@ container_base::~container_base() {
 	delete [] p;
 	delete [] co;
 	delete [] mem;
+	delete [] wpart;
+	delete [] wfull;
+	delete [] wlate;
+	delete [] wmask;
+	delete [] wnear;
+	delete [] wnear_s;
+}
+
+/** Adds a wall to the container, and adds it to the lists of walls for the
+ * blocks where it may cut the cells. A wall is left off the list for a block
+ * if the block, expanded by one block length in each direction, lies inside
+ * the wall. For a wall that combines several members, each member is tested
+ * separately, and the list entry records which of them may cut the cells.
+ * \param[in] w the wall to add. */
+void container_base::add_wall(wall *w) {
+	int i,j,k,ijk,l,m,nw=wep-walls,nm=w->member_count(),*nn,*nnp;
+	unsigned int full=nm>=32?~0u:(1u<<nm)-1,*bm=new unsigned int[nxyz],*nk,*nkp;
+	double xl,yl,zl;
+	wall_list::add_wall(w);
+
+	// Test each block against the members of the new wall, and count the
+	// number of new list entries
+	for(ijk=k=0;k<nz;k++) {
+		zl=az+boxz*(k-1);
+		for(j=0;j<ny;j++) {
+			yl=ay+boxy*(j-1);
+			for(i=0;i<nx;i++,ijk++) {
+				xl=ax+boxx*(i-1);
+				for(bm[ijk]=0,m=0;m<nm;m++)
+					if(!w->member_box_inside(m,xl,xl+3*boxx,yl,yl+3*boxy,zl,zl+3*boxz)) bm[ijk]|=1u<<m;
+				if(bm[ijk]!=full) wpart[ijk]=true;
+			}
+		}
+	}
+	for(l=ijk=0;ijk<nxyz;ijk++) if(bm[ijk]) l++;
+
+	// Rebuild the lists with the new wall appended to each of the blocks
+	// where it may cut the cells
+	nnp=nn=new int[wnear_s[nxyz]+l+1];
+	nkp=nk=new unsigned int[wnear_s[nxyz]+l+1];
+	for(ijk=0;ijk<nxyz;ijk++) {
+		l=wnear_s[ijk];
+		wnear_s[ijk]=nnp-nn;
+		while(l<wnear_s[ijk+1]) {*(nnp++)=wnear[l];*(nkp++)=wmask[l++];}
+		if(bm[ijk]) {*(nnp++)=nw;*(nkp++)=bm[ijk];}
+	}
+	wnear_s[nxyz]=nnp-nn;
+	delete [] wnear;wnear=nn;
+	delete [] wmask;wmask=nk;
+	delete [] bm;
+
+	// Record whether the wall is applied after the neighbor search, and
+	// the mask of all its members
+	bool *nl=new bool[nw+1];
+	unsigned int *nf=new unsigned int[nw+1];
+	for(l=0;l<nw;l++) {nl[l]=wlate[l];nf[l]=wfull[l];}
+	if((nl[nw]=w->cut_after_search())) nlate++;
+	nf[nw]=full;
+	delete [] wlate;wlate=nl;
+	delete [] wfull;wfull=nf;
 }
 
 /** The class constructor sets up the geometry of container.
@@ -573,6 +644,78 @@ void container_poly::print_custom(const char *format,FILE *fp) {
 	print_custom(vl,format,fp);
 }
 
+/** Computes the Voronoi cells for the particles in a c_loop_order_sorted class
+ * and saves customized information about them. The cells are computed in
+ * block order within each batch, and the output of each batch is reordered so
+ * that it appears in the order that the particles were stored in the
+ * particle_order class.
+ * \param[in] vl the loop class to use.
+ * \param[in] format the custom output string to use.
+ * \param[in] fp a file handle to write to. */
+void container::print_custom(c_loop_order_sorted &vl,const char *format,FILE *fp) {
+	int ijk,q;double *pp;
+	voro_reorder_buffer rb;
+	custom_format cf(format);
+	voro_out_buffer ob(rb.fp);
+	if(cf.neighbor) {
+		voronoicell_neighbor c;
+		if(vl.start()) do {
+			ob.flush();rb.mark(vl.rank());
+			if(compute_cell(c,vl)) {
+				ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+				cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
+			}
+			if(vl.last_in_batch()) {ob.flush();rb.flush(fp);}
+		} while(vl.inc());
+	} else {
+		voronoicell c;
+		if(vl.start()) do {
+			ob.flush();rb.mark(vl.rank());
+			if(compute_cell(c,vl)) {
+				ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+				cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
+			}
+			if(vl.last_in_batch()) {ob.flush();rb.flush(fp);}
+		} while(vl.inc());
+	}
+}
+
+/** Computes the Voronoi cells for the particles in a c_loop_order_sorted class
+ * and saves customized information about them. The cells are computed in
+ * block order within each batch, and the output of each batch is reordered so
+ * that it appears in the order that the particles were stored in the
+ * particle_order class.
+ * \param[in] vl the loop class to use.
+ * \param[in] format the custom output string to use.
+ * \param[in] fp a file handle to write to. */
+void container_poly::print_custom(c_loop_order_sorted &vl,const char *format,FILE *fp) {
+	int ijk,q;double *pp;
+	voro_reorder_buffer rb;
+	custom_format cf(format);
+	voro_out_buffer ob(rb.fp);
+	if(cf.neighbor) {
+		voronoicell_neighbor c;
+		if(vl.start()) do {
+			ob.flush();rb.mark(vl.rank());
+			if(compute_cell(c,vl)) {
+				ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+				cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
+			}
+			if(vl.last_in_batch()) {ob.flush();rb.flush(fp);}
+		} while(vl.inc());
+	} else {
+		voronoicell c;
+		if(vl.start()) do {
+			ob.flush();rb.mark(vl.rank());
+			if(compute_cell(c,vl)) {
+				ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+				cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
+			}
+			if(vl.last_in_batch()) {ob.flush();rb.flush(fp);}
+		} while(vl.inc());
+	}
+}
+
 /** Computes all the Voronoi cells and saves customized information about them.
  * \param[in] format the custom output string to use.
  * \param[in] filename the name of the file to write to. */
@@ -582,6 +725,16 @@ void container::print_custom(const char *format,const char *filename) {
 	fclose(fp);
 }
 
+/** Computes all the Voronoi cells and writes chosen quantities about them to
+ * binary files, as described in the binary_output class.
+ * \param[in] columns the letters of the quantities to write.
+ * \param[in] prefix the prefix of the filenames to write to. */
+void container::print_binary(const char *columns,const char *prefix) {
+	binary_output bo(columns,prefix);
+	c_loop_all vl(*this);
+	print_binary(vl,bo);
+}
+
 /** Computes all the Voronoi cells and saves customized
  * information about them
  * \param[in] format the custom output string to use.
@@ -592,6 +745,16 @@ void container_poly::print_custom(const char *format,const char *filename) {
 	fclose(fp);
 }
 
+/** Computes all the Voronoi cells and writes chosen quantities about them to
+ * binary files, as described in the binary_output class.
+ * \param[in] columns the letters of the quantities to write.
+ * \param[in] prefix the prefix of the filenames to write to. */
+void container_poly::print_binary(const char *columns,const char *prefix) {
+	binary_output bo(columns,prefix);
+	c_loop_all vl(*this);
+	print_binary(vl,bo);
+}
+
 /** Computes all of the Voronoi cells in the container, but does nothing
  * with the output. It is useful for measuring the pure computation time
  * of the Voronoi algorithm, without any additional calculations such as
@@ -688,6 +851,19 @@ wall_list::~wall_list() {
 	delete [] walls;
 }
 
+/** Tests whether all eight corners of a rectangular box are inside the wall
+ * object. For walls whose interior is convex and whose cutting planes do not
+ * cut the interior, this shows that the wall cannot cut any cell that lies in
+ * the box.
+ * \param[in] (xl,xh) the x range of the box.
+ * \param[in] (yl,yh) the y range of the box.
+ * \param[in] (zl,zh) the z range of the box.
+ * \return True if all the corners are inside, false otherwise. */
+bool wall::corners_inside(double xl,double xh,double yl,double yh,double zl,double zh) {
+	return point_inside(xl,yl,zl)&&point_inside(xh,yl,zl)&&point_inside(xl,yh,zl)&&point_inside(xh,yh,zl)
+	     &&point_inside(xl,yl,zh)&&point_inside(xh,yl,zh)&&point_inside(xl,yh,zh)&&point_inside(xh,yh,zh);
+}
+
 /** Adds all of the walls on another wall_list to this class.
  * \param[in] wl a reference to the wall class. */
 void wall_list::add_wall(wall_list &wl) {
@@ -18,6 +18,8 @@
 #include "v_base.hh"
 #include "cell.hh"
 #include "c_loops.hh"
+#include "custom_format.hh"
+#include "binary_output.hh"
 #include "v_compute.hh"
 #include "rad_option.hh"
 
@@ -44,6 +46,61 @@ class wall {
 		/** A pure virtual function for cutting a cell with
 		 * neighbor-tracking enabled with a wall. */
 		virtual bool cut_cell(voronoicell_neighbor &c,double x,double y,double z) = 0;
+		/** A virtual function for testing whether a rectangular box
+		 * lies entirely inside the wall object, in such a way that
+		 * the wall cannot cut any cell that lies within the box. The
+		 * container uses this to skip walls for cells that are far
+		 * from them. The default implementation always returns false,
+		 * so that the wall is applied to every cell. A wall whose
+		 * interior is convex can return corners_inside(), since the
+		 * box is then inside the wall when all of its corners are.
+		 * \param[in] (xl,xh) the x range of the box.
+		 * \param[in] (yl,yh) the y range of the box.
+		 * \param[in] (zl,zh) the z range of the box.
+		 * \return True if the box is inside, false otherwise. */
+		virtual bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {return false;}
+		/** A virtual function that determines whether the container
+		 * should apply the wall after the cell has been cut by the
+		 * neighboring particles, rather than before. This is
+		 * preferable for walls whose cutting cost grows with the size
+		 * of the cell. The default implementation returns false.
+		 * \return True if the wall should be applied afterwards,
+		 *         false otherwise. */
+		virtual bool cut_after_search() {return false;}
+		/** A virtual function giving the number of walls that this
+		 * object combines, such as the members of a wall_group. The
+		 * container tests each member separately with
+		 * member_box_inside(), and cuts a cell with cut_cell_members()
+		 * by only the members that may cut it. The default returns 1.
+		 * \return The number of members, which must be at most 32. */
+		virtual int member_count() {return 1;}
+		/** A virtual function for testing whether a box lies inside
+		 * one member of the wall object, in the same way as
+		 * box_inside(). The default tests the whole object.
+		 * \param[in] m the index of the member.
+		 * \param[in] (xl,xh) the x range of the box.
+		 * \param[in] (yl,yh) the y range of the box.
+		 * \param[in] (zl,zh) the z range of the box.
+		 * \return True if the box is inside, false otherwise. */
+		virtual bool member_box_inside(int m,double xl,double xh,double yl,double yh,double zl,double zh) {
+			return box_inside(xl,xh,yl,yh,zl,zh);
+		}
+		/** A virtual function for cutting a cell without
+		 * neighbor-tracking with some of the members of the wall
+		 * object. The default applies the whole object if the first
+		 * bit of the mask is set.
+		 * \param[in] mask a bit mask of the members to apply. */
+		virtual bool cut_cell_members(voronoicell &c,double x,double y,double z,unsigned int mask) {
+			return !(mask&1)||cut_cell(c,x,y,z);
+		}
+		/** A virtual function for cutting a cell with
+		 * neighbor-tracking enabled with some of the members of the
+		 * wall object, in the same way as the function above. */
+		virtual bool cut_cell_members(voronoicell_neighbor &c,double x,double y,double z,unsigned int mask) {
+			return !(mask&1)||cut_cell(c,x,y,z);
+		}
+	protected:
+		bool corners_inside(double xl,double xh,double yl,double yh,double zl,double zh);
 };
 
 /** \brief A class for storing a list of pointers to walls.
@@ -61,10 +118,12 @@ class wall_list {
 		 */
 		wall **wep;
 		wall_list();
-		~wall_list();
-		/** Adds a wall to the list.
+		virtual ~wall_list();
+		/** Adds a wall to the list. This is virtual so that a
+		 * container also indexes the walls that are added to it
+		 * through the wall_list interface.
 		 * \param[in] w the wall to add. */
-		inline void add_wall(wall *w) {
+		virtual void add_wall(wall *w) {
 			if(wep==wel) increase_wall_memory();
 			*(wep++)=w;
 		}
@@ -166,6 +225,8 @@ class container_base : public voro_base, public wall_list {
 				int nx_,int ny_,int nz_,bool xperiodic_,bool yperiodic_,bool zperiodic_,
 				int init_mem,int ps_);
 		~container_base();
+		using wall_list::add_wall;
+		void add_wall(wall *w);
 		bool point_inside(double x,double y,double z);
 		void region_count();
 		/** Initializes the Voronoi cell prior to a compute_cell
@@ -198,10 +259,74 @@ class container_base : public voro_base, public wall_list {
 			if(yperiodic) {y1=-(y2=0.5*(by-ay));j=ny;} else {y1=ay-y;y2=by-y;j=cj;}
 			if(zperiodic) {z1=-(z2=0.5*(bz-az));k=nz;} else {z1=az-z;z2=bz-z;k=ck;}
 			c.init(x1,x2,y1,y2,z1,z2);
-			if(!apply_walls(c,x,y,z)) return false;
+			for(int *wp=wnear+wnear_s[ijk],*we=wnear+wnear_s[ijk+1];wp<we;wp++)
+				if(!wlate[*wp]&&!cut_wall(c,*wp,wmask[wp-wnear],x,y,z)) return false;
 			disp=ijk-i-nx*(j+ny*k);
 			return true;
 		}
+		/** Completes the Voronoi cell after a compute_cell operation
+		 * for a specific particle has been carried out by a
+		 * voro_compute class. The initialize_voronoicell routine only
+		 * applies the walls, and the members of combined walls, that
+		 * may cut cells in the particle's block. The others contain
+		 * the block expanded by one block length in each direction,
+		 * so they cannot cut the cell if it lies within a sphere that
+		 * fits inside this expanded box. Otherwise, they are applied
+		 * here. Walls that request to
+		 * be cut after the search are also applied here. Since the
+		 * walls and the other particles cut the cell by fixed planes,
+		 * this gives the same cell as applying all walls at the
+		 * start.
+		 * \param[in,out] c a reference to a voronoicell object.
+		 * \param[in] ijk the block that the particle is within.
+		 * \param[in] q the index of the particle within its block.
+		 * \return False if the plane cuts applied by walls completely
+		 * removed the cell, true otherwise. */
+		template<class v_cell>
+		inline bool finalize_voronoicell(v_cell &c,int ijk,int q) {
+			int *wp=wnear+wnear_s[ijk],*we=wnear+wnear_s[ijk+1],w=0,nw=wep-walls;
+			bool far=wpart[ijk]&&c.max_radius_squared()>wall_margin_sq;
+			if(!far&&nlate==0) return true;
+			double *pp=p[ijk]+ps*q;
+			unsigned int m,mask;
+			for(;w<nw;w++) {
+				m=wp<we&&*wp==w?wmask[(wp++)-wnear]:0;
+				mask=(wlate[w]?m:0)|(far?wfull[w]&~m:0);
+				if(mask&&!cut_wall(c,w,mask,*pp,pp[1],pp[2])) return false;
+			}
+			return true;
+		}
+		/** Cuts a Voronoi cell by some of the members of a wall,
+		 * making a single cut_cell call when all of them apply.
+		 * \param[in,out] c a reference to a voronoicell object.
+		 * \param[in] w the index of the wall.
+		 * \param[in] mask a bit mask of the members to apply.
+		 * \param[in] (x,y,z) the position of the particle.
+		 * \return False if the cell was completely removed, true
+		 *         otherwise. */
+		template<class v_cell>
+		inline bool cut_wall(v_cell &c,int w,unsigned int mask,double x,double y,double z) {
+			return mask==wfull[w]?walls[w]->cut_cell(c,x,y,z):walls[w]->cut_cell_members(c,x,y,z,mask);
+		}
+		/** Computes the vector from a particle to a candidate neighbor,
+		 * as used by the compute_cell routines that take a list of
+		 * candidates. In periodic directions, the nearest periodic
+		 * image of the candidate is used.
+		 * \param[in] (ijk,q) the block and index of the particle.
+		 * \param[in] (x,y,z) the position of the particle.
+		 * \param[in] (cijk,cq) the block and index of the candidate.
+		 * \param[out] (x1,y1,z1) the vector to the candidate.
+		 * \return False if the candidate is the particle itself, true
+		 *         otherwise. */
+		inline bool candidate_vector(int ijk,int q,double x,double y,double z,int cijk,int cq,double &x1,double &y1,double &z1) {
+			if(cijk==ijk&&cq==q) return false;
+			double *pp=p[cijk]+ps*cq;
+			x1=*pp-x;y1=pp[1]-y;z1=pp[2]-z;
+			if(xperiodic) x1-=(bx-ax)*floor(x1/(bx-ax)+0.5);
+			if(yperiodic) y1-=(by-ay)*floor(y1/(by-ay)+0.5);
+			if(zperiodic) z1-=(bz-az)*floor(z1/(bz-az)+0.5);
+			return true;
+		}
 		/** Initializes parameters for a find_voronoi_cell call within
 		 * the voro_compute template.
 		 * \param[in] (ci,cj,ck) the coordinates of the test block in
@@ -277,6 +402,31 @@ class container_base : public voro_base, public wall_list {
         int already_in_block(double x, double y, double z, double threshold, int except_cell=-1); // checks if pt w/ these coords is already in the same block
     
 	protected:
+		/** The index of the first entry for each block in the wnear
+		 * array, with an additional final entry marking the end of the
+		 * array. */
+		int *wnear_s;
+		/** The indices of the walls that may cut the cells of each
+		 * block, in increasing order. */
+		int *wnear;
+		/** For each entry of the wnear array, a bit mask of the
+		 * members of the wall that may cut the cells of the block. */
+		unsigned int *wmask;
+		/** An array recording whether each wall is applied after the
+		 * cell has been cut by the neighboring particles. */
+		bool *wlate;
+		/** The bit mask of all the members of each wall. */
+		unsigned int *wfull;
+		/** An array recording whether any walls, or members of walls,
+		 * are left off the lists for each block. */
+		bool *wpart;
+		/** The number of walls that are applied after the cell has
+		 * been cut by the neighboring particles. */
+		int nlate;
+		/** The square of twice the smallest block length. If a cell's
+		 * max_radius_squared is below this, then it cannot be cut by
+		 * the walls that are not listed for its block. */
+		const double wall_margin_sq;
 		void add_particle_memory(int i);
 		bool put_locate_block(int &ijk,double &x,double &y,double &z);
 		inline bool put_remap(int &ijk,double &x,double &y,double &z);
@@ -442,22 +592,47 @@ class container : public container_base, public radius_mono {
 		template<class c_loop>
 		void print_custom(c_loop &vl,const char *format,FILE *fp) {
 			int ijk,q;double *pp;
-			if(contains_neighbor(format)) {
+			custom_format cf(format);
+			voro_out_buffer ob(fp);
+			if(cf.neighbor) {
 				voronoicell_neighbor c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],default_radius,fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
 				} while(vl.inc());
 			} else {
 				voronoicell c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],default_radius,fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
 				} while(vl.inc());
 			}
 		}
+		void print_custom(c_loop_order_sorted &vl,const char *format,FILE *fp);
 		void print_custom(const char *format,FILE *fp=stdout);
 		void print_custom(const char *format,const char *filename);
+		/** Computes the Voronoi cells and writes chosen quantities
+		 * about them to binary files.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] bo the binary output class to write with. */
+		template<class c_loop>
+		void print_binary(c_loop &vl,binary_output &bo) {
+			int ijk,q;double *pp;
+			if(bo.neighbor) {
+				voronoicell_neighbor c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius);
+				} while(vl.inc());
+			} else {
+				voronoicell c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius);
+				} while(vl.inc());
+			}
+		}
+		void print_binary(const char *columns,const char *prefix);
 		bool find_voronoi_cell(double x,double y,double z,double &rx,double &ry,double &rz,int &pid);
 		/** Computes the Voronoi cell for a particle currently being
 		 * referenced by a loop class.
@@ -471,6 +646,29 @@ class container : public container_base, public radius_mono {
 		inline bool compute_cell(v_cell &c,c_loop &vl) {
 			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k);
 		}
+		/** Computes the Voronoi cell for a particle currently being
+		 * referenced by a loop class, by first cutting it with a list
+		 * of candidate neighbors. The candidates are typically the
+		 * neighbors of the particle in a previous frame, as given by
+		 * voronoicell_neighbor::neighbors(). If the particles have
+		 * only moved slightly, then the candidates reduce the cell to
+		 * nearly its final size, and the usual search only confirms
+		 * that the cell is complete, so that far fewer plane cuts are
+		 * made. Any candidates can be supplied, and the cell is the
+		 * same as that from the routine above, up to round-off. Wall
+		 * IDs, and IDs that are not in the lookup table, are ignored.
+		 * \param[out] c a Voronoi cell class in which to store the
+		 * 		 computed cell.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] cand the IDs of the candidate neighbors.
+		 * \param[in] pl a lookup table giving the locations of the
+		 *               particles, built after they were added.
+		 * \return True if the cell was computed, false if it was
+		 * removed entirely. */
+		template<class v_cell,class c_loop>
+		inline bool compute_cell(v_cell &c,c_loop &vl,const std::vector<int> &cand,const particle_lookup &pl) {
+			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k,cand.empty()?NULL:&cand[0],cand.size(),pl);
+		}
 		/** Computes the Voronoi cell for given particle.
 		 * \param[out] c a Voronoi cell class in which to store the
 		 * 		 computed cell.
@@ -683,17 +881,19 @@ class container_poly : public container_base, public radius_poly {
 		template<class c_loop>
 		void print_custom(c_loop &vl,const char *format,FILE *fp) {
 			int ijk,q;double *pp;
-			if(contains_neighbor(format)) {
+			custom_format cf(format);
+			voro_out_buffer ob(fp);
+			if(cf.neighbor) {
 				voronoicell_neighbor c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],pp[3],fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
 				} while(vl.inc());
 			} else {
 				voronoicell c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],pp[3],fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
 				} while(vl.inc());
 			}
 		}
@@ -709,6 +909,22 @@ class container_poly : public container_base, public radius_poly {
 		inline bool compute_cell(v_cell &c,c_loop &vl) {
 			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k);
 		}
+		/** Computes the Voronoi cell for a particle currently being
+		 * referenced by a loop class, by first cutting it with a list
+		 * of candidate neighbors, as described for
+		 * container::compute_cell().
+		 * \param[out] c a Voronoi cell class in which to store the
+		 * 		 computed cell.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] cand the IDs of the candidate neighbors.
+		 * \param[in] pl a lookup table giving the locations of the
+		 *               particles.
+		 * \return True if the cell was computed, false if it was
+		 * removed entirely. */
+		template<class v_cell,class c_loop>
+		inline bool compute_cell(v_cell &c,c_loop &vl,const std::vector<int> &cand,const particle_lookup &pl) {
+			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k,cand.empty()?NULL:&cand[0],cand.size(),pl);
+		}
 		/** Computes the Voronoi cell for given particle.
 		 * \param[out] c a Voronoi cell class in which to store the
 		 * 		 computed cell.
@@ -744,8 +960,31 @@ class container_poly : public container_base, public radius_poly {
 			}
 			return false;
 		}
+		void print_custom(c_loop_order_sorted &vl,const char *format,FILE *fp);
 		void print_custom(const char *format,FILE *fp=stdout);
 		void print_custom(const char *format,const char *filename);
+		/** Computes the Voronoi cells and writes chosen quantities
+		 * about them to binary files.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] bo the binary output class to write with. */
+		template<class c_loop>
+		void print_binary(c_loop &vl,binary_output &bo) {
+			int ijk,q;double *pp;
+			if(bo.neighbor) {
+				voronoicell_neighbor c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3]);
+				} while(vl.inc());
+			} else {
+				voronoicell c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3]);
+				} while(vl.inc());
+			}
+		}
+		void print_binary(const char *columns,const char *prefix);
 		bool find_voronoi_cell(double x,double y,double z,double &rx,double &ry,double &rz,int &pid);
 	private:
 		voro_compute<container_poly> vc;
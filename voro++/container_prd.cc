@@ -482,6 +482,16 @@ void container_periodic::print_custom(const char *format,const char *filename) {
 	fclose(fp);
 }
 
+/** Computes all the Voronoi cells and writes chosen quantities about them to
+ * binary files, as described in the binary_output class.
+ * \param[in] columns the letters of the quantities to write.
+ * \param[in] prefix the prefix of the filenames to write to. */
+void container_periodic::print_binary(const char *columns,const char *prefix) {
+	binary_output bo(columns,prefix);
+	c_loop_all_periodic vl(*this);
+	print_binary(vl,bo);
+}
+
 /** Computes all the Voronoi cells and saves customized
  * information about them
  * \param[in] format the custom output string to use.
@@ -492,6 +502,16 @@ void container_periodic_poly::print_custom(const char *format,const char *filena
 	fclose(fp);
 }
 
+/** Computes all the Voronoi cells and writes chosen quantities about them to
+ * binary files, as described in the binary_output class.
+ * \param[in] columns the letters of the quantities to write.
+ * \param[in] prefix the prefix of the filenames to write to. */
+void container_periodic_poly::print_binary(const char *columns,const char *prefix) {
+	binary_output bo(columns,prefix);
+	c_loop_all_periodic vl(*this);
+	print_binary(vl,bo);
+}
+
 /** Computes all of the Voronoi cells in the container, but does nothing
  * with the output. It is useful for measuring the pure computation time
  * of the Voronoi algorithm, without any additional calculations such as
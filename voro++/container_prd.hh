@@ -18,6 +18,8 @@
 #include "v_base.hh"
 #include "cell.hh"
 #include "c_loops.hh"
+#include "custom_format.hh"
+#include "binary_output.hh"
 #include "v_compute.hh"
 #include "unitcell.hh"
 #include "rad_option.hh"
@@ -128,6 +130,30 @@ class container_periodic_base : public unitcell, public voro_base {
 			i=nx;j=ey;k=ez;
 			return true;
 		}
+		/** Completes the Voronoi cell after a compute_cell operation.
+		 * The periodic container has no walls, so this does nothing.
+		 * \return True, since the cell is never removed. */
+		template<class v_cell>
+		inline bool finalize_voronoicell(v_cell &c,int ijk,int q) {return true;}
+		/** Computes the vector from a particle to a candidate neighbor,
+		 * as used by the compute_cell routines that take a list of
+		 * candidates. The candidate is shifted by the periodicity
+		 * vectors to the image that is approximately nearest.
+		 * \param[in] (ijk,q) the block and index of the particle.
+		 * \param[in] (x,y,z) the position of the particle.
+		 * \param[in] (cijk,cq) the block and index of the candidate.
+		 * \param[out] (x1,y1,z1) the vector to the candidate.
+		 * \return False if the candidate is the particle itself, true
+		 *         otherwise. */
+		inline bool candidate_vector(int ijk,int q,double x,double y,double z,int cijk,int cq,double &x1,double &y1,double &z1) {
+			if(cijk==ijk&&cq==q) return false;
+			double *pp=p[cijk]+ps*cq,s;
+			x1=*pp-x;y1=pp[1]-y;z1=pp[2]-z;
+			s=floor(z1/bz+0.5);x1-=s*bxz;y1-=s*byz;z1-=s*bz;
+			s=floor(y1/by+0.5);x1-=s*bxy;y1-=s*by;
+			x1-=bx*floor(x1/bx+0.5);
+			return true;
+		}
 		/** Initializes parameters for a find_voronoi_cell call within
 		 * the voro_compute template.
 		 * \param[in] (ci,cj,ck) the coordinates of the test block in
@@ -359,22 +385,46 @@ class container_periodic : public container_periodic_base, public radius_mono {
 		template<class c_loop>
 		void print_custom(c_loop &vl,const char *format,FILE *fp) {
 			int ijk,q;double *pp;
-			if(contains_neighbor(format)) {
+			custom_format cf(format);
+			voro_out_buffer ob(fp);
+			if(cf.neighbor) {
 				voronoicell_neighbor c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],default_radius,fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
 				} while(vl.inc());
 			} else {
 				voronoicell c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],default_radius,fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius,ob);
 				} while(vl.inc());
 			}
 		}
 		void print_custom(const char *format,FILE *fp=stdout);
 		void print_custom(const char *format,const char *filename);
+		/** Computes the Voronoi cells and writes chosen quantities
+		 * about them to binary files.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] bo the binary output class to write with. */
+		template<class c_loop>
+		void print_binary(c_loop &vl,binary_output &bo) {
+			int ijk,q;double *pp;
+			if(bo.neighbor) {
+				voronoicell_neighbor c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius);
+				} while(vl.inc());
+			} else {
+				voronoicell c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],default_radius);
+				} while(vl.inc());
+			}
+		}
+		void print_binary(const char *columns,const char *prefix);
 		bool find_voronoi_cell(double x,double y,double z,double &rx,double &ry,double &rz,int &pid);
 		/** Computes the Voronoi cell for a particle currently being
 		 * referenced by a loop class.
@@ -388,6 +438,22 @@ class container_periodic : public container_periodic_base, public radius_mono {
 		inline bool compute_cell(v_cell &c,c_loop &vl) {
 			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k);
 		}
+		/** Computes the Voronoi cell for a particle currently being
+		 * referenced by a loop class, by first cutting it with a list
+		 * of candidate neighbors, as described for
+		 * container::compute_cell().
+		 * \param[out] c a Voronoi cell class in which to store the
+		 * 		 computed cell.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] cand the IDs of the candidate neighbors.
+		 * \param[in] pl a lookup table giving the locations of the
+		 *               particles.
+		 * \return True if the cell was computed, false if it was
+		 * removed entirely. */
+		template<class v_cell,class c_loop>
+		inline bool compute_cell(v_cell &c,c_loop &vl,const std::vector<int> &cand,const particle_lookup &pl) {
+			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k,cand.empty()?NULL:&cand[0],cand.size(),pl);
+		}
 		/** Computes the Voronoi cell for given particle.
 		 * \param[out] c a Voronoi cell class in which to store the
 		 * 		 computed cell.
@@ -582,17 +648,19 @@ class container_periodic_poly : public container_periodic_base, public radius_po
 		template<class c_loop>
 		void print_custom(c_loop &vl,const char *format,FILE *fp) {
 			int ijk,q;double *pp;
-			if(contains_neighbor(format)) {
+			custom_format cf(format);
+			voro_out_buffer ob(fp);
+			if(cf.neighbor) {
 				voronoicell_neighbor c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],pp[3],fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
 				} while(vl.inc());
 			} else {
 				voronoicell c;
 				if(vl.start()) do if(compute_cell(c,vl)) {
 					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
-					c.output_custom(format,id[ijk][q],*pp,pp[1],pp[2],pp[3],fp);
+					cf.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3],ob);
 				} while(vl.inc());
 			}
 		}
@@ -608,6 +676,22 @@ class container_periodic_poly : public container_periodic_base, public radius_po
 		inline bool compute_cell(v_cell &c,c_loop &vl) {
 			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k);
 		}
+		/** Computes the Voronoi cell for a particle currently being
+		 * referenced by a loop class, by first cutting it with a list
+		 * of candidate neighbors, as described for
+		 * container::compute_cell().
+		 * \param[out] c a Voronoi cell class in which to store the
+		 * 		 computed cell.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] cand the IDs of the candidate neighbors.
+		 * \param[in] pl a lookup table giving the locations of the
+		 *               particles.
+		 * \return True if the cell was computed, false if it was
+		 * removed entirely. */
+		template<class v_cell,class c_loop>
+		inline bool compute_cell(v_cell &c,c_loop &vl,const std::vector<int> &cand,const particle_lookup &pl) {
+			return vc.compute_cell(c,vl.ijk,vl.q,vl.i,vl.j,vl.k,cand.empty()?NULL:&cand[0],cand.size(),pl);
+		}
 		/** Computes the Voronoi cell for given particle.
 		 * \param[out] c a Voronoi cell class in which to store the
 		 * 		 computed cell.
@@ -643,6 +727,28 @@ class container_periodic_poly : public container_periodic_base, public radius_po
 		}
 		void print_custom(const char *format,FILE *fp=stdout);
 		void print_custom(const char *format,const char *filename);
+		/** Computes the Voronoi cells and writes chosen quantities
+		 * about them to binary files.
+		 * \param[in] vl the loop class to use.
+		 * \param[in] bo the binary output class to write with. */
+		template<class c_loop>
+		void print_binary(c_loop &vl,binary_output &bo) {
+			int ijk,q;double *pp;
+			if(bo.neighbor) {
+				voronoicell_neighbor c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3]);
+				} while(vl.inc());
+			} else {
+				voronoicell c;
+				if(vl.start()) do if(compute_cell(c,vl)) {
+					ijk=vl.ijk;q=vl.q;pp=p[ijk]+ps*q;
+					bo.output(c,id[ijk][q],*pp,pp[1],pp[2],pp[3]);
+				} while(vl.inc());
+			}
+		}
+		void print_binary(const char *columns,const char *prefix);
 		bool find_voronoi_cell(double x,double y,double z,double &rx,double &ry,double &rz,int &pid);
 	private:
 		voro_compute<container_periodic_poly> vc;
@@ -0,0 +1,297 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file custom_format.cc
+ * \brief Function implementations for the custom_format class. */
+
+#include <cmath>
+#include <cstring>
+
+#include "custom_format.hh"
+
+namespace voro {
+
+/** The class constructor parses a custom output format string into a list of
+ * operations, and determines which per-face quantities are required.
+ * \param[in] format the custom format string to parse. */
+custom_format::custom_format(const char *format) : neighbor(false), fl(0) {
+	const char *fmp=format;
+	format_op o;
+	while(*fmp!=0) {
+		if(*fmp=='%'&&fmp[1]!=0&&strchr("ixyzqrwpPomgEesFAaftlnvcC",fmp[1])!=NULL) {
+			o.c=*(++fmp);o.s=o.l=0;
+			ops.push_back(o);
+			switch(o.c) {
+				case 'e': fl|=need_perimeters;break;
+				case 's': fl|=need_count;break;
+				case 'F': fl|=need_surface;break;
+				case 'A':
+				case 'a': fl|=need_orders;break;
+				case 'f': fl|=need_areas;break;
+				case 't': fl|=need_vertices;break;
+				case 'l': fl|=need_normals;break;
+				case 'n': fl|=need_neighbors;neighbor=true;break;
+				case 'v': fl|=need_volume;break;
+				case 'c':
+				case 'C': fl|=need_centroid;
+			}
+		} else if(*fmp!='%'||fmp[1]!=0) {
+
+			// Append the character to the literal text, extending
+			// the previous literal operation if there is one.
+			// A percent sign that is not part of a control
+			// sequence is written out along with the character
+			// after it, as in output_custom(), while one at the
+			// end of the string is ignored.
+			if(ops.empty()||ops.back().c!=0) {
+				o.c=0;o.s=lit.size();o.l=0;
+				ops.push_back(o);
+			}
+			if(*fmp=='%') {lit.push_back(*(fmp++));ops.back().l++;}
+			lit.push_back(*fmp);
+			ops.back().l++;
+		}
+		fmp++;
+	}
+}
+
+/** Outputs a custom string of information about a Voronoi cell, in the same
+ * form as voronoicell_base::output_custom().
+ * \param[in] c the Voronoi cell to output.
+ * \param[in] i the ID of the particle associated with the cell.
+ * \param[in] (x,y,z) the position of the particle.
+ * \param[in] r the radius of the particle.
+ * \param[in] ob the buffer to write to. */
+template<class v_cell>
+void custom_format::output(v_cell &c,int i,double x,double y,double z,double r,voro_out_buffer &ob) {
+	if(fl!=0) face_traversal(c);
+	for(std::vector<format_op>::iterator op=ops.begin();op!=ops.end();op++) {
+		switch(op->c) {
+
+			// Literal text
+			case 0: ob.put(&lit[op->s],op->l);break;
+
+			// Particle-related output
+			case 'i': ob.put_int(i);break;
+			case 'x': ob.put_double(x);break;
+			case 'y': ob.put_double(y);break;
+			case 'z': ob.put_double(z);break;
+			case 'q': ob.put_double(x);ob.put(' ');
+				  ob.put_double(y);ob.put(' ');
+				  ob.put_double(z);break;
+			case 'r': ob.put_double(r);break;
+
+			// Vertex-related output
+			case 'w': ob.put_int(c.p);break;
+			case 'p': for(double *ptsp=c.pts;ptsp<c.pts+3*c.p;ptsp+=3) {
+					  if(ptsp>c.pts) ob.put(' ');
+					  ob.put('(');ob.put_double(*ptsp*0.5);
+					  ob.put(',');ob.put_double(ptsp[1]*0.5);
+					  ob.put(',');ob.put_double(ptsp[2]*0.5);
+					  ob.put(')');
+				  } break;
+			case 'P': for(double *ptsp=c.pts;ptsp<c.pts+3*c.p;ptsp+=3) {
+					  if(ptsp>c.pts) ob.put(' ');
+					  ob.put('(');ob.put_double(x+*ptsp*0.5);
+					  ob.put(',');ob.put_double(y+ptsp[1]*0.5);
+					  ob.put(',');ob.put_double(z+ptsp[2]*0.5);
+					  ob.put(')');
+				  } break;
+			case 'o': for(int j=0;j<c.p;j++) {
+					  if(j>0) ob.put(' ');
+					  ob.put_int(c.nu[j]);
+				  } break;
+			case 'm': ob.put_double(0.25*c.max_radius_squared());break;
+
+			// Edge-related output
+			case 'g': ob.put_int(c.number_of_edges());break;
+			case 'E': ob.put_double(c.total_edge_distance());break;
+			case 'e': ob.put_vector(fp);break;
+
+			// Face-related output
+			case 's': ob.put_int(nf);break;
+			case 'F': ob.put_double(0.125*sa);break;
+			case 'A': {
+					  ft.clear();
+					  for(unsigned int j=0;j<fo.size();j++) {
+						  if((unsigned int) fo[j]>=ft.size()) ft.resize(fo[j]+1,0);
+						  ft[fo[j]]++;
+					  }
+					  ob.put_vector(ft);
+				  } break;
+			case 'a': ob.put_vector(fo);break;
+			case 'f': ob.put_vector(fa);break;
+			case 't': ob.put_face_vertices(fv);break;
+			case 'l': ob.put_positions(nv);break;
+			case 'n': ob.put_vector(fn);break;
+
+			// Volume-related output
+			case 'v': ob.put_double(vol*(1/48.0));break;
+			case 'c':
+			case 'C': {
+					  double ox=cx,oy=cy,oz=cz;
+					  if(op->c=='C') {ox+=x;oy+=y;oz+=z;}
+					  ob.put_double(ox);ob.put(' ');
+					  ob.put_double(oy);ob.put(' ');
+					  ob.put_double(oz);
+				  }
+		}
+	}
+	ob.put('\n');
+}
+
+/** Computes all of the per-face quantities that the format requires in a
+ * single traversal of the faces of a cell. The faces are visited in the same
+ * order, and the quantities are accumulated in the same order, as in the
+ * separate routines of the voronoicell_base class, so that the results are
+ * identical.
+ * \param[in] c the Voronoi cell to consider. */
+template<class v_cell>
+void custom_format::face_traversal(v_cell &c) {
+	int i,j,k,l,m,q;
+	double *pts=c.pts,ux,uy,uz,vx,vy,vz,wx,wy,wz,ax,ay,az,tvol,area,perim=0;
+	bool fvt=(fl&(need_vertices|need_normals))!=0,
+	     tri=(fl&(need_areas|need_surface))!=0,
+	     vlt=(fl&(need_volume|need_centroid))!=0;
+	nf=0;vol=sa=cx=cy=cz=0;
+	fo.clear();fv.clear();fn.clear();fa.clear();fp.clear();nv.clear();
+	c.start_traversal();
+	for(i=1;i<c.p;i++) for(j=0;j<c.nu[i];j++) {
+		if(c.edge_marked(i,j)) continue;
+		k=c.ed[i][j];
+		nf++;
+		if(fl&need_neighbors) add_neighbor(c,i,j);
+		if(fvt) {cf.clear();cf.push_back(i);}
+		q=1;area=0;
+		ux=*pts-pts[3*i];
+		uy=pts[1]-pts[3*i+1];
+		uz=pts[2]-pts[3*i+2];
+		if(fl&need_perimeters) {
+			wx=pts[3*k]-pts[3*i];
+			wy=pts[3*k+1]-pts[3*i+1];
+			wz=pts[3*k+2]-pts[3*i+2];
+			perim=sqrt(wx*wx+wy*wy+wz*wz);
+		}
+		c.mark_edge(i,j);
+		l=c.cycle_up(c.ed[i][c.nu[i]+j],k);
+		do {
+			q++;
+			if(fvt) cf.push_back(k);
+			m=c.ed[k][l];c.mark_edge(k,l);
+			if(fl&need_perimeters) {
+				wx=pts[3*m]-pts[3*k];
+				wy=pts[3*m+1]-pts[3*k+1];
+				wz=pts[3*m+2]-pts[3*k+2];
+				perim+=sqrt(wx*wx+wy*wy+wz*wz);
+			}
+			if(m!=i) {
+
+				// Compute the area of the triangle formed by
+				// vertices i, k, and m
+				if(tri) {
+					vx=pts[3*k]-pts[3*i];
+					vy=pts[3*k+1]-pts[3*i+1];
+					vz=pts[3*k+2]-pts[3*i+2];
+					wx=pts[3*m]-pts[3*i];
+					wy=pts[3*m+1]-pts[3*i+1];
+					wz=pts[3*m+2]-pts[3*i+2];
+					ax=vy*wz-vz*wy;
+					ay=vz*wx-vx*wz;
+					az=vx*wy-vy*wx;
+					tvol=sqrt(ax*ax+ay*ay+az*az);
+					area+=tvol;sa+=tvol;
+				}
+
+				// Compute the volume of the tetrahedron formed
+				// by the triangle and the zeroth vertex
+				if(vlt) {
+					vx=pts[3*k]-*pts;
+					vy=pts[3*k+1]-pts[1];
+					vz=pts[3*k+2]-pts[2];
+					wx=pts[3*m]-*pts;
+					wy=pts[3*m+1]-pts[1];
+					wz=pts[3*m+2]-pts[2];
+					tvol=ux*vy*wz+uy*vz*wx+uz*vx*wy-uz*vy*wx-uy*vx*wz-ux*vz*wy;
+					vol+=tvol;
+					cx+=(wx+vx-ux)*tvol;
+					cy+=(wy+vy-uy)*tvol;
+					cz+=(wz+vz-uz)*tvol;
+				}
+			}
+			l=c.cycle_up(c.ed[k][c.nu[k]+l],m);
+			k=m;
+		} while(k!=i);
+		if(fl&need_orders) fo.push_back(q);
+		if(fl&need_areas) fa.push_back(0.125*area);
+		if(fl&need_perimeters) fp.push_back(0.5*perim);
+		if(fl&need_vertices) {
+			fv.push_back(cf.size());
+			fv.insert(fv.end(),cf.begin(),cf.end());
+		}
+		if(fl&need_normals) face_normal(c);
+	}
+
+	// Normalize the centroid
+	if(fl&need_centroid) {
+		if(vol>tolerance_sq) {
+			tvol=0.125/vol;
+			cx=cx*tvol+0.5*(*pts);
+			cy=cy*tvol+0.5*pts[1];
+			cz=cz*tvol+0.5*pts[2];
+		} else cx=cy=cz=0;
+	}
+}
+
+/** Computes the normal vector of the current face, whose vertices are held
+ * in the cf array. The normal is constructed from the first pair of edges
+ * whose lengths and vector product are above the numerical tolerance, in the
+ * same way as voronoicell_base::normals(), and it is (0,0,0) if no such pair
+ * exists.
+ * \param[in] c the Voronoi cell to consider. */
+void custom_format::face_normal(voronoicell_base &c) {
+	int a,b,n=cf.size();
+	double *pts=c.pts,*p0,*p1,ux,uy,uz,vx,vy,vz,wx,wy,wz,wmag;
+	for(a=1;a<n;a++) {
+		p0=pts+3*cf[a];p1=pts+3*cf[a+1<n?a+1:0];
+		ux=*p1-*p0;uy=p1[1]-p0[1];uz=p1[2]-p0[2];
+
+		// Test to see if the length of this edge is above the
+		// tolerance
+		if(ux*ux+uy*uy+uz*uz>tolerance_sq) {
+			for(b=a+1;b<n;b++) {
+				p0=pts+3*cf[b];p1=pts+3*cf[b+1<n?b+1:0];
+				vx=*p1-*p0;vy=p1[1]-p0[1];vz=p1[2]-p0[2];
+
+				// Construct the vector product of this edge
+				// with the first one, and test to see if it is
+				// above the tolerance
+				wx=uz*vy-uy*vz;
+				wy=ux*vz-uz*vx;
+				wz=uy*vx-ux*vy;
+				wmag=wx*wx+wy*wy+wz*wz;
+				if(wmag>tolerance_sq) {
+					wmag=1/sqrt(wmag);
+					nv.push_back(wx*wmag);
+					nv.push_back(wy*wmag);
+					nv.push_back(wz*wmag);
+					return;
+				}
+			}
+			break;
+		}
+	}
+	nv.push_back(0);
+	nv.push_back(0);
+	nv.push_back(0);
+}
+
+// Explicit instantiations
+template void custom_format::output(voronoicell&,int,double,double,double,double,voro_out_buffer&);
+template void custom_format::output(voronoicell_neighbor&,int,double,double,double,double,voro_out_buffer&);
+template void custom_format::face_traversal(voronoicell&);
+template void custom_format::face_traversal(voronoicell_neighbor&);
+
+}
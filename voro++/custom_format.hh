@@ -0,0 +1,111 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file custom_format.hh
+ * \brief Header file for the custom_format class. */
+
+#ifndef VOROPP_CUSTOM_FORMAT_HH
+#define VOROPP_CUSTOM_FORMAT_HH
+
+#include <vector>
+
+#include "config.hh"
+#include "common.hh"
+#include "cell.hh"
+
+namespace voro {
+
+/** \brief A class representing a custom output format string that has been
+ * parsed in advance.
+ *
+ * This class parses a custom output format string, as used by the
+ * voronoicell_base::output_custom() routine, into a list of operations. When a
+ * cell is output, all of the per-face quantities that the format requires are
+ * computed together in a single traversal of the faces of the cell, and the
+ * text is written through a voro_out_buffer. The output is identical to that
+ * of output_custom().
+ *
+ * The class holds the per-face quantities of the most recent cell in its own
+ * vectors, so each thread that writes output needs its own copy. */
+class custom_format {
+	public:
+		/** Whether the format requires neighbor information, which is
+		 * the case if it contains "%n". */
+		bool neighbor;
+		custom_format(const char *format);
+		template<class v_cell>
+		void output(v_cell &c,int i,double x,double y,double z,double r,voro_out_buffer &ob);
+	private:
+		/** \brief A single operation in a parsed format string. */
+		struct format_op {
+			/** The control character, or zero for a piece of
+			 * literal text. */
+			char c;
+			/** The start of the literal text within the lit
+			 * array. */
+			int s;
+			/** The length of the literal text. */
+			int l;
+		};
+		/** Flags for the per-face quantities that can be computed
+		 * during the face traversal. */
+		enum {
+			need_orders=1,need_areas=2,need_perimeters=4,
+			need_vertices=8,need_normals=16,need_neighbors=32,
+			need_volume=64,need_centroid=128,need_count=256,
+			need_surface=512
+		};
+		/** The list of operations. */
+		std::vector<format_op> ops;
+		/** The literal text in the format string. */
+		std::vector<char> lit;
+		/** The per-cell quantities that the format requires. */
+		unsigned int fl;
+		/** The number of faces of the current cell. */
+		int nf;
+		/** The volume of the current cell. */
+		double vol;
+		/** The total surface area of the current cell. */
+		double sa;
+		/** The centroid of the current cell, relative to the particle
+		 * position. */
+		double cx,cy,cz;
+		/** The orders of the faces of the current cell. */
+		std::vector<int> fo;
+		/** The vertices of the faces of the current cell, in the form
+		 * given by voronoicell_base::face_vertices(). */
+		std::vector<int> fv;
+		/** The neighbors of the faces of the current cell. */
+		std::vector<int> fn;
+		/** The frequency table of the face orders. */
+		std::vector<int> ft;
+		/** The areas of the faces of the current cell. */
+		std::vector<double> fa;
+		/** The perimeters of the faces of the current cell. */
+		std::vector<double> fp;
+		/** The normals of the faces of the current cell. */
+		std::vector<double> nv;
+		/** A scratch vector holding the vertices of the current
+		 * face. */
+		std::vector<int> cf;
+		template<class v_cell>
+		void face_traversal(v_cell &c);
+		void face_normal(voronoicell_base &c);
+		/** Records the neighbor of a face for a cell that carries
+		 * neighbor information.
+		 * \param[in] c the cell.
+		 * \param[in] (i,j) the vertex and edge index that the face
+		 *                  traversal started from. */
+		inline void add_neighbor(voronoicell_neighbor &c,int i,int j) {fn.push_back(c.ne[i][j]);}
+		/** Does nothing, since a cell without neighbor information
+		 * has no neighbors to record. */
+		inline void add_neighbor(voronoicell &c,int i,int j) {}
+		friend class binary_output;
+};
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file parallel.cc
+ * \brief Function implementations for the work-stealing task pool and the
+ * parallel output queue. */
+
+#include "parallel.hh"
+
+namespace voro {
+
+/** The class constructor divides the tasks into contiguous ranges of equal
+ * size, one for each thread.
+ * \param[in] ntasks the total number of tasks.
+ * \param[in] nt_ the number of threads. */
+task_pool::task_pool(int ntasks,int nt_) : nt(nt_), r(new task_range[nt_]) {
+	for(int t=0;t<nt;t++) {
+		r[t].lo=int((static_cast<long long>(ntasks)*t)/nt);
+		r[t].hi=int((static_cast<long long>(ntasks)*(t+1))/nt);
+	}
+}
+
+/** Hands out the next task for a given thread, stealing work from the other
+ * threads if its own range is empty.
+ * \param[in] t the thread number.
+ * \param[out] task the task to carry out.
+ * \return True if a task was found, false if there are no tasks left. */
+bool task_pool::next(int t,int &task) {
+	task_range &w=r[t];
+	do {
+#if VOROPP_THREADS ==1
+		std::lock_guard<std::mutex> g(w.m);
+#endif
+		if(w.lo<w.hi) {task=w.lo++;return true;}
+	} while(steal(t));
+	return false;
+}
+
+/** Steals the back half of the range of another thread, scanning the threads
+ * in turn starting from the next one. Only one range is locked at a time.
+ * \param[in] t the thread number of the thief.
+ * \return True if any tasks were stolen, false if all ranges are empty. */
+bool task_pool::steal(int t) {
+	int lo,hi;
+	for(int v=t+1;v<t+nt;v++) {
+		task_range &w=r[v%nt];
+		{
+#if VOROPP_THREADS ==1
+			std::lock_guard<std::mutex> g(w.m);
+#endif
+			if(w.lo>=w.hi) continue;
+			hi=w.hi;lo=w.hi-=(w.hi-w.lo+1)>>1;
+		}
+#if VOROPP_THREADS ==1
+		std::lock_guard<std::mutex> g(r[t].m);
+#endif
+		r[t].lo=lo;r[t].hi=hi;
+		return true;
+	}
+	return false;
+}
+
+
+/** The class constructor sets up an empty queue.
+ * \param[in] ntasks_ the total number of tasks.
+ * \param[in] window_ the maximum number of tasks that can be handed out but
+ *                    not yet written.
+ * \param[in] ordered_ whether to write the output in order of task number.
+ * \param[in] nf_ the number of files to write to.
+ * \param[in] fp_ the file handles to write to. */
+par_output_queue::par_output_queue(int ntasks_,int window_,bool ordered_,int nf_,FILE **fp_)
+	: ntasks(ntasks_), window(window_), ordered(ordered_), nf(nf_), fp(fp_,fp_+nf_),
+	nh(0), ns(0), nw(0), slot(ntasks_*nf_,static_cast<voro_out_buffer*>(NULL)) {}
+
+/** The class destructor frees any buffers that were not written. */
+par_output_queue::~par_output_queue() {
+	for(unsigned int i=0;i<slot.size();i++) if(slot[i]!=NULL) delete slot[i];
+}
+
+/** Hands out the next task, waiting if too many tasks are waiting to be
+ * written.
+ * \param[out] task the task to carry out.
+ * \return True if a task was handed out, false if there are no tasks left. */
+bool par_output_queue::next(int &task) {
+#if VOROPP_THREADS ==1
+	std::unique_lock<std::mutex> g(m);
+	while(nh<ntasks&&nh>=nw+window) cw.wait(g);
+#endif
+	if(nh>=ntasks) return false;
+	task=nh++;
+	return true;
+}
+
+/** Submits the formatted output of a task. If thread support is disabled, the
+ * output is written immediately.
+ * \param[in] task the task number.
+ * \param[in] ob the buffers holding the output for each file, which are freed
+ *               by the queue. */
+void par_output_queue::submit(int task,voro_out_buffer **ob) {
+#if VOROPP_THREADS ==1
+	{
+		std::lock_guard<std::mutex> g(m);
+		voro_out_buffer **sp=&slot[(ordered?task:ns)*nf];
+		for(int l=0;l<nf;l++) sp[l]=ob[l];
+		ns++;
+	}
+	cs.notify_one();
+#else
+	write_buffers(ob);nw++;ns++;
+#endif
+}
+
+/** Writes the submitted buffers until the output of all of the tasks has been
+ * written. This is run by the writer thread. */
+void par_output_queue::write() {
+#if VOROPP_THREADS ==1
+	std::vector<voro_out_buffer*> ob(nf);
+	while(true) {
+		{
+			std::unique_lock<std::mutex> g(m);
+			if(nw>=ntasks) return;
+			voro_out_buffer **sp=&slot[nw*nf];
+			while(*sp==NULL) cs.wait(g);
+			for(int l=0;l<nf;l++) {ob[l]=sp[l];sp[l]=NULL;}
+		}
+		write_buffers(&ob[0]);
+		{
+			std::lock_guard<std::mutex> g(m);
+			nw++;
+		}
+		cw.notify_all();
+	}
+#endif
+}
+
+/** Writes the buffers of a task to the files and frees them.
+ * \param[in] ob the buffers to write, one for each file. */
+void par_output_queue::write_buffers(voro_out_buffer **ob) {
+	for(int l=0;l<nf;l++) {
+		if(ob[l]->size()>0&&fwrite(ob[l]->data(),1,ob[l]->size(),fp[l])!=ob[l]->size())
+			voro_fatal_error("File write error",VOROPP_FILE_ERROR);
+		delete ob[l];
+	}
+}
+
+}
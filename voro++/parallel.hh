@@ -0,0 +1,603 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file parallel.hh
+ * \brief Header file for the work-stealing task pool and the parallel loop
+ * routines. */
+
+#ifndef VOROPP_PARALLEL_HH
+#define VOROPP_PARALLEL_HH
+
+#include <vector>
+
+#include "config.hh"
+#include "common.hh"
+#include "c_loops.hh"
+#include "v_compute.hh"
+#include "container.hh"
+#include "container_prd.hh"
+#include "custom_format.hh"
+
+#if VOROPP_THREADS ==1
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace voro {
+
+/** \brief A work-stealing scheduler for a fixed number of tasks.
+ *
+ * The tasks are numbered consecutively, and they are initially divided into
+ * contiguous ranges of equal size, one for each thread. Each thread takes
+ * tasks from the front of its own range. Once its range is empty, it steals
+ * the back half of the range of another thread. Threads that are given
+ * expensive tasks, such as blocks in a dense region of particles, are
+ * therefore relieved by the others. */
+class task_pool {
+	public:
+		/** The number of threads. */
+		const int nt;
+		task_pool(int ntasks,int nt_);
+		/** The destructor frees the dynamically allocated memory. */
+		~task_pool() {delete [] r;}
+		bool next(int t,int &task);
+	private:
+		/** \brief The range of tasks belonging to a single thread. */
+		struct task_range {
+#if VOROPP_THREADS ==1
+			/** A mutex protecting the range. */
+			std::mutex m;
+#endif
+			/** The next task in the range. */
+			int lo;
+			/** The end of the range, exclusive. */
+			int hi;
+			/** Padding so that the ranges of different threads are
+			 * on different cache lines. */
+			char pad[64];
+		};
+		/** The task ranges for each thread. */
+		task_range *r;
+		bool steal(int t);
+};
+
+/** Runs a function on several threads, passing each the number of the thread
+ * that it is running on. The calling thread is used as thread zero. If thread
+ * support is disabled, then the function is called for each thread number in
+ * turn.
+ * \param[in] nt the number of threads.
+ * \param[in] f the function to run. */
+template<class func>
+void voro_run_threads(int nt,func &f) {
+#if VOROPP_THREADS ==1
+	std::vector<std::thread> th;
+	for(int t=1;t<nt;t++) th.push_back(std::thread(std::ref(f),t));
+	f(0);
+	for(unsigned int t=0;t<th.size();t++) th[t].join();
+#else
+	for(int t=0;t<nt;t++) f(t);
+#endif
+}
+
+/** \brief A record of a particle visited by a loop class, as used by the
+ * parallel loop routines. */
+struct par_record {
+	/** The block that the particle is within. */
+	int ijk;
+	/** The index of the particle within its block. */
+	int q;
+	/** The x-index of the block, as given by the loop class. */
+	int i;
+	/** The y-index of the block, as given by the loop class. */
+	int j;
+	/** The z-index of the block, as given by the loop class. */
+	int k;
+};
+
+/** \brief A voro_compute class with its own scratch memory, for computing
+ * cells on a separate thread.
+ *
+ * The mask and queue within the container's voro_compute class can only be
+ * used by a single thread at a time. The container itself is only read while
+ * a cell is computed, so several threads may compute cells at once if each
+ * has one of these classes and its own Voronoi cell, provided that the
+ * container is not modified while they do so. The class is set up in the
+ * same way as the container's own voro_compute class, and it can be used with
+ * all of the container classes. */
+template<class c_class>
+class par_voro_compute : public voro_compute<c_class> {
+	public:
+		/** Sets up the class for a container with non-periodic
+		 * boundaries in some directions.
+		 * \param[in] con the container class to use. */
+		par_voro_compute(container_base &con)
+			: voro_compute<c_class>(static_cast<c_class&>(con),con.xperiodic?2*con.nx+1:con.nx,
+						con.yperiodic?2*con.ny+1:con.ny,con.zperiodic?2*con.nz+1:con.nz),
+			bx(con.nx), bxy(con.nxy) {}
+		/** Sets up the class for a periodic container.
+		 * \param[in] con the container class to use. */
+		par_voro_compute(container_periodic_base &con)
+			: voro_compute<c_class>(static_cast<c_class&>(con),2*con.nx+1,2*con.ey+1,2*con.ez+1),
+			bx(con.nx), bxy(con.nx*con.oy) {}
+		using voro_compute<c_class>::compute_cell;
+		/** Computes the Voronoi cell for a given particle, as in the
+		 * container's own compute_cell routine.
+		 * \param[out] c a Voronoi cell class in which to store the
+		 * 		 computed cell.
+		 * \param[in] ijk the block that the particle is within.
+		 * \param[in] q the index of the particle within the block.
+		 * \return True if the cell was computed, false if it was
+		 * removed entirely. */
+		template<class v_cell>
+		inline bool compute_cell(v_cell &c,int ijk,int q) {
+			int k=ijk/bxy,ijkt=ijk-bxy*k,j=ijkt/bx,i=ijkt-j*bx;
+			return voro_compute<c_class>::compute_cell(c,ijk,q,i,j,k);
+		}
+	private:
+		/** The number of blocks in the x direction. */
+		const int bx;
+		/** The number of blocks in an xy layer. */
+		const int bxy;
+};
+
+/** \brief The work carried out by each thread in the parallel loop routines.
+ *
+ * Each thread has its own Voronoi cell and its own par_voro_compute class. */
+template<class v_cell,class c_class,class func>
+class par_compute_worker {
+	public:
+		/** A reference to the container class. */
+		c_class &con;
+		/** A reference to the task scheduler. */
+		task_pool &tp;
+		/** A reference to the function to call for each computed
+		 * cell. */
+		func &f;
+		/** The boundaries of the tasks, in terms of blocks or
+		 * particle records. */
+		const int *tb;
+		/** The particle records, or NULL if the tasks are ranges of
+		 * blocks. */
+		const par_record *rec;
+		par_compute_worker(c_class &con_,task_pool &tp_,func &f_,const int *tb_,const par_record *rec_)
+			: con(con_), tp(tp_), f(f_), tb(tb_), rec(rec_) {}
+		/** Computes the cells in the tasks that are handed to a given
+		 * thread.
+		 * \param[in] t the thread number. */
+		void operator()(int t) {
+			v_cell c;
+			par_voro_compute<c_class> vc(con);
+			int task,ijk,q,i,j,k,l;
+			while(tp.next(t,task)) {
+				if(rec==NULL) {
+					for(ijk=tb[task];ijk<tb[task+1];ijk++) {
+						k=ijk/con.nxy;l=ijk-con.nxy*k;
+						j=l/con.nx;i=l-con.nx*j;
+						for(q=0;q<con.co[ijk];q++)
+							if(vc.compute_cell(c,ijk,q,i,j,k)) f(c,ijk,q,t);
+					}
+				} else for(l=tb[task];l<tb[task+1];l++) {
+					const par_record &w=rec[l];
+					if(vc.compute_cell(c,w.ijk,w.q,w.i,w.j,w.k)) f(c,w.ijk,w.q,t);
+				}
+			}
+		}
+};
+
+/** Records the particles visited by a loop class, and divides them into tasks
+ * of roughly parallel_task_particles particles each.
+ * \param[in] vl the loop class to use.
+ * \param[out] rec the particle records.
+ * \param[out] tb the boundaries of the tasks, in terms of particle records,
+ *                with one more entry than the number of tasks.
+ * \return The number of tasks. */
+template<class c_loop>
+int par_record_tasks(c_loop &vl,std::vector<par_record> &rec,std::vector<int> &tb) {
+	rec.clear();tb.clear();
+	if(vl.start()) do {
+		par_record w={vl.ijk,vl.q,vl.i,vl.j,vl.k};
+		rec.push_back(w);
+	} while(vl.inc());
+	int l,n=rec.size(),ntasks=(n+parallel_task_particles-1)/parallel_task_particles;
+	for(l=0;l<ntasks;l++) tb.push_back(l*parallel_task_particles);
+	tb.push_back(n);
+	return ntasks;
+}
+
+/** Divides the blocks of a container into tasks made up of ranges of
+ * consecutive blocks, each holding roughly parallel_task_particles particles.
+ * \param[in] con the container class to use.
+ * \param[out] tb the boundaries of the tasks, in terms of blocks, with one
+ *                more entry than the number of tasks.
+ * \return The number of tasks. */
+template<class c_class>
+int par_block_tasks(c_class &con,std::vector<int> &tb) {
+	int ijk=0,s;
+	tb.clear();
+	while(ijk<con.nxyz) {
+		tb.push_back(ijk);
+		for(s=0;ijk<con.nxyz&&s<parallel_task_particles;ijk++) s+=con.co[ijk];
+	}
+	int ntasks=tb.size();
+	tb.push_back(con.nxyz);
+	return ntasks;
+}
+
+/** Computes the Voronoi cells for all of the particles visited by a loop
+ * class, using several threads. The loop is first run to record the particles
+ * that it visits, and these are then divided into tasks that are scheduled
+ * with a work-stealing task pool. For each cell that is successfully computed,
+ * the function f is called as f(c,ijk,q,t), where c is the computed cell, ijk
+ * and q give the particle's location in the container, and t is the number of
+ * the thread. The function is called concurrently from different threads, in
+ * no particular order, and it must therefore only modify shared data in a
+ * thread-safe way, for example by storing results per particle or per thread.
+ * This routine can be used with the container and container_poly classes.
+ * \param[in] con the container class to use.
+ * \param[in] vl the loop class to use.
+ * \param[in] f the function to call for each computed cell.
+ * \param[in] nt the number of threads to use, or zero to use the number of
+ *               hardware threads that are available. */
+template<class v_cell,class c_class,class c_loop,class func>
+void compute_parallel(c_class &con,c_loop &vl,func &f,int nt=0) {
+	std::vector<par_record> rec;
+	std::vector<int> tb;
+	int ntasks=par_record_tasks(vl,rec,tb);
+	if(ntasks==0) return;
+	nt=voro_thread_count(nt);
+	if(nt>ntasks) nt=ntasks;
+	task_pool tp(ntasks,nt);
+	par_compute_worker<v_cell,c_class,func> wk(con,tp,f,&tb[0],&rec[0]);
+	voro_run_threads(nt,wk);
+}
+
+/** Computes the Voronoi cells for all of the particles in a container, using
+ * several threads. This version is used for the c_loop_all class, and
+ * schedules ranges of consecutive blocks directly, each holding roughly
+ * parallel_task_particles particles, without recording the particles first.
+ * The function f is called as described for the general version above.
+ * \param[in] con the container class to use.
+ * \param[in] vl the loop class to use.
+ * \param[in] f the function to call for each computed cell.
+ * \param[in] nt the number of threads to use, or zero to use the number of
+ *               hardware threads that are available. */
+template<class v_cell,class c_class,class func>
+void compute_parallel(c_class &con,c_loop_all &vl,func &f,int nt=0) {
+	std::vector<int> tb;
+	int ntasks=par_block_tasks(con,tb);
+	if(ntasks==0) return;
+	nt=voro_thread_count(nt);
+	if(nt>ntasks) nt=ntasks;
+	task_pool tp(ntasks,nt);
+	par_compute_worker<v_cell,c_class,func> wk(con,tp,f,&tb[0],NULL);
+	voro_run_threads(nt,wk);
+}
+
+/** \brief A queue that passes pieces of formatted output from the worker
+ * threads of the parallel output routines to a writer thread.
+ *
+ * The tasks are handed out in increasing order. Once a worker has formatted
+ * the output for a task into a buffer for each file, it submits the buffers to
+ * the queue, and the writer thread writes the buffers to the files, either in
+ * order of task number, so that the output is the same as a serial loop, or in
+ * the order that they were completed. To bound the memory use, a task is only
+ * handed out if fewer than a fixed number of tasks are waiting to be written.
+ */
+class par_output_queue {
+	public:
+		par_output_queue(int ntasks_,int window_,bool ordered_,int nf_,FILE **fp_);
+		~par_output_queue();
+		bool next(int &task);
+		void submit(int task,voro_out_buffer **ob);
+		void write();
+	private:
+		/** The total number of tasks. */
+		const int ntasks;
+		/** The maximum number of tasks that can be handed out but not
+		 * yet written. */
+		const int window;
+		/** Whether to write the output in order of task number. */
+		const bool ordered;
+		/** The number of files to write to. */
+		const int nf;
+		/** The file handles to write to. */
+		std::vector<FILE*> fp;
+		/** The next task to hand out. */
+		int nh;
+		/** The number of tasks that have been submitted. */
+		int ns;
+		/** The number of tasks that have been written. */
+		int nw;
+		/** The submitted buffers, with nf consecutive entries for
+		 * each task, indexed by task number if the output is ordered,
+		 * and by order of submission otherwise. */
+		std::vector<voro_out_buffer*> slot;
+#if VOROPP_THREADS ==1
+		/** A mutex protecting the queue. */
+		std::mutex m;
+		/** A condition variable for waking the writer when a buffer
+		 * is submitted. */
+		std::condition_variable cs;
+		/** A condition variable for waking the workers when a buffer
+		 * is written. */
+		std::condition_variable cw;
+#endif
+		void write_buffers(voro_out_buffer **ob);
+};
+
+/** \brief The work carried out by each thread in the parallel output
+ * routines.
+ *
+ * Each thread has its own Voronoi cell, its own voro_compute class, and its
+ * own copy of the formatting class, and it formats the output of each task
+ * into a separate buffer for each file. */
+template<class v_cell,class c_class,class f_class>
+class par_output_worker {
+	public:
+		/** A reference to the container class. */
+		c_class &con;
+		/** A reference to the output queue. */
+		par_output_queue &oq;
+		/** A reference to the formatting class, which is copied by
+		 * each thread. */
+		const f_class &fm;
+		/** The number of files to write to. */
+		const int nf;
+		/** The boundaries of the tasks, in terms of blocks or
+		 * particle records. */
+		const int *tb;
+		/** The particle records, or NULL if the tasks are ranges of
+		 * blocks. */
+		const par_record *rec;
+		par_output_worker(c_class &con_,par_output_queue &oq_,const f_class &fm_,int nf_,const int *tb_,const par_record *rec_)
+			: con(con_), oq(oq_), fm(fm_), nf(nf_), tb(tb_), rec(rec_) {}
+		/** Computes and formats the cells in the tasks that are handed
+		 * to a given thread.
+		 * \param[in] t the thread number. */
+		void operator()(int t) {
+			v_cell c;
+			f_class f(fm);
+			par_voro_compute<c_class> vc(con);
+			std::vector<voro_out_buffer*> ob(nf);
+			int task,ijk,q,i,j,k,l;
+			while(oq.next(task)) {
+				for(l=0;l<nf;l++) ob[l]=new voro_out_buffer(NULL,parallel_out_buffer_size);
+				if(rec==NULL) {
+					for(ijk=tb[task];ijk<tb[task+1];ijk++) {
+						k=ijk/con.nxy;l=ijk-con.nxy*k;
+						j=l/con.nx;i=l-con.nx*j;
+						for(q=0;q<con.co[ijk];q++)
+							if(vc.compute_cell(c,ijk,q,i,j,k)) f(con,c,ijk,q,t,&ob[0]);
+					}
+				} else for(l=tb[task];l<tb[task+1];l++) {
+					const par_record &w=rec[l];
+					if(vc.compute_cell(c,w.ijk,w.q,w.i,w.j,w.k)) f(con,c,w.ijk,w.q,t,&ob[0]);
+				}
+				oq.submit(task,&ob[0]);
+			}
+		}
+};
+
+/** Runs the worker threads and the writer thread of the parallel output
+ * routines.
+ * \param[in] con the container class to use.
+ * \param[in] f the formatting class to use.
+ * \param[in] ntasks the number of tasks.
+ * \param[in] tb the boundaries of the tasks.
+ * \param[in] rec the particle records, or NULL if the tasks are ranges of
+ *                blocks.
+ * \param[in] nf the number of files to write to.
+ * \param[in] fp the file handles to write to.
+ * \param[in] nt the number of worker threads to use, or zero to use the
+ *               number of hardware threads that are available.
+ * \param[in] ordered whether to write the output in the order of the loop. */
+template<class v_cell,class c_class,class f_class>
+void par_output_run(c_class &con,const f_class &f,int ntasks,const int *tb,const par_record *rec,int nf,FILE **fp,int nt,bool ordered) {
+	nt=voro_thread_count(nt);
+	if(nt>ntasks) nt=ntasks;
+	par_output_queue oq(ntasks,parallel_output_window*nt,ordered,nf,fp);
+	par_output_worker<v_cell,c_class,f_class> wk(con,oq,f,nf,tb,rec);
+#if VOROPP_THREADS ==1
+	std::thread wt(&par_output_queue::write,&oq);
+	voro_run_threads(nt,wk);
+	wt.join();
+#else
+	voro_run_threads(nt,wk);
+#endif
+}
+
+/** Computes the Voronoi cells for all of the particles visited by a loop
+ * class using several threads, and writes formatted output about them to
+ * several files, computing each cell only once. The formatting class f is
+ * copied by each thread, and is called as f(con,c,ijk,q,t,ob), where c is the
+ * computed cell, ijk and q give the particle's location in the container, t is
+ * the number of the thread, and ob is an array of nf voro_out_buffer pointers,
+ * one for each file. The cells are computed in tasks, the output of each task
+ * is formatted into separate buffers, and a writer thread writes the buffers
+ * to the files while the cells of later tasks are being computed. This routine
+ * can be used with the container and container_poly classes.
+ * \param[in] con the container class to use.
+ * \param[in] vl the loop class to use.
+ * \param[in] f the formatting class to use.
+ * \param[in] nf the number of files to write to.
+ * \param[in] fp the file handles to write to.
+ * \param[in] nt the number of threads to use for computing the cells, or zero
+ *               to use the number of hardware threads that are available.
+ * \param[in] ordered whether to write the output in the order of the loop
+ *                    class. If this is false, the output of each task is
+ *                    written as soon as it is complete. */
+template<class v_cell,class c_class,class c_loop,class f_class>
+void output_parallel_files(c_class &con,c_loop &vl,const f_class &f,int nf,FILE **fp,int nt=0,bool ordered=true) {
+	std::vector<par_record> rec;
+	std::vector<int> tb;
+	int ntasks=par_record_tasks(vl,rec,tb);
+	if(ntasks>0) par_output_run<v_cell>(con,f,ntasks,&tb[0],&rec[0],nf,fp,nt,ordered);
+}
+
+/** Computes the Voronoi cells for all of the particles in a container using
+ * several threads, and writes formatted output about them to several files.
+ * This version is used for the c_loop_all class, and schedules ranges of
+ * consecutive blocks directly. The arguments are as described for the general
+ * version above.
+ * \param[in] con the container class to use.
+ * \param[in] vl the loop class to use.
+ * \param[in] f the formatting class to use.
+ * \param[in] nf the number of files to write to.
+ * \param[in] fp the file handles to write to.
+ * \param[in] nt the number of threads to use for computing the cells.
+ * \param[in] ordered whether to write the output in the order of the loop
+ *                    class. */
+template<class v_cell,class c_class,class f_class>
+void output_parallel_files(c_class &con,c_loop_all &vl,const f_class &f,int nf,FILE **fp,int nt=0,bool ordered=true) {
+	std::vector<int> tb;
+	int ntasks=par_block_tasks(con,tb);
+	if(ntasks>0) par_output_run<v_cell>(con,f,ntasks,&tb[0],NULL,nf,fp,nt,ordered);
+}
+
+/** \brief An adaptor that allows a formatting class that writes to a single
+ * file to be used by the parallel output routines. */
+template<class f_class>
+struct par_single_file {
+	/** The formatting class. */
+	f_class f;
+	/** Constructs the adaptor from a formatting class.
+	 * \param[in] f_ the formatting class, which is copied. */
+	par_single_file(const f_class &f_) : f(f_) {}
+	/** Outputs information about a cell to the first buffer. */
+	template<class c_class,class v_cell>
+	inline void operator()(c_class &con,v_cell &c,int ijk,int q,int t,voro_out_buffer **ob) {
+		f(con,c,ijk,q,**ob);
+	}
+};
+
+/** Computes the Voronoi cells for all of the particles visited by a loop
+ * class using several threads, and writes formatted output about them to a
+ * file. The formatting class f is copied by each thread, and is called as
+ * f(con,c,ijk,q,ob), where c is the computed cell, ijk and q give the
+ * particle's location in the container, and ob is a voro_out_buffer to write
+ * to. The output is written as described for the output_parallel_files
+ * routine, and the c_loop_all class is handled by scheduling ranges of
+ * consecutive blocks directly. This routine can be used with the container
+ * and container_poly classes.
+ * \param[in] con the container class to use.
+ * \param[in] vl the loop class to use.
+ * \param[in] f the formatting class to use.
+ * \param[in] fp the file handle to write to.
+ * \param[in] nt the number of threads to use for computing the cells, or zero
+ *               to use the number of hardware threads that are available.
+ * \param[in] ordered whether to write the output in the order of the loop
+ *                    class. If this is false, the output of each task is
+ *                    written as soon as it is complete. */
+template<class v_cell,class c_class,class c_loop,class f_class>
+inline void output_parallel(c_class &con,c_loop &vl,const f_class &f,FILE *fp,int nt=0,bool ordered=true) {
+	output_parallel_files<v_cell>(con,vl,par_single_file<f_class>(f),1,&fp,nt,ordered);
+}
+
+/** \brief A formatting class for the parallel output routines that writes
+ * output in a custom format, as in the print_custom routines. */
+class par_custom_format {
+	public:
+		/** The parsed custom format. */
+		custom_format cf;
+		/** Constructs the class from a custom format string.
+		 * \param[in] format the custom format string to use. */
+		par_custom_format(const char *format) : cf(format) {}
+		/** Outputs a custom string of information about a cell.
+		 * \param[in] con the container class.
+		 * \param[in] c the computed cell.
+		 * \param[in] (ijk,q) the block and index of the particle.
+		 * \param[in] ob the buffer to write to. */
+		template<class c_class,class v_cell>
+		inline void operator()(c_class &con,v_cell &c,int ijk,int q,voro_out_buffer &ob) {
+			double *pp=con.p[ijk]+con.ps*q;
+			cf.output(c,con.id[ijk][q],*pp,pp[1],pp[2],con.ps==4?pp[3]:default_radius,ob);
+		}
+};
+
+/** \brief A formatting class for the parallel output routines that writes
+ * the cells in gnuplot format, as in the draw_cells_gnuplot routines. */
+struct par_gnuplot_format {
+	/** Outputs a cell in gnuplot format.
+	 * \param[in] con the container class.
+	 * \param[in] c the computed cell.
+	 * \param[in] (ijk,q) the block and index of the particle.
+	 * \param[in] ob the buffer to write to. */
+	template<class c_class,class v_cell>
+	inline void operator()(c_class &con,v_cell &c,int ijk,int q,voro_out_buffer &ob) {
+		double *pp=con.p[ijk]+con.ps*q;
+		c.draw_gnuplot(*pp,pp[1],pp[2],ob);
+	}
+};
+
+/** \brief A formatting class for the parallel output routines that writes
+ * the cells in POV-Ray format, as in the draw_cells_pov routines. */
+struct par_pov_format {
+	/** Outputs a cell in POV-Ray format.
+	 * \param[in] con the container class.
+	 * \param[in] c the computed cell.
+	 * \param[in] (ijk,q) the block and index of the particle.
+	 * \param[in] ob the buffer to write to. */
+	template<class c_class,class v_cell>
+	inline void operator()(c_class &con,v_cell &c,int ijk,int q,voro_out_buffer &ob) {
+		double *pp=con.p[ijk]+con.ps*q;
+		ob.put("// cell ",8);ob.put_int(con.id[ijk][q]);ob.put('\n');
+		c.draw_pov(*pp,pp[1],pp[2],ob);
+	}
+};
+
+/** Computes all of the Voronoi cells in a container using several threads,
+ * and saves customized information about them. The output is the same as that
+ * of the print_custom routine if it is ordered.
+ * \param[in] con the container class to use.
+ * \param[in] format the custom output string to use.
+ * \param[in] fp the file handle to write to.
+ * \param[in] nt the number of threads to use for computing the cells, or zero
+ *               to use the number of hardware threads that are available.
+ * \param[in] ordered whether to write the cells in the order of the
+ *                    c_loop_all class. */
+template<class c_class>
+void print_custom_parallel(c_class &con,const char *format,FILE *fp=stdout,int nt=0,bool ordered=true) {
+	c_loop_all vl(con);
+	par_custom_format f(format);
+	if(f.cf.neighbor) output_parallel<voronoicell_neighbor>(con,vl,f,fp,nt,ordered);
+	else output_parallel<voronoicell>(con,vl,f,fp,nt,ordered);
+}
+
+/** Computes all of the Voronoi cells in a container using several threads,
+ * and saves them in gnuplot format. The output is the same as that of the
+ * draw_cells_gnuplot routine if it is ordered.
+ * \param[in] con the container class to use.
+ * \param[in] fp the file handle to write to.
+ * \param[in] nt the number of threads to use for computing the cells.
+ * \param[in] ordered whether to write the cells in the order of the
+ *                    c_loop_all class. */
+template<class c_class>
+void draw_cells_gnuplot_parallel(c_class &con,FILE *fp=stdout,int nt=0,bool ordered=true) {
+	c_loop_all vl(con);
+	par_gnuplot_format f;
+	output_parallel<voronoicell>(con,vl,f,fp,nt,ordered);
+}
+
+/** Computes all of the Voronoi cells in a container using several threads,
+ * and saves them in POV-Ray format. The output is the same as that of the
+ * draw_cells_pov routine if it is ordered.
+ * \param[in] con the container class to use.
+ * \param[in] fp the file handle to write to.
+ * \param[in] nt the number of threads to use for computing the cells.
+ * \param[in] ordered whether to write the cells in the order of the
+ *                    c_loop_all class. */
+template<class c_class>
+void draw_cells_pov_parallel(c_class &con,FILE *fp=stdout,int nt=0,bool ordered=true) {
+	c_loop_all vl(con);
+	par_pov_format f;
+	output_parallel<voronoicell>(con,vl,f,fp,nt,ordered);
+}
+
+}
+
+#endif
@@ -8,13 +8,33 @@
  * \brief Function implementations for the pre_container and related classes.
  */
 
+#include <climits>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "config.hh"
 #include "pre_container.hh"
 
 namespace voro {
 
+/** \brief A structure holding the particles parsed by a single thread during
+ * a parallel import. */
+struct pre_import_task {
+	/** A pointer to the start of the section of text to parse. */
+	const char *s;
+	/** A pointer to the end of the section of text to parse. */
+	const char *e;
+	/** The IDs of the particles that were read. */
+	std::vector<int> id;
+	/** The floating point information of the particles that were
+	 * read. */
+	std::vector<double> p;
+	/** Whether the section of text was successfully parsed. */
+	bool ok;
+};
+
 /** The class constructor sets up the geometry of container, initializing the
  * minimum and maximum coordinates in each direction. It allocates an initial
  * chunk into which to store particle information.
@@ -62,6 +82,73 @@ void pre_container_base::guess_optimal(int &nx,int &ny,int &nz) {
 	nz=int(dz*ilscale+1);
 }
 
+/** Makes a guess at the optimal grid of blocks to use, taking into account
+ * the actual distribution of the particles. The guess_optimal routine assumes
+ * a uniform density, so that for clustered particles most blocks are empty
+ * while a few hold very many particles. This routine samples the stored
+ * particles and builds an occupancy histogram for a sequence of successively
+ * finer grids, each with twice as many blocks as the previous one. For each
+ * grid it estimates the mean number of particles in the block of a typical
+ * particle (the sum of the squared block counts divided by the number of
+ * particles), and chooses the grid where this is closest to its value for a
+ * uniform density at optimal_particles per block. For uniformly distributed
+ * particles, this gives the same grid as guess_optimal.
+ * \param[out] (nx,ny,nz) the number of blocks to use.
+ * \param[in] max_ratio the maximum factor by which the number of blocks can
+ *                      exceed the guess_optimal estimate, used to limit the
+ *                      memory spent on empty blocks. */
+void pre_container_base::guess_optimal_density(int &nx,int &ny,int &nz,double max_ratio) {
+	int i,j,k,cx,cy,cz,tp=total_particles(),ns,st;
+	guess_optimal(nx,ny,nz);
+	if(tp<2) return;
+
+	// Sample the stored particles with a fixed stride, recording their
+	// positions as fractions of the container size
+	double dx=bx-ax,dy=by-ay,dz=bz-az,*pp,x,y,z;
+	st=tp/density_sample_size+1;ns=(tp+st-1)/st;
+	std::vector<double> sp(3*ns);
+	for(i=j=0;i<tp;i+=st) {
+		pp=pre_p[i/pre_container_chunk_size]+ps*(i%pre_container_chunk_size);
+		x=(*pp-ax)/dx;y=(pp[1]-ay)/dy;z=(pp[2]-az)/dz;
+		if(xperiodic) x-=floor(x);
+		if(yperiodic) y-=floor(y);
+		if(zperiodic) z-=floor(z);
+		sp[j++]=x;sp[j++]=y;sp[j++]=z;
+	}
+
+	// Consider successively finer grids. In each, count the sampled
+	// particles per block by sorting their block indices, and correct the
+	// sum of squared counts for the sampling fraction f.
+	const double target=optimal_particles+1,f=double(ns)/tp,fac=pow(2,1/3.0);
+	double ilscale=pow(tp/(optimal_particles*dx*dy*dz),1/3.0),nb=double(nx)*ny*nz;
+	double sc,m,d,best=large_number;
+	std::vector<long long> bl(ns);
+	for(sc=1;;sc*=fac) {
+		cx=int(dx*ilscale*sc+1);cy=int(dy*ilscale*sc+1);cz=int(dz*ilscale*sc+1);
+		if(sc>1&&double(cx)*cy*cz>max_ratio*nb) break;
+		for(i=j=0;i<ns;i++,j+=3) {
+			int bi=int(sp[j]*cx),bj=int(sp[j+1]*cy),bk=int(sp[j+2]*cz);
+			if(bi>=cx) bi=cx-1;else if(bi<0) bi=0;
+			if(bj>=cy) bj=cy-1;else if(bj<0) bj=0;
+			if(bk>=cz) bk=cz-1;else if(bk<0) bk=0;
+			bl[i]=(static_cast<long long>(bk)*cy+bj)*cx+bi;
+		}
+		std::sort(bl.begin(),bl.end());
+		for(m=0,i=0;i<ns;i=k) {
+			for(k=i+1;k<ns&&bl[k]==bl[i];k++);
+			m+=double(k-i)*(k-i)-(1-f)*(k-i);
+		}
+		m/=f*f*tp;
+
+		// Keep the grid whose typical occupancy is closest to the target,
+		// measured on a logarithmic scale. Since refining the grid can
+		// only reduce the occupancy, stop once it falls below the target.
+		d=fabs(log(m/target));
+		if(d<best) {best=d;nx=cx;ny=cy;nz=cz;}
+		if(m<=target) break;
+	}
+}
+
 /** Stores a particle ID and position, allocating a new memory chunk if
  * necessary. For coordinate directions in which the container is not periodic,
  * the routine checks to make sure that the particle is within the container
@@ -206,6 +293,159 @@ void pre_container_poly::import(FILE *fp) {
 	if(j!=EOF) voro_fatal_error("File import error",VOROPP_FILE_ERROR);
 }
 
+/** Imports a list of particles from a file, dividing the work between several
+ * threads. The file is memory-mapped and split into sections at line breaks,
+ * and each thread parses one section into its own temporary storage. The
+ * results are then appended to the chunks in file order, so that the
+ * particles are stored in the same order as the serial import routine. Each
+ * line should contain a complete record (Particle ID, x position, y position,
+ * z position, and the radius for the pre_container_poly class). If the file
+ * cannot be successfully read, then the routine causes a fatal error.
+ * \param[in] filename the name of the file to read from.
+ * \param[in] nt the number of threads to use, or zero to use the number of
+ *               hardware threads that are available. */
+void pre_container_base::import_parallel(const char *filename,int nt) {
+	voro_mapped_file mf(filename);
+	const char *b=mf.data,*e=b+mf.size,*q=b;
+	size_t mt=mf.size/min_import_thread_bytes+1;
+	int i;
+	nt=voro_thread_count(nt);
+	if(size_t(nt)>mt) nt=mt;
+
+	// Divide the text into sections, moving each division point forward
+	// to the start of the next line
+	std::vector<pre_import_task> t(nt);
+	for(i=0;i<nt;i++) {
+		t[i].s=q;
+		if(i==nt-1) q=e;
+		else {
+			q=b+mf.size/nt*(i+1);
+			if(q<t[i].s) q=t[i].s;
+			while(q<e&&*q!='\n') q++;
+			if(q<e) q++;
+		}
+		t[i].e=q;
+	}
+
+	// Parse the sections
+#if VOROPP_THREADS ==1
+	std::vector<std::thread> th;
+	for(i=1;i<nt;i++) th.push_back(std::thread(&pre_container_base::parse_text,this,&t[i]));
+	parse_text(&t[0]);
+	for(i=0;i<nt-1;i++) th[i].join();
+#else
+	for(i=0;i<nt;i++) parse_text(&t[i]);
+#endif
+
+	// Append the particles to the chunks, freeing the temporary storage
+	// as each section is dealt with
+	for(i=0;i<nt;i++) {
+		if(!t[i].ok) voro_fatal_error("File import error",VOROPP_FILE_ERROR);
+		if(!t[i].id.empty()) add_particles(t[i].id.size(),&t[i].id[0],&t[i].p[0]);
+		std::vector<int>().swap(t[i].id);
+		std::vector<double>().swap(t[i].p);
+	}
+}
+
+/** Parses a section of text for the import_parallel routine, storing the
+ * particles that are within the container bounds.
+ * \param[in] t a pointer to the task describing the section of text, into
+ *              which the particles are stored. */
+void pre_container_base::parse_text(pre_import_task *t) {
+	const char *p=t->s,*e=t->e;
+	int l,n;
+	double v[4];
+	t->ok=false;
+	voro_skip_space(p,e);
+	while(p<e) {
+		if(!voro_parse_int(p,e,n)) return;
+		for(l=0;l<ps;l++) {
+			voro_skip_space(p,e);
+			if(!voro_parse_double(p,e,v[l])) return;
+		}
+		if(inside(*v,v[1],v[2])) {
+			t->id.push_back(n);
+			t->p.insert(t->p.end(),v,v+ps);
+		}
+#if VOROPP_REPORT_OUT_OF_BOUNDS ==1
+		else fprintf(stderr,"Out of bounds: (x,y,z)=(%g,%g,%g)\n",*v,v[1],v[2]);
+#endif
+		voro_skip_space(p,e);
+	}
+	t->ok=true;
+}
+
+/** Imports a list of particles from a binary file. The file is memory-mapped
+ * and the particle information is copied into the chunks directly, without
+ * any parsing. All values are stored in little-endian byte order, in the
+ * following layout:
+ *
+ * - bytes 0 to 3: the characters "VORO".
+ * - bytes 4 to 7: a 32-bit integer with the number of floating point values
+ *   per particle, which must be 3 for the pre_container class and 4 for the
+ *   pre_container_poly class.
+ * - bytes 8 to 15: a 64-bit integer with the number of particles, n.
+ * - n 32-bit integer particle IDs, followed by zero padding up to a multiple
+ *   of eight bytes.
+ * - n records of 64-bit floating point values, each containing the x, y,
+ *   and z positions, followed by the radius for the pre_container_poly class.
+ *
+ * The floating point records have the same layout as the chunks. Particles
+ * that are outside the container bounds are skipped. If the file cannot be
+ * successfully read, then the routine causes a fatal error.
+ * \param[in] filename the name of the file to read from. */
+void pre_container_base::import_binary(const char *filename) {
+	const unsigned int one=1;
+	if(*reinterpret_cast<const unsigned char*>(&one)!=1)
+		voro_fatal_error("Binary import is only supported on little-endian systems",VOROPP_FILE_ERROR);
+	voro_mapped_file mf(filename);
+	const char *b=mf.data;
+	int fps;long long i,j,n;
+	if(mf.size<16||memcmp(b,"VORO",4)!=0)
+		voro_fatal_error("Binary import error: unrecognized header",VOROPP_FILE_ERROR);
+	memcpy(&fps,b+4,4);memcpy(&n,b+8,8);
+	if(fps!=ps) voro_fatal_error("Binary import error: wrong number of values per particle",VOROPP_FILE_ERROR);
+
+	// Check the number of particles against the file size before using it
+	// in any arithmetic, so that a corrupt header cannot cause an
+	// overflow. The particle counts are passed on as integers, so they
+	// must also fit in one.
+	if(n<0||n>INT_MAX||n>(long long)((mf.size-16)/(4+8*ps)))
+		voro_fatal_error("Binary import error: invalid number of particles",VOROPP_FILE_ERROR);
+	size_t po=(16+4*n+7)&~size_t(7);
+	if(mf.size<po+8*ps*n) voro_fatal_error("Binary import error: file is truncated",VOROPP_FILE_ERROR);
+	const int *idp=reinterpret_cast<const int*>(b+16);
+	const double *pp=reinterpret_cast<const double*>(b+po);
+
+	// Copy across each run of consecutive particles that are within the
+	// container bounds
+	for(i=0;i<n;i=j+1) {
+		for(j=i;j<n&&inside(pp[ps*j],pp[ps*j+1],pp[ps*j+2]);j++);
+		add_particles(int(j-i),idp+i,pp+ps*i);
+#if VOROPP_REPORT_OUT_OF_BOUNDS ==1
+		if(j<n) fprintf(stderr,"Out of bounds: (x,y,z)=(%g,%g,%g)\n",pp[ps*j],pp[ps*j+1],pp[ps*j+2]);
+#endif
+	}
+}
+
+/** Appends a sequence of particles to the chunks, copying as many as will fit
+ * into the current chunk at a time, and allocating new chunks as necessary.
+ * The particles are not checked against the container bounds.
+ * \param[in] n the number of particles.
+ * \param[in] idp a pointer to the particle IDs.
+ * \param[in] pp a pointer to the floating point information of the
+ *               particles. */
+void pre_container_base::add_particles(int n,const int *idp,const double *pp) {
+	int k;
+	while(n>0) {
+		if(ch_id==e_id) new_chunk();
+		k=e_id-ch_id;if(k>n) k=n;
+		memcpy(ch_id,idp,k*sizeof(int));
+		memcpy(ch_p,pp,ps*k*sizeof(double));
+		ch_id+=k;idp+=k;ch_p+=ps*k;pp+=ps*k;n-=k;
+	}
+}
+
 /** Allocates a new chunk of memory for storing particles. */
 void pre_container_base::new_chunk() {
 	end_id++;end_p++;
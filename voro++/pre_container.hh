@@ -17,6 +17,8 @@
 
 namespace voro {
 
+struct pre_import_task;
+
 /** \brief A class for storing an arbitrary number of particles, prior to setting
  * up a container geometry.
  *
@@ -52,6 +54,9 @@ class pre_container_base {
 		 * periodic or not. */
 		const bool zperiodic;
 		void guess_optimal(int &nx,int &ny,int &nz);
+		void guess_optimal_density(int &nx,int &ny,int &nz,double max_ratio=8);
+		void import_parallel(const char *filename,int nt=0);
+		void import_binary(const char *filename);
 		pre_container_base(double ax_,double bx_,double ay_,double by_,double az_,double bz_,bool xperiodic_,bool yperiodic_,bool zperiodic_,int ps_);
 		~pre_container_base();
 		/** Calculates and returns the total number of particles stored
@@ -67,6 +72,15 @@ class pre_container_base {
 		const int ps;
 		void new_chunk();
 		void extend_chunk_index();
+		void add_particles(int n,const int *idp,const double *pp);
+		void parse_text(pre_import_task *t);
+		/** Tests whether a position is within the container bounds, in
+		 * the coordinate directions that are not periodic.
+		 * \param[in] (x,y,z) the position vector to test.
+		 * \return True if the position is inside, false otherwise. */
+		inline bool inside(double x,double y,double z) {
+			return (xperiodic||(x>=ax&&x<=bx))&&(yperiodic||(y>=ay&&y<=by))&&(zperiodic||(z>=az&&z<=bz));
+		}
 		/** The size of the chunk index. */
 		int index_sz;
 		/** A pointer to the chunk index to store the integer particle
@@ -13,6 +13,8 @@
 
 #include <cmath>
 
+#include "config.hh"
+
 namespace voro {
 
 /** \brief Class containing all of the routines that are specific to computing 
@@ -151,7 +153,14 @@ class radius_poly {
 			return rs<sqrt(mrs*trs);
 		}
 	private:
+#if VOROPP_THREADS ==1
+		// These constants are set separately for each cell that is
+		// computed, so they are kept per thread, to allow cells to be
+		// computed concurrently
+		static thread_local double r_rad,r_mul,r_val;
+#else
 		double r_rad,r_mul,r_val;
+#endif
 };
 
 }
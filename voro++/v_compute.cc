@@ -7,6 +7,8 @@
 /** \file v_compute.cc
  * \brief Function implementantions for the voro_compute template. */
 
+#include <algorithm>
+
 #include "worklist.hh"
 #include "v_compute.hh"
 #include "rad_option.hh"
@@ -26,7 +28,7 @@ voro_compute<c_class>::voro_compute(c_class &con_,int hx_,int hy_,int hz_) :
 	hx(hx_), hy(hy_), hz(hz_), hxy(hx_*hy_), hxyz(hxy*hz_), ps(con_.ps),
 	id(con_.id), p(con_.p), co(con_.co), bxsq(boxx*boxx+boxy*boxy+boxz*boxz),
 	mv(0), qu_size(3*(3+hxy+hz*(hx+hy))), wl(con_.wl), mrad(con_.mrad),
-	mask(new unsigned int[hxyz]), qu(new int[qu_size]), qu_l(qu+qu_size) {
+	mask(new unsigned int[hxyz]), qu(new int[qu_size]), qu_l(qu+qu_size), cv(0) {
 	reset_mask();
 }
 
@@ -284,11 +286,15 @@ inline void voro_compute<c_class>::scan_bits_mask_add(unsigned int q,unsigned in
  * \param[in] s the index of the particle within the test block.
  * \param[in] (ci,cj,ck) the coordinates of the block that the test particle is
  *                       in relative to the container data structure.
+ * \param[in] cand a pointer to the IDs of candidate neighbors to cut the cell
+ *                 with before the search, or NULL if there are none.
+ * \param[in] nc the number of candidate neighbors.
+ * \param[in] pl the lookup table for the candidate IDs.
  * \return False if the Voronoi cell was completely removed during the
  *         computation and has zero volume, true otherwise. */
 template<class c_class>
 template<class v_cell>
-bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck) {
+bool voro_compute<c_class>::search_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck,const int *cand,int nc,const particle_lookup *pl) {
 	static const int count_list[8]={7,11,15,19,26,35,45,59},*count_e=count_list+8;
 	double x,y,z,x1,y1,z1,qx=0,qy=0,qz=0;
 	double xlo,ylo,zlo,xhi,yhi,zhi,x2,y2,z2,rs;
@@ -299,18 +305,47 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 	if(!con.initialize_voronoicell(c,ijk,s,ci,cj,ck,i,j,k,x,y,z,disp)) return false;
 	con.r_init(ijk,s);
 
+	// Cut the cell with any candidate neighbors that have been supplied,
+	// such as the neighbors of the particle in a previous frame. If they
+	// are close to the true neighbors, then the cell is reduced to nearly
+	// its final size, the cutoff radius of the search is small from the
+	// start, and the planes of the particles below mostly miss the cell.
+	// The candidates are marked by ID, so that the search does not cut
+	// the cell by their planes a second time.
+	cvec.clear();
+	if(nc>0) {
+		cv++;
+		if(cv==0) {for(l=0;l<int(cmark.size());l++) cmark[l]=0;cv=1;}
+	}
+	for(l=0;l<nc;l++) {
+		int cijk,cq,pid=cand[l];
+		if(!pl->find(pid,cijk,cq)||!con.candidate_vector(ijk,s,x,y,z,cijk,cq,x1,y1,z1)) continue;
+		rs=con.r_scale(x1*x1+y1*y1+z1*z1,cijk,cq);
+		if(!c.nplane(x1,y1,z1,rs,pid)) return false;
+		if(pid>=int(cmark.size())) {cmark.resize(pid+1,0);cpos.resize(pid+1);}
+		cmark[pid]=cv;cpos[pid]=cvec.size();
+		cvec.push_back(x1);cvec.push_back(y1);cvec.push_back(z1);
+	}
+
 	// Initialize the Voronoi cell to fill the entire container
 	double crs,mrs;
 
 	int next_count=3,*count_p=(const_cast<int*> (count_list));
 
+#if VOROPP_NEAREST_FIRST ==1
+	// Test all particles in the particle's block and the blocks around
+	// it first, nearest first. If there are too many of them, then fall
+	// back to testing the particle's block in the usual order.
+	if(!cut_ring(c,ijk,s,ci,cj,ck,i,j,k,x,y,z,disp)) return false;
+	if(!ring_cut) {
+#endif
 	// Test all particles in the particle's local region first
 	for(l=0;l<s;l++) {
 		x1=p[ijk][ps*l]-x;
 		y1=p[ijk][ps*l+1]-y;
 		z1=p[ijk][ps*l+2]-z;
 		rs=con.r_scale(x1*x1+y1*y1+z1*z1,ijk,l);
-		if(!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+		if(!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 	}
 	l++;
 	while(l<co[ijk]) {
@@ -318,9 +353,12 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 		y1=p[ijk][ps*l+1]-y;
 		z1=p[ijk][ps*l+2]-z;
 		rs=con.r_scale(x1*x1+y1*y1+z1*z1,ijk,l);
-		if(!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+		if(!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 		l++;
 	}
+#if VOROPP_NEAREST_FIRST ==1
+	}
+#endif
 
 	// Now compute the maximum distance squared from the cell center to a
 	// vertex. This is used to cut off the calculation since we only need
@@ -390,6 +428,9 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 		ei=di+i;if(ei<0||ei>=hx) continue;
 		ej=dj+j;if(ej<0||ej>=hy) continue;
 		ek=dk+k;if(ek<0||ek>=hz) continue;
+#if VOROPP_NEAREST_FIRST ==1
+		if(in_ring(di,dj,dk)) continue;
+#endif
 
 		// Call the compute_min_max_radius() function. This returns
 		// true if the minimum distance to the block is bigger than the
@@ -414,7 +455,7 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 					y1=p[ijk][ps*l+1]-y2;
 					z1=p[ijk][ps*l+2]-z2;
 					rs=con.r_scale(x1*x1+y1*y1+z1*z1,ijk,l);
-					if(!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+					if(!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 					l++;
 				} while (l<co[ijk]);
 			} else {
@@ -423,7 +464,7 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 					y1=p[ijk][ps*l+1]-y2;
 					z1=p[ijk][ps*l+2]-z2;
 					rs=x1*x1+y1*y1+z1*z1;
-					if(con.r_scale_check(rs,mrs,ijk,l)&&!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+					if(con.r_scale_check(rs,mrs,ijk,l)&&!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 					l++;
 				} while (l<co[ijk]);
 			}
@@ -476,6 +517,9 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 		ek=dk+k;if(ek<0||ek>=hz) continue;
 		mijk=mask+ei+hx*(ej+hy*ek);
 		*mijk=mv;
+#if VOROPP_NEAREST_FIRST ==1
+		if(in_ring(di,dj,dk)) continue;
+#endif
 
 		// Call the compute_min_max_radius() function. This returns
 		// true if the minimum distance to the block is bigger than the
@@ -500,7 +544,7 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 					y1=p[ijk][ps*l+1]-y2;
 					z1=p[ijk][ps*l+2]-z2;
 					rs=con.r_scale(x1*x1+y1*y1+z1*z1,ijk,l);
-					if(!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+					if(!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 					l++;
 				} while (l<co[ijk]);
 			} else {
@@ -509,7 +553,7 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 					y1=p[ijk][ps*l+1]-y2;
 					z1=p[ijk][ps*l+2]-z2;
 					rs=x1*x1+y1*y1+z1*z1;
-					if(con.r_scale_check(rs,mrs,ijk,l)&&!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+					if(con.r_scale_check(rs,mrs,ijk,l)&&!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 					l++;
 				} while (l<co[ijk]);
 			}
@@ -604,7 +648,7 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 				y1=p[ijk][ps*l+1]-y2;
 				z1=p[ijk][ps*l+2]-z2;
 				rs=con.r_scale(x1*x1+y1*y1+z1*z1,ijk,l);
-				if(!c.nplane(x1,y1,z1,rs,id[ijk][l])) return false;
+				if(!search_cut(c,x1,y1,z1,rs,id[ijk][l])) return false;
 				l++;
 			} while (l<co[ijk]);
 		}
@@ -620,6 +664,74 @@ bool voro_compute<c_class>::compute_cell(v_cell &c,int ijk,int s,int ci,int cj,i
 	return true;
 }
 
+#if VOROPP_NEAREST_FIRST ==1
+/** Cuts a Voronoi cell by the particles in the block of the particle and in
+ * the ring of 26 blocks around it, in order of increasing distance. The blocks
+ * are the same ones that the worklist would visit with offsets of at most one
+ * in each direction, and the search_cell routine skips them afterwards.
+ * Particles that are too far away to cut the cell, according to a cutoff
+ * radius that is updated every eight particles, are skipped. If the ring holds
+ * more than nearest_first_max particles, then no cuts are made, and ring_cut is
+ * set to false.
+ * \param[in,out] c a reference to a voronoicell object.
+ * \param[in] ijk the index of the block that the test particle is in.
+ * \param[in] s the index of the particle within the test block.
+ * \param[in] (ci,cj,ck) the coordinates of the block that the test particle is
+ *                       in relative to the container data structure.
+ * \param[in] (i,j,k) the coordinates of the block relative to the mask.
+ * \param[in] (x,y,z) the position of the particle.
+ * \param[in] disp the block displacement used by the region_index routine.
+ * \return False if the Voronoi cell was completely removed, true otherwise. */
+template<class c_class>
+template<class v_cell>
+bool voro_compute<c_class>::cut_ring(v_cell &c,int ijk,int s,int ci,int cj,int ck,int i,int j,int k,double x,double y,double z,int &disp) {
+	int di,dj,dk,ei,ej,ek,l,nb=0,tp=0,bijk[27];
+	double qx=0,qy=0,qz=0,rs,mrs,bq[81];
+	ring_particle rp;
+
+	// Find the blocks of the ring, and count their particles
+	for(dk=-1;dk<=1;dk++) {
+		ek=k+dk;if(ek<0||ek>=hz) continue;
+		for(dj=-1;dj<=1;dj++) {
+			ej=j+dj;if(ej<0||ej>=hy) continue;
+			for(di=-1;di<=1;di++) {
+				ei=i+di;if(ei<0||ei>=hx) continue;
+				bijk[nb]=con.region_index(ci,cj,ck,ei,ej,ek,qx,qy,qz,disp);
+				bq[3*nb]=qx;bq[3*nb+1]=qy;bq[3*nb+2]=qz;
+				tp+=co[bijk[nb++]];
+			}
+		}
+	}
+	ring_cut=tp<=nearest_first_max;
+	if(!ring_cut) return true;
+
+	// Gather the particles, and sort them by distance
+	ring.clear();
+	for(int b=0;b<nb;b++) {
+		int eijk=bijk[b];
+		double *qp=bq+3*b;
+		for(l=0;l<co[eijk];l++) {
+			if(eijk==ijk&&l==s&&*qp==0&&qp[1]==0&&qp[2]==0) continue;
+			rp.x=p[eijk][ps*l]-x+*qp;
+			rp.y=p[eijk][ps*l+1]-y+qp[1];
+			rp.z=p[eijk][ps*l+2]-z+qp[2];
+			rp.rs=rp.x*rp.x+rp.y*rp.y+rp.z*rp.z;
+			rp.ijk=eijk;rp.l=l;
+			ring.push_back(rp);
+		}
+	}
+	std::sort(ring.begin(),ring.end());
+	mrs=c.max_radius_squared();
+	for(l=0;l<int(ring.size());l++) {
+		if((l&7)==7) mrs=c.max_radius_squared();
+		ring_particle &r=ring[l];
+		rs=r.rs;
+		if(con.r_scale_check(rs,mrs,r.ijk,r.l)&&!search_cut(c,r.x,r.y,r.z,rs,id[r.ijk][r.l])) return false;
+	}
+	return true;
+}
+#endif
+
 /** This function checks to see whether a particular block can possibly have
  * any intersection with a Voronoi cell, for the case when the closest point
  * from the cell center to the block is at a corner.
@@ -986,21 +1098,21 @@ inline void voro_compute<c_class>::add_list_memory(int*& qu_s,int*& qu_e) {
 // Explicit template instantiation
 template voro_compute<container>::voro_compute(container&,int,int,int);
 template voro_compute<container_poly>::voro_compute(container_poly&,int,int,int);
-template bool voro_compute<container>::compute_cell(voronoicell&,int,int,int,int,int);
-template bool voro_compute<container>::compute_cell(voronoicell_neighbor&,int,int,int,int,int);
+template bool voro_compute<container>::search_cell(voronoicell&,int,int,int,int,int,const int*,int,const particle_lookup*);
+template bool voro_compute<container>::search_cell(voronoicell_neighbor&,int,int,int,int,int,const int*,int,const particle_lookup*);
 template void voro_compute<container>::find_voronoi_cell(double,double,double,int,int,int,int,particle_record&,double&);
-template bool voro_compute<container_poly>::compute_cell(voronoicell&,int,int,int,int,int);
-template bool voro_compute<container_poly>::compute_cell(voronoicell_neighbor&,int,int,int,int,int);
+template bool voro_compute<container_poly>::search_cell(voronoicell&,int,int,int,int,int,const int*,int,const particle_lookup*);
+template bool voro_compute<container_poly>::search_cell(voronoicell_neighbor&,int,int,int,int,int,const int*,int,const particle_lookup*);
 template void voro_compute<container_poly>::find_voronoi_cell(double,double,double,int,int,int,int,particle_record&,double&);
 
 // Explicit template instantiation
 template voro_compute<container_periodic>::voro_compute(container_periodic&,int,int,int);
 template voro_compute<container_periodic_poly>::voro_compute(container_periodic_poly&,int,int,int);
-template bool voro_compute<container_periodic>::compute_cell(voronoicell&,int,int,int,int,int);
-template bool voro_compute<container_periodic>::compute_cell(voronoicell_neighbor&,int,int,int,int,int);
+template bool voro_compute<container_periodic>::search_cell(voronoicell&,int,int,int,int,int,const int*,int,const particle_lookup*);
+template bool voro_compute<container_periodic>::search_cell(voronoicell_neighbor&,int,int,int,int,int,const int*,int,const particle_lookup*);
 template void voro_compute<container_periodic>::find_voronoi_cell(double,double,double,int,int,int,int,particle_record&,double&);
-template bool voro_compute<container_periodic_poly>::compute_cell(voronoicell&,int,int,int,int,int);
-template bool voro_compute<container_periodic_poly>::compute_cell(voronoicell_neighbor&,int,int,int,int,int);
+template bool voro_compute<container_periodic_poly>::search_cell(voronoicell&,int,int,int,int,int,const int*,int,const particle_lookup*);
+template bool voro_compute<container_periodic_poly>::search_cell(voronoicell_neighbor&,int,int,int,int,int,const int*,int,const particle_lookup*);
 template void voro_compute<container_periodic_poly>::find_voronoi_cell(double,double,double,int,int,int,int,particle_record&,double&);
 
 }
@@ -10,9 +10,12 @@
 #ifndef VOROPP_V_COMPUTE_HH
 #define VOROPP_V_COMPUTE_HH
 
+#include <vector>
+
 #include "config.hh"
 #include "worklist.hh"
 #include "cell.hh"
+#include "c_loops.hh"
 
 namespace voro {
 
@@ -91,8 +94,46 @@ class voro_compute {
 			delete [] qu;
 			delete [] mask;
 		}
+		/** Computes the Voronoi cell for a given particle, by first
+		 * carrying out the search over the neighboring particles, and
+		 * then allowing the container to apply any remaining walls.
+		 * \param[in,out] c a reference to a voronoicell object.
+		 * \param[in] ijk the index of the block that the test particle
+		 *                is in.
+		 * \param[in] s the index of the particle within the test
+		 *              block.
+		 * \param[in] (ci,cj,ck) the coordinates of the block that the
+		 *                       test particle is in relative to the
+		 *                       container data structure.
+		 * \return False if the Voronoi cell was completely removed
+		 *         during the computation and has zero volume, true
+		 *         otherwise. */
+		template<class v_cell>
+		inline bool compute_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck) {
+			return search_cell(c,ijk,s,ci,cj,ck,NULL,0,NULL)&&con.finalize_voronoicell(c,ijk,s);
+		}
+		/** Computes the Voronoi cell for a given particle, by first
+		 * cutting it with a list of candidate neighbors, and then
+		 * carrying out the usual search to confirm that the cell is
+		 * complete.
+		 * \param[in,out] c a reference to a voronoicell object.
+		 * \param[in] ijk the index of the block that the test particle
+		 *                is in.
+		 * \param[in] s the index of the particle within the test
+		 *              block.
+		 * \param[in] (ci,cj,ck) the coordinates of the block that the
+		 *                       test particle is in relative to the
+		 *                       container data structure.
+		 * \param[in] cand a pointer to the IDs of the candidates.
+		 * \param[in] nc the number of candidates.
+		 * \param[in] pl the lookup table for the candidate IDs.
+		 * \return False if the Voronoi cell was completely removed
+		 *         during the computation and has zero volume, true
+		 *         otherwise. */
 		template<class v_cell>
-		bool compute_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck);
+		inline bool compute_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck,const int *cand,int nc,const particle_lookup &pl) {
+			return search_cell(c,ijk,s,ci,cj,ck,cand,nc,&pl)&&con.finalize_voronoicell(c,ijk,s);
+		}
 		void find_voronoi_cell(double x,double y,double z,int ci,int cj,int ck,int ijk,particle_record &w,double &mrs);
 	private:
 		/** A constant set to boxx*boxx+boxy*boxy+boxz*boxz, which is
@@ -117,6 +158,84 @@ class voro_compute {
 		/** A pointer to the end of the queue array, used to determine
 		 * when the queue is full. */
 		int *qu_l;
+		/** A counter that is incremented for each cell that is cut by
+		 * candidate neighbors, used to mark the candidates that have
+		 * been applied to the current cell. */
+		unsigned int cv;
+		/** The value of the counter when each particle ID was last
+		 * applied as a candidate, indexed by particle ID. */
+		std::vector<unsigned int> cmark;
+		/** The index in cvec of the vector to each particle ID that
+		 * was applied as a candidate, indexed by particle ID. */
+		std::vector<int> cpos;
+		/** The vectors to the candidate neighbors that have cut the
+		 * current cell. */
+		std::vector<double> cvec;
+		/** Cuts the cell during the search by the plane of a particle,
+		 * unless the particle is a candidate neighbor whose plane has
+		 * already been applied. Cutting by the same plane again would
+		 * give no change, but it is slow, since every vertex of the
+		 * face lies on the plane.
+		 * \param[in,out] c a reference to a voronoicell object.
+		 * \param[in] (x,y,z) the vector to the particle.
+		 * \param[in] rs the distance along this vector of the plane.
+		 * \param[in] pid the ID of the particle.
+		 * \return False if the plane cut deleted the cell entirely,
+		 *         true otherwise. */
+		template<class v_cell>
+		inline bool search_cut(v_cell &c,double x,double y,double z,double rs,int pid) {
+			return (!cvec.empty()&&candidate_applied(x,y,z,pid))||c.nplane(x,y,z,rs,pid);
+		}
+		/** Checks whether a particle tested during the search is a
+		 * candidate neighbor whose plane has already cut the cell.
+		 * This is the case if its ID is marked as applied to the
+		 * current cell, and if the vector to it is the same, up to
+		 * round-off, since in a periodic container the search may test
+		 * other images of the candidate.
+		 * \param[in] (x,y,z) the vector to the particle.
+		 * \param[in] pid the ID of the particle.
+		 * \return True if the plane has already been applied, false
+		 *         otherwise. */
+		inline bool candidate_applied(double x,double y,double z,int pid) {
+			if(pid<0||pid>=int(cmark.size())||cmark[pid]!=cv) return false;
+			double *vp=&cvec[cpos[pid]],dx=x-*vp,dy=y-vp[1],dz=z-vp[2];
+			return dx*dx+dy*dy+dz*dz<tolerance_sq;
+		}
+#if VOROPP_NEAREST_FIRST ==1
+		/** \brief A particle in the ring of blocks around the particle
+		 * whose cell is being computed. */
+		struct ring_particle {
+			/** The distance squared to the particle. */
+			double rs;
+			/** The block that the particle is within. */
+			int ijk;
+			/** The index of the particle within the block. */
+			int l;
+			/** The vector to the particle. */
+			double x,y,z;
+			/** Compares two particles by distance, for sorting
+			 * them into increasing order. */
+			inline bool operator<(const ring_particle &o) const {return rs<o.rs;}
+		};
+		/** The particles in the ring of blocks around the particle
+		 * whose cell is being computed. */
+		std::vector<ring_particle> ring;
+		/** Whether the cell being computed has been cut by the
+		 * particles in the ring of blocks. */
+		bool ring_cut;
+		/** Tests whether a block offset is within the ring of blocks
+		 * that has already been cut by cut_ring().
+		 * \param[in] (di,dj,dk) the block offset.
+		 * \return True if the block has already been cut, false
+		 *         otherwise. */
+		inline bool in_ring(int di,int dj,int dk) {
+			return ring_cut&&di>=-1&&di<=1&&dj>=-1&&dj<=1&&dk>=-1&&dk<=1;
+		}
+		template<class v_cell>
+		bool cut_ring(v_cell &c,int ijk,int s,int ci,int cj,int ck,int i,int j,int k,double x,double y,double z,int &disp);
+#endif
+		template<class v_cell>
+		bool search_cell(v_cell &c,int ijk,int s,int ci,int cj,int ck,const int *cand,int nc,const particle_lookup *pl);
 		template<class v_cell>
 		bool corner_test(v_cell &c,double xl,double yl,double zl,double xh,double yh,double zh);
 		template<class v_cell>
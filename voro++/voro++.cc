@@ -9,6 +9,8 @@
 
 #include "cell.cc"
 #include "common.cc"
+#include "custom_format.cc"
+#include "binary_output.cc"
 #include "v_base.cc"
 #include "container.cc"
 #include "unitcell.cc"
@@ -16,4 +18,5 @@
 #include "pre_container.cc"
 #include "v_compute.cc"
 #include "c_loops.cc"
-#include "wall.cc"
+#include "wall_mesh.cc"
+#include "parallel.cc"
@@ -228,6 +228,22 @@
  * store_cell_volumes() and draw_cells_gnuplot() that can be used to calculate
  * and draw the cells in a container.
  *
+ * For a sequence of frames where the particles only move slightly, the
+ * neighbors of each particle in the previous frame are a good guess for its
+ * current neighbors. The containers have a variant of compute_cell() that
+ * takes a list of candidate neighbor IDs, whose locations are found with a
+ * particle_lookup table. The cell is cut by the candidates first, which
+ * reduces it to nearly its final size. The search above then gives the same
+ * cell, but most of the particles it tests miss the cell, and the candidates
+ * themselves are skipped, so that far fewer plane cuts are made.
+ *
+ * If the code is compiled with VOROPP_NEAREST_FIRST set to 1, the particles
+ * in the ring of 27 blocks around the particle are sorted by distance and cut
+ * nearest first, before the search above is carried out. Distant particles in
+ * the same block then miss the cell instead of creating vertices that later
+ * cuts delete. The ordering is skipped when the ring holds more than
+ * nearest_first_max particles.
+ *
  * \section walls Wall computation
  * Wall computations are handled by making use of a pure virtual wall class.
  * Specific wall types are derived from this class, and require the
@@ -244,6 +260,23 @@
  * accurate walls by making cut_cell() routines that approximate the curved
  * surface with multiple plane cuts.
  *
+ * The wall_mesh class represents a region enclosed by a closed triangle mesh,
+ * which can be loaded from an STL file. The triangles are stored in a bounding
+ * volume hierarchy, so that point_inside() casts a single ray through the
+ * hierarchy, and cut_cell() only considers the triangles that are close to
+ * the cell, cutting it with a plane at the closest point on each one.
+ *
+ * When a wall is added to a container, the container records which blocks of
+ * its grid are far enough inside the wall that it cannot cut their cells,
+ * using the box_inside() function of the wall. Those walls are only applied to
+ * cells that turn out to be unusually large.
+ *
+ * When the wall types are known at compile time, they can be collected into a
+ * wall_group, which stores copies of the walls in a tuple and applies them
+ * with calls that the compiler can inline. A wall_group can be used directly
+ * through its apply_walls() and point_inside_walls() functions, or added to a
+ * container as a single wall.
+ *
  * The wall objects can used for periodic calculations, although to obtain
  * valid results, the walls should also be periodic as well. For example, in a
  * domain that is periodic in the x direction, a cylinder aligned along the x
@@ -291,6 +324,21 @@
  * structures of these containers differ considerably, it requires a different
  * loop class that is not interoperable with the others.
  *
+ * The compute_parallel routine can be used to compute the Voronoi cells for
+ * any of the loop classes using several threads. It divides the particles
+ * visited by the loop into tasks that are scheduled with a work-stealing task
+ * pool, and each thread uses its own voronoicell class and its own copy of the
+ * voro_compute template.
+ *
+ * The output_parallel routine computes the cells in a similar way, and formats
+ * the output of each task into a separate buffer, which a writer thread then
+ * writes to a file, either in the order of the loop or as soon as each task is
+ * complete. The print_custom_parallel, draw_cells_gnuplot_parallel, and
+ * draw_cells_pov_parallel routines use it to produce the same output as their
+ * serial counterparts.
+ * The output_parallel_files routine writes to several files at once, so that
+ * several kinds of output can be made while computing each cell only once.
+ *
  * \section pre_container The pre_container classes
  * Voro++ makes use of internal computational grid of blocks that are used to
  * configure the code for maximum efficiency. As discussed on the library
@@ -320,6 +368,8 @@
 #include "config.hh"
 #include "common.hh"
 #include "cell.hh"
+#include "custom_format.hh"
+#include "binary_output.hh"
 #include "v_base.hh"
 #include "rad_option.hh"
 #include "container.hh"
@@ -329,5 +379,7 @@
 #include "v_compute.hh"
 #include "c_loops.hh"
 #include "wall.hh"
+#include "wall_mesh.hh"
+#include "parallel.hh"
 
 #endif
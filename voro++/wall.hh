@@ -10,6 +10,8 @@
 #ifndef VOROPP_WALL_HH
 #define VOROPP_WALL_HH
 
+#include <tuple>
+
 #include "cell.hh"
 #include "container.hh"
 
@@ -29,6 +31,8 @@ struct wall_sphere : public wall {
 		wall_sphere(double xc_,double yc_,double zc_,double rc_,int w_id_=-99)
 			: w_id(w_id_), xc(xc_), yc(yc_), zc(zc_), rc(rc_) {}
 		bool point_inside(double x,double y,double z);
+		/** Tests whether a box is inside the wall, by its corners. */
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {return corners_inside(xl,xh,yl,yh,zl,zh);}
 		template<class v_cell>
 		bool cut_cell_base(v_cell &c,double x,double y,double z);
 		bool cut_cell(voronoicell &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
@@ -51,6 +55,8 @@ struct wall_plane : public wall {
 		wall_plane(double xc_,double yc_,double zc_,double ac_,int w_id_=-99)
 			: w_id(w_id_), xc(xc_), yc(yc_), zc(zc_), ac(ac_) {}
 		bool point_inside(double x,double y,double z);
+		/** Tests whether a box is inside the wall, by its corners. */
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {return corners_inside(xl,xh,yl,yh,zl,zh);}
 		template<class v_cell>
 		bool cut_cell_base(v_cell &c,double x,double y,double z);
 		bool cut_cell(voronoicell &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
@@ -77,6 +83,8 @@ struct wall_cylinder : public wall {
 			: w_id(w_id_), xc(xc_), yc(yc_), zc(zc_), xa(xa_), ya(ya_), za(za_),
 			asi(1/(xa_*xa_+ya_*ya_+za_*za_)), rc(rc_) {}
 		bool point_inside(double x,double y,double z);
+		/** Tests whether a box is inside the wall, by its corners. */
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {return corners_inside(xl,xh,yl,yh,zl,zh);}
 		template<class v_cell>
 		bool cut_cell_base(v_cell &c,double x,double y,double z);
 		bool cut_cell(voronoicell &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
@@ -105,6 +113,8 @@ struct wall_cone : public wall {
 			asi(1/(xa_*xa_+ya_*ya_+za_*za_)),
 			gra(tan(ang)), sang(sin(ang)), cang(cos(ang)) {}
 		bool point_inside(double x,double y,double z);
+		/** Tests whether a box is inside the wall, by its corners. */
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {return corners_inside(xl,xh,yl,yh,zl,zh);}
 		template<class v_cell>
 		bool cut_cell_base(v_cell &c,double x,double y,double z);
 		bool cut_cell(voronoicell &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
@@ -114,6 +124,259 @@ struct wall_cone : public wall {
 		const double xc,yc,zc,xa,ya,za,asi,gra,sang,cang;
 };
 
+
+/** Tests to see whether a point is inside the sphere wall object.
+ * \param[in,out] (x,y,z) the vector to test.
+ * \return True if the point is inside, false if the point is outside. */
+inline bool wall_sphere::point_inside(double x,double y,double z) {
+	return (x-xc)*(x-xc)+(y-yc)*(y-yc)+(z-zc)*(z-zc)<rc*rc;
+}
+
+/** Cuts a cell by the sphere wall object. The spherical wall is approximated by
+ * a single plane applied at the point on the sphere which is closest to the center
+ * of the cell. This works well for particle arrangements that are packed against
+ * the wall, but loses accuracy for sparse particle distributions.
+ * \param[in,out] c the Voronoi cell to be cut.
+ * \param[in] (x,y,z) the location of the Voronoi cell.
+ * \return True if the cell still exists, false if the cell is deleted. */
+template<class v_cell>
+inline bool wall_sphere::cut_cell_base(v_cell &c,double x,double y,double z) {
+	double xd=x-xc,yd=y-yc,zd=z-zc,dq=xd*xd+yd*yd+zd*zd;
+	if (dq>1e-5) {
+		dq=2*(sqrt(dq)*rc-dq);
+		return c.nplane(xd,yd,zd,dq,w_id);
+	}
+	return true;
+}
+
+/** Tests to see whether a point is inside the plane wall object.
+ * \param[in] (x,y,z) the vector to test.
+ * \return True if the point is inside, false if the point is outside. */
+inline bool wall_plane::point_inside(double x,double y,double z) {
+	return x*xc+y*yc+z*zc<ac;
+}
+
+/** Cuts a cell by the plane wall object.
+ * \param[in,out] c the Voronoi cell to be cut.
+ * \param[in] (x,y,z) the location of the Voronoi cell.
+ * \return True if the cell still exists, false if the cell is deleted. */
+template<class v_cell>
+inline bool wall_plane::cut_cell_base(v_cell &c,double x,double y,double z) {
+	double dq=2*(ac-x*xc-y*yc-z*zc);
+	return c.nplane(xc,yc,zc,dq,w_id);
+}
+
+/** Tests to see whether a point is inside the cylindrical wall object.
+ * \param[in] (x,y,z) the vector to test.
+ * \return True if the point is inside, false if the point is outside. */
+inline bool wall_cylinder::point_inside(double x,double y,double z) {
+	double xd=x-xc,yd=y-yc,zd=z-zc;
+	double pa=(xd*xa+yd*ya+zd*za)*asi;
+	xd-=xa*pa;yd-=ya*pa;zd-=za*pa;
+	return xd*xd+yd*yd+zd*zd<rc*rc;
+}
+
+/** Cuts a cell by the cylindrical wall object. The cylindrical wall is
+ * approximated by a single plane applied at the point on the cylinder which is
+ * closest to the center of the cell. This works well for particle arrangements
+ * that are packed against the wall, but loses accuracy for sparse particle
+ * distributions.
+ * \param[in,out] c the Voronoi cell to be cut.
+ * \param[in] (x,y,z) the location of the Voronoi cell.
+ * \return True if the cell still exists, false if the cell is deleted. */
+template<class v_cell>
+inline bool wall_cylinder::cut_cell_base(v_cell &c,double x,double y,double z) {
+	double xd=x-xc,yd=y-yc,zd=z-zc,pa=(xd*xa+yd*ya+zd*za)*asi;
+	xd-=xa*pa;yd-=ya*pa;zd-=za*pa;
+	pa=xd*xd+yd*yd+zd*zd;
+	if(pa>1e-5) {
+		pa=2*(sqrt(pa)*rc-pa);
+		return c.nplane(xd,yd,zd,pa,w_id);
+	}
+	return true;
+}
+
+/** Tests to see whether a point is inside the cone wall object.
+ * \param[in] (x,y,z) the vector to test.
+ * \return True if the point is inside, false if the point is outside. */
+inline bool wall_cone::point_inside(double x,double y,double z) {
+	double xd=x-xc,yd=y-yc,zd=z-zc,pa=(xd*xa+yd*ya+zd*za)*asi;
+	xd-=xa*pa;yd-=ya*pa;zd-=za*pa;
+	pa*=gra;
+	if (pa<0) return false;
+	pa*=pa;
+	return xd*xd+yd*yd+zd*zd<pa;
+}
+
+/** Cuts a cell by the cone wall object. The conical wall is
+ * approximated by a single plane applied at the point on the cone which is
+ * closest to the center of the cell. This works well for particle arrangements
+ * that are packed against the wall, but loses accuracy for sparse particle
+ * distributions.
+ * \param[in,out] c the Voronoi cell to be cut.
+ * \param[in] (x,y,z) the location of the Voronoi cell.
+ * \return True if the cell still exists, false if the cell is deleted. */
+template<class v_cell>
+inline bool wall_cone::cut_cell_base(v_cell &c,double x,double y,double z) {
+	double xd=x-xc,yd=y-yc,zd=z-zc,xf,yf,zf,q,pa=(xd*xa+yd*ya+zd*za)*asi;
+	xd-=xa*pa;yd-=ya*pa;zd-=za*pa;
+	pa=xd*xd+yd*yd+zd*zd;
+	if(pa>1e-5) {
+		pa=1/sqrt(pa);
+		q=sqrt(asi);
+		xf=-sang*q*xa+cang*pa*xd;
+		yf=-sang*q*ya+cang*pa*yd;
+		zf=-sang*q*za+cang*pa*zd;
+		pa=2*(xf*(xc-x)+yf*(yc-y)+zf*(zc-z));
+		return c.nplane(xf,yf,zf,pa,w_id);
+	}
+	return true;
+}
+
+
+/** \brief A helper class for applying an operation to each element of a
+ * wall_group.
+ *
+ * This class steps through the walls of a wall_group in order, using the
+ * element index i as a template parameter, so that each call is resolved at
+ * compile time. The specialization for i equal to n ends the recursion.
+ * The member functions are called with qualified names, so that they bypass
+ * the virtual function tables and can be inlined. */
+template<int i,int n>
+struct wall_group_step {
+	template<class t_class>
+	static inline bool point_inside(t_class &t,double x,double y,double z) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return std::get<i>(t).w_class::point_inside(x,y,z)
+		     &&wall_group_step<i+1,n>::point_inside(t,x,y,z);
+	}
+	template<class t_class,class v_cell>
+	static inline bool cut_cell(t_class &t,v_cell &c,double x,double y,double z) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return std::get<i>(t).w_class::cut_cell(c,x,y,z)
+		     &&wall_group_step<i+1,n>::cut_cell(t,c,x,y,z);
+	}
+	template<class t_class>
+	static inline bool box_inside(t_class &t,double xl,double xh,double yl,double yh,double zl,double zh) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return std::get<i>(t).w_class::box_inside(xl,xh,yl,yh,zl,zh)
+		     &&wall_group_step<i+1,n>::box_inside(t,xl,xh,yl,yh,zl,zh);
+	}
+	template<class t_class>
+	static inline bool cut_after_search(t_class &t) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return std::get<i>(t).w_class::cut_after_search()
+		     &&wall_group_step<i+1,n>::cut_after_search(t);
+	}
+	template<class t_class,class v_cell>
+	static inline bool cut_members(t_class &t,v_cell &c,double x,double y,double z,unsigned int mask) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return (!(mask&(1u<<i))||std::get<i>(t).w_class::cut_cell(c,x,y,z))
+		     &&wall_group_step<i+1,n>::cut_members(t,c,x,y,z,mask);
+	}
+	template<class t_class>
+	static inline bool member_box_inside(t_class &t,int m,double xl,double xh,double yl,double yh,double zl,double zh) {
+		typedef typename std::tuple_element<i,t_class>::type w_class;
+		return m==i?std::get<i>(t).w_class::box_inside(xl,xh,yl,yh,zl,zh)
+		     :wall_group_step<i+1,n>::member_box_inside(t,m,xl,xh,yl,yh,zl,zh);
+	}
+};
+
+/** \brief The end of the recursion for the wall_group_step class. */
+template<int n>
+struct wall_group_step<n,n> {
+	template<class t_class>
+	static inline bool point_inside(t_class &t,double x,double y,double z) {return true;}
+	template<class t_class,class v_cell>
+	static inline bool cut_cell(t_class &t,v_cell &c,double x,double y,double z) {return true;}
+	template<class t_class>
+	static inline bool box_inside(t_class &t,double xl,double xh,double yl,double yh,double zl,double zh) {return true;}
+	template<class t_class>
+	static inline bool cut_after_search(t_class &t) {return true;}
+	template<class t_class,class v_cell>
+	static inline bool cut_members(t_class &t,v_cell &c,double x,double y,double z,unsigned int mask) {return true;}
+	template<class t_class>
+	static inline bool member_box_inside(t_class &t,int m,double xl,double xh,double yl,double yh,double zl,double zh) {return false;}
+};
+
+/** \brief A class representing a fixed collection of walls whose types are
+ * known at compile time.
+ *
+ * This class stores copies of a fixed set of wall objects in a tuple, and
+ * applies them in order using calls that are resolved at compile time. When
+ * the group is used on its own, its point_inside_walls() and apply_walls()
+ * functions have the same meaning as those in the wall_list class, but the
+ * individual wall routines can be inlined into them. The group is also
+ * derived from the wall class, so that it can be added to a container. The
+ * container culls each member separately for each block, and then makes a
+ * single virtual call per cell for the members that remain, inside which the
+ * member routines are inlined. Custom walls that are only known at run time
+ * can still be added to the container individually. */
+template<class... w_class>
+class wall_group : public wall {
+	static_assert(sizeof...(w_class)<=32,"a wall group holds at most 32 walls");
+	public:
+		/** The tuple of walls. */
+		std::tuple<w_class...> wt;
+		/** Constructs a wall group by copying a set of walls.
+		 * \param[in] w the walls to copy. */
+		wall_group(const w_class&... w) : wt(w...) {}
+		/** Determines whether a given position is inside all of the
+		 * walls in the group.
+		 * \param[in] (x,y,z) the position to test.
+		 * \return True if it is inside, false if it is outside. */
+		inline bool point_inside_walls(double x,double y,double z) {
+			return wall_group_step<0,sizeof...(w_class)>::point_inside(wt,x,y,z);
+		}
+		/** Cuts a Voronoi cell by all of the walls in the group.
+		 * \param[in] c a reference to the Voronoi cell in question.
+		 * \param[in] (x,y,z) the position of the cell.
+		 * \return True if the cell still exists, false if the cell is
+		 * deleted. */
+		template<class v_cell>
+		inline bool apply_walls(v_cell &c,double x,double y,double z) {
+			return wall_group_step<0,sizeof...(w_class)>::cut_cell(wt,c,x,y,z);
+		}
+		bool point_inside(double x,double y,double z) {return point_inside_walls(x,y,z);}
+		bool cut_cell(voronoicell &c,double x,double y,double z) {return apply_walls(c,x,y,z);}
+		bool cut_cell(voronoicell_neighbor &c,double x,double y,double z) {return apply_walls(c,x,y,z);}
+		/** Tests whether a box is inside all of the walls in the
+		 * group.
+		 * \param[in] (xl,xh) the x range of the box.
+		 * \param[in] (yl,yh) the y range of the box.
+		 * \param[in] (zl,zh) the z range of the box.
+		 * \return True if the box is inside, false otherwise. */
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {
+			return wall_group_step<0,sizeof...(w_class)>::box_inside(wt,xl,xh,yl,yh,zl,zh);
+		}
+		/** Determines whether the group should be applied after the
+		 * neighbor search, which is the case if this is true for all
+		 * of the walls in the group.
+		 * \return True if the group should be applied afterwards,
+		 *         false otherwise. */
+		bool cut_after_search() {
+			return wall_group_step<0,sizeof...(w_class)>::cut_after_search(wt);
+		}
+		int member_count() {return sizeof...(w_class);}
+		bool member_box_inside(int m,double xl,double xh,double yl,double yh,double zl,double zh) {
+			return wall_group_step<0,sizeof...(w_class)>::member_box_inside(wt,m,xl,xh,yl,yh,zl,zh);
+		}
+		bool cut_cell_members(voronoicell &c,double x,double y,double z,unsigned int mask) {
+			return wall_group_step<0,sizeof...(w_class)>::cut_members(wt,c,x,y,z,mask);
+		}
+		bool cut_cell_members(voronoicell_neighbor &c,double x,double y,double z,unsigned int mask) {
+			return wall_group_step<0,sizeof...(w_class)>::cut_members(wt,c,x,y,z,mask);
+		}
+};
+
+/** Creates a wall group from a set of walls, deducing the wall types.
+ * \param[in] w the walls to copy.
+ * \return The wall group. */
+template<class... w_class>
+inline wall_group<w_class...> make_wall_group(const w_class&... w) {
+	return wall_group<w_class...>(w...);
+}
+
 }
 
 #endif
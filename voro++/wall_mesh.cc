@@ -0,0 +1,398 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file wall_mesh.cc
+ * \brief Function implementations for the triangle mesh wall class. */
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "wall_mesh.hh"
+
+namespace voro {
+
+/** The direction of the rays that are cast to test whether a point is inside
+ * the mesh. It is chosen to be far from the coordinate axes and diagonals, so
+ * that rays are unlikely to pass through the edges of axis-aligned meshes. */
+static const double mesh_ray[3]={0.8617453,0.3879214,0.3268517};
+
+/** The maximum depth of the traversal stacks. Since the hierarchy is split at
+ * the median triangle, its depth is bounded by the logarithm of the number of
+ * triangles. */
+static const int mesh_stack_size=128;
+
+/** The squared ratio of the width to the length of a triangle below which it
+ * is treated as degenerate and removed. The value corresponds to the single
+ * precision used to store vertex positions in STL files. */
+static const double mesh_sliver_tolerance=1e-12;
+
+/** Constructs a mesh wall object by loading a closed triangle mesh from an STL
+ * file. Both the binary and the ASCII forms of the format are supported. If
+ * the file cannot be read, then the routine causes a fatal error.
+ * \param[in] filename the name of the file to read from.
+ * \param[in] w_id_ an ID number to associate with the wall for neighbor
+ *                  tracking. */
+wall_mesh::wall_mesh(const char *filename,int w_id_)
+	: w_id(w_id_), nt(0), tv(NULL), nd(NULL), nn(0) {
+	load_stl(filename);
+	setup();
+}
+
+/** Constructs a mesh wall object from an array of triangles.
+ * \param[in] nt_ the number of triangles.
+ * \param[in] v an array of vertex positions, with nine values for each
+ *              triangle.
+ * \param[in] w_id_ an ID number to associate with the wall for neighbor
+ *                  tracking. */
+wall_mesh::wall_mesh(int nt_,const double *v,int w_id_)
+	: w_id(w_id_), nt(nt_), tv(new double[9*nt_]), nd(NULL), nn(0) {
+	memcpy(tv,v,9*nt*sizeof(double));
+	setup();
+}
+
+/** Reads the triangles from an STL file. A file is treated as binary if its
+ * size matches the triangle count in its header, and as ASCII otherwise.
+ * \param[in] filename the name of the file to read from. */
+void wall_mesh::load_stl(const char *filename) {
+	FILE *fp=safe_fopen(filename,"rb");
+	unsigned char h[84],r[50];
+	long fs;
+	fseek(fp,0,SEEK_END);fs=ftell(fp);rewind(fp);
+	if(fs>=84&&fread(h,1,84,fp)==84) {
+		unsigned long n=h[80]|(h[81]<<8)|(h[82]<<16)|((unsigned long) h[83]<<24);
+		if((unsigned long) fs==84+50*n) {
+
+			// Read the binary records, assembling each
+			// little-endian float from its bytes
+			nt=n;tv=new double[9*nt];
+			double *tp=tv;
+			for(int i=0;i<nt;i++) {
+				if(fread(r,1,50,fp)!=50) voro_fatal_error("STL import error: file is truncated",VOROPP_FILE_ERROR);
+				for(unsigned char *rp=r+12;rp<r+48;rp+=4) {
+					unsigned int u=rp[0]|(rp[1]<<8)|(rp[2]<<16)|((unsigned int) rp[3]<<24);
+					float f;
+					memcpy(&f,&u,4);
+					*(tp++)=f;
+				}
+			}
+			fclose(fp);
+			return;
+		}
+	}
+
+	// Read an ASCII file by collecting the coordinates that follow each
+	// "vertex" keyword
+	std::vector<double> v;
+	char buf[64];
+	double x,y,z;
+	rewind(fp);
+	if(fscanf(fp,"%63s",buf)!=1||strcmp(buf,"solid")!=0)
+		voro_fatal_error("STL import error: unrecognized file format",VOROPP_FILE_ERROR);
+	while(fscanf(fp,"%63s",buf)==1) if(strcmp(buf,"vertex")==0) {
+		if(fscanf(fp,"%lg %lg %lg",&x,&y,&z)!=3)
+			voro_fatal_error("STL import error: malformed vertex",VOROPP_FILE_ERROR);
+		v.push_back(x);v.push_back(y);v.push_back(z);
+	}
+	fclose(fp);
+	if(v.size()%9!=0) voro_fatal_error("STL import error: incomplete facet",VOROPP_FILE_ERROR);
+	nt=v.size()/9;tv=new double[9*nt];
+	if(nt>0) memcpy(tv,&v[0],9*nt*sizeof(double));
+}
+
+/** Removes any degenerate triangles, orients the triangles outwards, and then
+ * constructs the bounding volume hierarchy, reordering the triangles so that
+ * each leaf refers to a contiguous range. */
+void wall_mesh::setup() {
+	int i,j;
+	double *tp=tv,*tq=tv,*ntv,*ce,ax,ay,az,bx,by,bz,cx,cy,cz,l;
+
+	// Remove triangles whose width is negligible compared to their
+	// length, since their normal vectors are dominated by rounding errors
+	// and would produce spurious cuts
+	for(i=0;i<nt;i++,tp+=9) {
+		ax=tp[3]-*tp;ay=tp[4]-tp[1];az=tp[5]-tp[2];
+		bx=tp[6]-*tp;by=tp[7]-tp[1];bz=tp[8]-tp[2];
+		cx=ay*bz-az*by;cy=az*bx-ax*bz;cz=ax*by-ay*bx;
+		l=std::max(ax*ax+ay*ay+az*az,bx*bx+by*by+bz*bz);
+		if(cx*cx+cy*cy+cz*cz>mesh_sliver_tolerance*l*l) {
+			if(tq!=tp) memcpy(tq,tp,9*sizeof(double));
+			tq+=9;
+		}
+	}
+	nt=(tq-tv)/9;
+	if(nt==0) voro_fatal_error("Mesh wall has no triangles",VOROPP_FILE_ERROR);
+
+	// Compute the signed volume enclosed by the mesh, and reverse all of
+	// the triangles if it is negative, so that their normal vectors point
+	// outwards
+	double vol=0;
+	for(i=0,tp=tv;i<nt;i++,tp+=9)
+		vol+=*tp*(tp[4]*tp[8]-tp[5]*tp[7])+tp[1]*(tp[5]*tp[6]-tp[3]*tp[8])+tp[2]*(tp[3]*tp[7]-tp[4]*tp[6]);
+	if(vol<0) for(i=0,tp=tv;i<nt;i++,tp+=9)
+		for(j=0;j<3;j++) std::swap(tp[3+j],tp[6+j]);
+
+	// Build the hierarchy over the triangle centroids
+	int *ix=new int[nt];
+	ce=new double[3*nt];
+	for(i=0,tp=tv;i<nt;i++,tp+=9) {
+		ix[i]=i;
+		for(j=0;j<3;j++) ce[3*i+j]=(tp[j]+tp[3+j]+tp[6+j])*(1/3.0);
+	}
+	nd=new mesh_node[2*nt];nn=1;
+	build(0,0,nt,ix,ce);
+
+	// Store the triangles in the order of the leaves
+	ntv=new double[9*nt];
+	for(i=0;i<nt;i++) memcpy(ntv+9*i,tv+9*ix[i],9*sizeof(double));
+	delete [] tv;tv=ntv;
+	delete [] ce;
+	delete [] ix;
+}
+
+/** Sets up a node of the hierarchy for a range of triangles, splitting it at
+ * the median centroid along its longest direction if it holds more than
+ * mesh_leaf_triangles triangles.
+ * \param[in] m the index of the node.
+ * \param[in] (s,e) the range of the triangle index array to consider.
+ * \param[in,out] ix the triangle index array, which is partitioned.
+ * \param[in] ce the triangle centroids. */
+void wall_mesh::build(int m,int s,int e,int *ix,double *ce) {
+	mesh_node &no=nd[m];
+	double cb[6],*tp,*cp;
+	int i,j,a,mid;
+
+	// Compute the bounding box of the triangles and their centroids
+	for(j=0;j<3;j++) {
+		no.b[2*j]=cb[2*j]=large_number;
+		no.b[2*j+1]=cb[2*j+1]=-large_number;
+	}
+	for(i=s;i<e;i++) {
+		tp=tv+9*ix[i];cp=ce+3*ix[i];
+		for(j=0;j<3;j++) {
+			no.b[2*j]=std::min(no.b[2*j],std::min(tp[j],std::min(tp[3+j],tp[6+j])));
+			no.b[2*j+1]=std::max(no.b[2*j+1],std::max(tp[j],std::max(tp[3+j],tp[6+j])));
+			if(cp[j]<cb[2*j]) cb[2*j]=cp[j];
+			if(cp[j]>cb[2*j+1]) cb[2*j+1]=cp[j];
+		}
+	}
+
+	// Make a leaf if there are few triangles, or if their centroids
+	// coincide so that they cannot be separated
+	a=cb[1]-*cb>cb[3]-cb[2]?(cb[1]-*cb>cb[5]-cb[4]?0:2):(cb[3]-cb[2]>cb[5]-cb[4]?1:2);
+	if(e-s<=mesh_leaf_triangles||cb[2*a+1]==cb[2*a]) {
+		no.l=s;no.n=e-s;
+		return;
+	}
+
+	// Split the triangles at the median centroid
+	mid=(s+e)>>1;
+	std::nth_element(ix+s,ix+mid,ix+e,[ce,a](int p,int q) {return ce[3*p+a]<ce[3*q+a];});
+	no.l=nn;no.n=0;nn+=2;
+	build(no.l,s,mid,ix,ce);
+	build(no.l+1,mid,e,ix,ce);
+}
+
+/** Tests whether the ray from a point in the mesh_ray direction passes
+ * through a triangle, using the Moller-Trumbore algorithm.
+ * \param[in] t the vertex positions of the triangle.
+ * \param[in] (x,y,z) the origin of the ray.
+ * \return True if the ray hits the triangle, false otherwise. */
+bool wall_mesh::ray_hits(const double *t,double x,double y,double z) {
+	double ax=t[3]-*t,ay=t[4]-t[1],az=t[5]-t[2];
+	double bx=t[6]-*t,by=t[7]-t[1],bz=t[8]-t[2];
+	double px=mesh_ray[1]*bz-mesh_ray[2]*by,py=mesh_ray[2]*bx-mesh_ray[0]*bz,pz=mesh_ray[0]*by-mesh_ray[1]*bx;
+	double det=ax*px+ay*py+az*pz,sx,sy,sz,qx,qy,qz,u,v;
+	if(det==0) return false;
+	det=1/det;
+	sx=x-*t;sy=y-t[1];sz=z-t[2];
+	u=(sx*px+sy*py+sz*pz)*det;
+	if(u<0||u>1) return false;
+	qx=sy*az-sz*ay;qy=sz*ax-sx*az;qz=sx*ay-sy*ax;
+	v=(mesh_ray[0]*qx+mesh_ray[1]*qy+mesh_ray[2]*qz)*det;
+	if(v<0||u+v>1) return false;
+	return (bx*qx+by*qy+bz*qz)*det>0;
+}
+
+/** Finds the point on a triangle that is closest to a given position.
+ * \param[in] t the vertex positions of the triangle.
+ * \param[in] (x,y,z) the position to consider.
+ * \param[out] q the closest point. */
+void wall_mesh::closest_point(const double *t,double x,double y,double z,double *q) {
+	double ax=t[3]-*t,ay=t[4]-t[1],az=t[5]-t[2];
+	double bx=t[6]-*t,by=t[7]-t[1],bz=t[8]-t[2];
+	double px=x-*t,py=y-t[1],pz=z-t[2];
+	double d1=ax*px+ay*py+az*pz,d2=bx*px+by*py+bz*pz,d3,d4,d5,d6,va,vb,vc,v,w;
+
+	// Test the vertex regions and edge regions in turn
+	if(d1<=0&&d2<=0) {*q=*t;q[1]=t[1];q[2]=t[2];return;}
+	px=x-t[3];py=y-t[4];pz=z-t[5];
+	d3=ax*px+ay*py+az*pz;d4=bx*px+by*py+bz*pz;
+	if(d3>=0&&d4<=d3) {*q=t[3];q[1]=t[4];q[2]=t[5];return;}
+	vc=d1*d4-d3*d2;
+	if(vc<=0&&d1>=0&&d3<=0) {
+		v=d1/(d1-d3);
+		*q=*t+v*ax;q[1]=t[1]+v*ay;q[2]=t[2]+v*az;return;
+	}
+	px=x-t[6];py=y-t[7];pz=z-t[8];
+	d5=ax*px+ay*py+az*pz;d6=bx*px+by*py+bz*pz;
+	if(d6>=0&&d5<=d6) {*q=t[6];q[1]=t[7];q[2]=t[8];return;}
+	vb=d5*d2-d1*d6;
+	if(vb<=0&&d2>=0&&d6<=0) {
+		w=d2/(d2-d6);
+		*q=*t+w*bx;q[1]=t[1]+w*by;q[2]=t[2]+w*bz;return;
+	}
+	va=d3*d6-d5*d4;
+	if(va<=0&&d4-d3>=0&&d5-d6>=0) {
+		w=(d4-d3)/((d4-d3)+(d5-d6));
+		*q=t[3]+w*(t[6]-t[3]);q[1]=t[4]+w*(t[7]-t[4]);q[2]=t[5]+w*(t[8]-t[5]);return;
+	}
+
+	// The closest point is in the interior of the face
+	w=1/(va+vb+vc);v=vb*w;w*=vc;
+	*q=*t+ax*v+bx*w;q[1]=t[1]+ay*v+by*w;q[2]=t[2]+az*v+bz*w;
+}
+
+/** Tests to see whether a point is inside the mesh wall object, by counting
+ * the number of triangles crossed by a ray cast from the point. Only the
+ * nodes of the hierarchy whose bounding boxes meet the ray are visited.
+ * \param[in] (x,y,z) the vector to test.
+ * \return True if the point is inside, false if the point is outside. */
+bool wall_mesh::point_inside(double x,double y,double z) {
+	const double *b=nd->b;
+	if(x<*b||x>b[1]||y<b[2]||y>b[3]||z<b[4]||z>b[5]) return false;
+	int st[mesh_stack_size],*sp=st;
+	bool in=false;
+	double t0,t1,u0,u1;
+	*(sp++)=0;
+	while(sp>st) {
+		mesh_node &no=nd[*(--sp)];
+		b=no.b;
+
+		// Skip the node if the ray misses its bounding box. Since
+		// all the ray components are positive, each slab is entered
+		// at its lower face.
+		t0=(*b-x)/mesh_ray[0];t1=(b[1]-x)/mesh_ray[0];
+		u0=(b[2]-y)/mesh_ray[1];u1=(b[3]-y)/mesh_ray[1];
+		if(u0>t0) t0=u0;
+		if(u1<t1) t1=u1;
+		u0=(b[4]-z)/mesh_ray[2];u1=(b[5]-z)/mesh_ray[2];
+		if(u0>t0) t0=u0;
+		if(u1<t1) t1=u1;
+		if(t1<0||t0>t1) continue;
+
+		if(no.n>0) {
+			for(double *tp=tv+9*no.l,*te=tp+9*no.n;tp<te;tp+=9)
+				if(ray_hits(tp,x,y,z)) in=!in;
+		} else {
+			*(sp++)=no.l;
+			*(sp++)=no.l+1;
+		}
+	}
+	return in;
+}
+
+/** Tests whether a box is inside the mesh wall object. This is true if no
+ * triangle's bounding box meets the box, and the center of the box is inside
+ * the mesh.
+ * \param[in] (xl,xh) the x range of the box.
+ * \param[in] (yl,yh) the y range of the box.
+ * \param[in] (zl,zh) the z range of the box.
+ * \return True if the box is inside, false otherwise. */
+bool wall_mesh::box_inside(double xl,double xh,double yl,double yh,double zl,double zh) {
+	int st[mesh_stack_size],*sp=st;
+	const double *b;
+	*(sp++)=0;
+	while(sp>st) {
+		mesh_node &no=nd[*(--sp)];
+		b=no.b;
+		if(b[1]<xl||*b>xh||b[3]<yl||b[2]>yh||b[5]<zl||b[4]>zh) continue;
+		if(no.n>0) {
+			for(double *tp=tv+9*no.l,*te=tp+9*no.n;tp<te;tp+=9) {
+				if(std::max(*tp,std::max(tp[3],tp[6]))<xl||std::min(*tp,std::min(tp[3],tp[6]))>xh) continue;
+				if(std::max(tp[1],std::max(tp[4],tp[7]))<yl||std::min(tp[1],std::min(tp[4],tp[7]))>yh) continue;
+				if(std::max(tp[2],std::max(tp[5],tp[8]))<zl||std::min(tp[2],std::min(tp[5],tp[8]))>zh) continue;
+				return false;
+			}
+		} else {
+			*(sp++)=no.l;
+			*(sp++)=no.l+1;
+		}
+	}
+	return point_inside(0.5*(xl+xh),0.5*(yl+yh),0.5*(zl+zh));
+}
+
+/** Cuts a cell by the mesh wall object, using the planes of the triangles that
+ * are closer to the particle than the furthest vertex of the cell. For a
+ * convex mesh, this gives the exact intersection of the cell with the
+ * interior, since any part of the cell that is outside must leave the interior
+ * through one of these triangles. Triangles that face towards the particle
+ * are skipped, since they bound a non-convex part of the interior. The
+ * hierarchy is searched nearest first, and the search radius shrinks as the
+ * cell is cut, so that only the triangles near to the cell are considered. If
+ * the particle is outside the mesh, then the cell is removed.
+ * \param[in,out] c the Voronoi cell to be cut.
+ * \param[in] (x,y,z) the location of the Voronoi cell.
+ * \return True if the cell still exists, false if the cell is deleted. */
+template<class v_cell>
+bool wall_mesh::cut_cell_base(v_cell &c,double x,double y,double z) {
+	int st[mesh_stack_size],*sp=st;
+	double r2=0.25*c.max_radius_squared(),q[3],ax,ay,az,bx,by,bz,xd,yd,zd,dp,d0,d1;
+	if(!point_inside(x,y,z)) return false;
+	*(sp++)=0;
+	while(sp>st) {
+		mesh_node &no=nd[*(--sp)];
+		if(box_distance_squared(no.b,x,y,z)>=r2) continue;
+		if(no.n>0) {
+			for(double *tp=tv+9*no.l,*te=tp+9*no.n;tp<te;tp+=9) {
+
+				// Skip the triangle if it is further away than
+				// the cell extends
+				closest_point(tp,x,y,z,q);
+				xd=*q-x;yd=q[1]-y;zd=q[2]-z;
+				if(xd*xd+yd*yd+zd*zd>=r2) continue;
+
+				// Cut with the plane of the triangle, if the
+				// particle is behind it. The normal vector is
+				// scaled to the displacement of the particle's
+				// mirror image, as for a particle cut. Planes
+				// that do not reach beyond the cell are
+				// skipped, since the plane routine treats a
+				// plane through an existing face as removing
+				// the cell, and neighboring triangles are often
+				// coplanar.
+				ax=tp[3]-*tp;ay=tp[4]-tp[1];az=tp[5]-tp[2];
+				bx=tp[6]-*tp;by=tp[7]-tp[1];bz=tp[8]-tp[2];
+				xd=ay*bz-az*by;yd=az*bx-ax*bz;zd=ax*by-ay*bx;
+				dp=xd*(*tp-x)+yd*(tp[1]-y)+zd*(tp[2]-z);
+				if(dp>0) {
+					dp*=2/(xd*xd+yd*yd+zd*zd);
+					xd*=dp;yd*=dp;zd*=dp;
+					dp=xd*xd+yd*yd+zd*zd;
+					if(c.plane_intersects_guess(xd,yd,zd,dp+tolerance2)) {
+						if(!c.nplane(xd,yd,zd,dp,w_id)) return false;
+						r2=0.25*c.max_radius_squared();
+					}
+				}
+			}
+		} else {
+
+			// Push the further child first, so that the nearer one
+			// is searched first
+			d0=box_distance_squared(nd[no.l].b,x,y,z);
+			d1=box_distance_squared(nd[no.l+1].b,x,y,z);
+			if(d0<d1) {*(sp++)=no.l+1;*(sp++)=no.l;}
+			else {*(sp++)=no.l;*(sp++)=no.l+1;}
+		}
+	}
+	return true;
+}
+
+// Explicit instantiation
+template bool wall_mesh::cut_cell_base(voronoicell&,double,double,double);
+template bool wall_mesh::cut_cell_base(voronoicell_neighbor&,double,double,double);
+
+}
@@ -0,0 +1,103 @@
+// Voro++, a 3D cell-based Voronoi library
+//
+// Author   : Chris H. Rycroft (LBL / UC Berkeley)
+// Email    : chr@alum.mit.edu
+// Date     : August 30th 2011
+
+/** \file wall_mesh.hh
+ * \brief Header file for the triangle mesh wall class. */
+
+#ifndef VOROPP_WALL_MESH_HH
+#define VOROPP_WALL_MESH_HH
+
+#include "config.hh"
+#include "cell.hh"
+#include "container.hh"
+
+namespace voro {
+
+/** \brief A node in the bounding volume hierarchy of a triangle mesh.
+ *
+ * Each node stores the bounding box of the triangles beneath it. For a leaf
+ * node, l is the index of the first triangle and n is the number of
+ * triangles. For an internal node, n is zero and the two children are stored
+ * at indices l and l+1. */
+struct mesh_node {
+	/** The bounding box, stored as the minimum and maximum in the x, y,
+	 * and z directions. */
+	double b[6];
+	/** The index of the first triangle or the first child. */
+	int l;
+	/** The number of triangles in a leaf node, or zero for an internal
+	 * node. */
+	int n;
+};
+
+/** \brief A class representing a wall object made from a closed triangle mesh.
+ *
+ * This class represents a wall object whose interior is the region enclosed
+ * by a closed triangle mesh, such as one loaded from an STL file. The
+ * triangles are stored in a bounding volume hierarchy, so that point
+ * containment can be tested by casting a single ray, and so that each cell is
+ * only cut by the planes of the triangles that are close to it. The triangles
+ * are reoriented if necessary so that their normals point outwards. */
+struct wall_mesh : public wall {
+	public:
+		wall_mesh(const char *filename,int w_id_=-99);
+		wall_mesh(int nt_,const double *v,int w_id_=-99);
+		/** The class destructor frees the dynamically allocated memory
+		 * for the triangles and the hierarchy. */
+		~wall_mesh() {
+			delete [] nd;
+			delete [] tv;
+		}
+		bool point_inside(double x,double y,double z);
+		bool box_inside(double xl,double xh,double yl,double yh,double zl,double zh);
+		/** The mesh wall is applied after the neighbor search, since
+		 * the number of triangles that must be considered grows with
+		 * the size of the cell.
+		 * \return True. */
+		bool cut_after_search() {return true;}
+		template<class v_cell>
+		bool cut_cell_base(v_cell &c,double x,double y,double z);
+		bool cut_cell(voronoicell &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
+		bool cut_cell(voronoicell_neighbor &c,double x,double y,double z) {return cut_cell_base(c,x,y,z);}
+		/** Returns the number of triangles in the mesh. */
+		inline int total_triangles() {return nt;}
+	private:
+		const int w_id;
+		/** The number of triangles. */
+		int nt;
+		/** The vertex positions of the triangles, with nine values per
+		 * triangle, in the order given by the hierarchy leaves. */
+		double *tv;
+		/** The nodes of the bounding volume hierarchy, with the root
+		 * node first. */
+		mesh_node *nd;
+		/** The number of nodes in the hierarchy. */
+		int nn;
+		void load_stl(const char *filename);
+		void setup();
+		void build(int m,int s,int e,int *ix,double *ce);
+		bool ray_hits(const double *t,double x,double y,double z);
+		void closest_point(const double *t,double x,double y,double z,double *q);
+		/** Computes the squared distance from a point to the bounding
+		 * box of a node.
+		 * \param[in] b the bounding box.
+		 * \param[in] (x,y,z) the position to consider.
+		 * \return The squared distance, which is zero if the point is
+		 *         inside the box. */
+		inline double box_distance_squared(const double *b,double x,double y,double z) {
+			double d=0,e;
+			if(x<*b) {e=*b-x;d+=e*e;} else if(x>b[1]) {e=x-b[1];d+=e*e;}
+			if(y<b[2]) {e=b[2]-y;d+=e*e;} else if(y>b[3]) {e=y-b[3];d+=e*e;}
+			if(z<b[4]) {e=b[4]-z;d+=e*e;} else if(z>b[5]) {e=z-b[5];d+=e*e;}
+			return d;
+		}
+		wall_mesh(const wall_mesh&);
+		wall_mesh& operator=(const wall_mesh&);
+};
+
+}
+
+#endif
@@ -85,9 +85,11 @@ var Voro3 = function () {
         var cell_ids = that.inds_to_ids(cells);
         this.redo = function() {
             var inds = that.ids_to_inds(cell_ids);
+            that.begin_type_batch();
             for (var i=0; i<inds.length; i++) {
                 that.voro.toggle_cell(inds[i], active_type);
             }
+            that.end_type_batch();
         };
         this.undo = this.redo;
     };
@@ -99,9 +101,11 @@ var Voro3 = function () {
         }
         this.set = function(what_states) {
             var inds = that.ids_to_inds(cell_ids);
+            that.begin_type_batch();
             for (var i=0; i<inds.length; i++) {
                 that.voro.set_cell(inds[i], what_states[i]);
             }
+            that.end_type_batch();
         };
         this.undo = function() {
             this.set(old_states);
@@ -405,6 +409,10 @@ var Voro3 = function () {
         this.sites_points = new THREE.Points(this.sites_geometry, this.sites_material);
     };
     
+    // builds of vorowrap.js from before the gl buffers could hold normals don't export has_normals or gl_normals
+    this.has_normals = function() {
+        return !!this.voro.has_normals && this.voro.has_normals();
+    };
     this.alloc_geometry = function(geometry, realloc_only) {
         this.verts_ptr = this.voro.gl_vertices();
         var max_tris = this.voro.gl_max_tris();
@@ -415,13 +423,19 @@ var Voro3 = function () {
             var colors_ptr = this.voro.gl_colors();
             colors_array = Module.HEAPF32.subarray(colors_ptr/4, colors_ptr/4 + max_tris*3*3);
         }
-        if (realloc_only && array === this.cached_geometry_array && colors_array === this.cached_colors_array) {
+        var normals_array;
+        if (this.has_normals()) {
+            var normals_ptr = this.voro.gl_normals();
+            normals_array = Module.HEAPF32.subarray(normals_ptr/4, normals_ptr/4 + max_tris*3*3);
+        }
+        if (realloc_only && array === this.cached_geometry_array && colors_array === this.cached_colors_array && normals_array === this.cached_normals_array) {
             return;
         }
-        if (this.cached_geometry_array || this.cached_colors_array) {
+        if (this.cached_geometry_array || this.cached_colors_array || this.cached_normals_array) {
             geometry.dispose();
         }
         this.cached_colors_array = colors_array;
+        this.cached_normals_array = normals_array;
         this.cached_geometry_array = array;
         geometry.addAttribute('position', new THREE.BufferAttribute(array, 3));
         if (want_colors) {
@@ -429,6 +443,11 @@ var Voro3 = function () {
         } else {
             geometry.removeAttribute('color');
         }
+        if (normals_array) {
+            geometry.addAttribute('normal', new THREE.BufferAttribute(normals_array, 3));
+        } else {
+            geometry.removeAttribute('normal');
+        }
         this.set_vertex_colors();
     };
     this.makeBoundingSphere = function() {
@@ -590,6 +609,9 @@ var Voro3 = function () {
         this.alloc_geometry(this.geometry, true);
         this.geometry.setDrawRange(0, num_tris*3);
         this.geometry.attributes.position.needsUpdate = true;
+        if (this.geometry.attributes.normal) {
+            this.geometry.attributes.normal.needsUpdate = true;
+        }
         this.update_sites();
     };
     this.update_preview = function() {
@@ -879,6 +901,18 @@ var Voro3 = function () {
             return [l, ind+1];
         }
     };
+    // type batches let the C++ side rebuild each changed cell once; builds of vorowrap.js from before they existed
+    // don't export them, and just rebuild each cell as it changes
+    this.begin_type_batch = function() {
+        if (this.voro.begin_type_batch) {
+            this.voro.begin_type_batch();
+        }
+    };
+    this.end_type_batch = function() {
+        if (this.voro.end_type_batch) {
+            this.voro.end_type_batch();
+        }
+    };
     this.set_cell = function(cell, state, sym_flag) { // sym_flag is true if fn was called from w/in a symmetry op, undefined/falsey o.w.
         if (cell < 0) { return; }
         this.track_act(new SetCellAct([cell], [state]));
@@ -886,9 +920,11 @@ var Voro3 = function () {
         if (!sym_flag) {
             if (this.active_sym) {
                 var slist = this.ordered_sym_list(cell);
+                this.begin_type_batch();
                 for (var i=0; i<slist[0].length; i++) {
                     this.set_cell(this.voro.index_from_id(slist[0][i]), state, true);
                 }
+                this.end_type_batch();
             }
         }
     };
@@ -903,9 +939,11 @@ var Voro3 = function () {
         if (!sym_flag) {
             if (this.active_sym) {
                 var slist = this.ordered_sym_list(cell);
+                this.begin_type_batch();
                 for (var i=0; i<slist[0].length; i++) {
                     this.toggle_cell(this.voro.index_from_id(slist[0][i]), true);
                 }
+                this.end_type_batch();
             }
             this.update_geometry();
         }
@@ -949,13 +987,28 @@ var Voro3 = function () {
         this.verts_ptr = this.voro.gl_vertices();
         var num_tris = this.voro.gl_tri_count();
         var array = Module.HEAPF32.subarray(this.verts_ptr/4, this.verts_ptr/4 + num_tris*3*3);
-        var buffer = new ArrayBuffer(80+4+num_tris*(4*4*3+2)); // buffer w/ space for whole stl
-        var view = new DataView(buffer);
-        view.setInt32(80, num_tris, true);
+        var normals; // the facet normals are left zero unless the C++ side is keeping normals
+        if (this.has_normals()) {
+            var normals_ptr = this.voro.gl_normals();
+            normals = Module.HEAPF32.subarray(normals_ptr/4, normals_ptr/4 + num_tris*3*3);
+        }
+        var live_tris = []; // skips the degenerate tris that pad out freed space in the gl buffers
         for (var i=0; i<num_tris; i++) {
+            if (this.voro.cell_from_vertex(i*3) >= 0) {
+                live_tris.push(i);
+            }
+        }
+        var buffer = new ArrayBuffer(80+4+live_tris.length*(4*4*3+2)); // buffer w/ space for whole stl
+        var view = new DataView(buffer);
+        view.setInt32(80, live_tris.length, true);
+        for (var oi=0; oi<live_tris.length; oi++) {
+            var i = live_tris[oi];
+            for (var di=0; normals && di<3; di++) {
+                view.setFloat32(80+4+oi*(4*4*3+2)+4*di, normals[i*3*3+di], true);
+            }
             for (var vi=0; vi<3; vi++) {
                 for (var di=0; di<3; di++) {
-                    view.setFloat32(80+4+i*(4*4*3+2)+4*3*(vi+1)+4*di, array[i*3*3+vi*3+di], true);
+                    view.setFloat32(80+4+oi*(4*4*3+2)+4*3*(vi+1)+4*di, array[i*3*3+vi*3+di], true);
                 }
             }
         }
@@ -3,8 +3,9 @@
 #include <iostream>
 #include <algorithm>
 #include <unordered_set>
-#include <unordered_map>
+#include <map>
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 
 #ifdef EMSCRIPTEN
@@ -13,6 +14,14 @@
 #include <emscripten/val.h>
 #endif
 
+// native builds, and wasm builds made with -pthread, can compute cells on several threads
+#if !defined(EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+#define BUILD_WITH_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
 #include "voro++/voro++.hh"
 #include "glm/vec3.hpp"
 #include "glm/gtx/norm.hpp"
@@ -27,6 +36,14 @@ using namespace emscripten;
 // the minimum squared distance between two cells.  If you try to move or add a cell closer to another cell than this threshold, the cell will be 'jittered' away from the colliding cell
 #define SHADOW_SEP_DIST .003
 #define SHADOW_THRESHOLD (SHADOW_SEP_DIST*SHADOW_SEP_DIST)
+// the cell_to_id entry of a cell that hasn't been given a stable id
+#define NO_STABLE_ID size_t(-1)
+// the number of threads compute_all and compute_on run voro++ on, or 0 for one per core
+#define BUILD_THREADS 0
+// a -pthread wasm build must link with -s PTHREAD_POOL_SIZE=<this>; the main thread can't wait for new workers to start, so the worker count is capped to it
+#define BUILD_PTHREAD_POOL_SIZE 4
+// the most computed cells compute_all and compute_on let wait to be placed, which bounds the memory they wait in
+#define BUILD_CHUNK_CELLS 4096
 
 inline void jitter(glm::vec3 &pt, double amt) {
     pt.x+=amt*(rand()%10000)/10000.0;
@@ -73,20 +90,49 @@ struct Cell {
     Cell(glm::vec3 pos, int type) : pos(pos), type(type) {}
 };
 
-struct CellCache { // computations from a voro++ computed cell
-    vector<int> faces; // faces as voro++ likes to store them -- packed as [#vs in f0, f0 v0, f0 v1, ..., #vs in f1, ...]
-    vector<double> vertices; // vertex coordinates, indexed by faces array
-    vector<int> neighbors; // cells neighboring each face
+// a run of elements in one of the GLBufferManager's pools; it indexes through the pool, so it stays valid as the pool grows
+template<typename T>
+struct PoolRange {
+    vector<T> *pool;
+    int start, len;
     
-    void clear() { faces.clear(); vertices.clear(); neighbors.clear(); }
-    void create(const glm::vec3 &pos, voro::voronoicell_neighbor &c) {
-        c.neighbors(neighbors);
-        // fills facev w/ faces as (#verts in face 1, face vert ind 1, ind 2, ..., #vs in f 2, f v ind 1, etc)
-        c.face_vertices(faces);
-        // makes all the vertices for the faces to reference
-        c.vertices(pos.x, pos.y, pos.z, vertices);
+    struct iterator {
+        vector<T> *pool;
+        int i;
+        T &operator*() const { return (*pool)[i]; }
+        iterator &operator++() { i++; return *this; }
+        bool operator!=(const iterator &o) const { return i != o.i; }
+    };
+    
+    PoolRange() : pool(0), start(0), len(0) {}
+    PoolRange(vector<T> &pool, int start, int len) : pool(&pool), start(start), len(len) {}
+    
+    T &operator[](int i) const { return (*pool)[start+i]; }
+    size_t size() const { return len; }
+    iterator begin() const { return iterator{pool, start}; }
+    iterator end() const { return iterator{pool, start+len}; }
+    void fill(const T &x) const {
+        for (int i=0; i<len; i++) (*pool)[start+i] = x;
     }
-    double doublearea(int i, int j, int k) {
+    vector<T> to_vector() const {
+        return len ? vector<T>(pool->begin()+start, pool->begin()+start+len) : vector<T>();
+    }
+};
+
+struct CellCache { // computations from a voro++ computed cell, kept in slabs of the GLBufferManager's cache pools
+    PoolRange<int> faces; // faces as voro++ likes to store them -- packed as [#vs in f0, f0 v0, f0 v1, ..., #vs in f1, ...]
+    PoolRange<double> vertices; // vertex coordinates, indexed by faces array
+    PoolRange<int> neighbors; // cells neighboring each face
+    int face_cap, vert_cap, neighbor_cap; // capacities of the slabs holding them; vert_cap counts vertices, not coordinates
+    // per-face info, filled by index_faces; these share their slabs with neighbors
+    PoolRange<int> face_starts; // index in faces of each face's vertex count
+    PoolRange<double> face_areas;
+    PoolRange<double> face_normals; // 3 per face: the unit normal, pointing out of the cell, or 0s for a degenerate face
+    
+    CellCache() : face_cap(0), vert_cap(0), neighbor_cap(0) {}
+    
+    // the cross product of the edges from vertex i to vertices j and k; its length is twice the area of their tri
+    void doublecross(int i, int j, int k, double o[3]) {
         double a[3] = {
             vertices[j*3+0]-vertices[i*3+0],
             vertices[j*3+1]-vertices[i*3+1],
@@ -97,57 +143,215 @@ struct CellCache { // computations from a voro++ computed cell
             vertices[k*3+1]-vertices[i*3+1],
             vertices[k*3+2]-vertices[i*3+2]
         };
-        double o[3] = {
-            a[1]*b[2]-a[2]*b[1],
-            a[2]*b[0]-a[0]*b[2],
-            a[0]*b[1]-a[1]*b[0]
-        };
-        return sqrt(o[0]*o[0]+o[1]*o[1]+o[2]*o[2]);
-    }
-    double face_size(int face) {
-        size_t i=0, fi=0;
-        for (; fi<face && i<faces.size(); fi++,i+=faces[i]+1) {}
-        double area = 0;
-        if (i<faces.size()) {
-            int vicount = faces[i];
+        o[0] = a[1]*b[2]-a[2]*b[1];
+        o[1] = a[2]*b[0]-a[0]*b[2];
+        o[2] = a[0]*b[1]-a[1]*b[0];
+    }
+    // fills the per-face info from faces and vertices; the ranges must already hold a slot per face
+    void index_faces() {
+        for (int i = 0, fi = 0; fi < (int)face_starts.size() && i < (int)faces.size(); i+=faces[i]+1, fi++) {
+            face_starts[fi] = i;
+            double area = 0, n[3] = {0, 0, 0};
+            // the same fan of tris add_cell_tris draws, so the normal agrees with their winding
             int vs[3] = {faces[i+1], 0, faces[i+2]};
-            for (int j = i+3; j < i+vicount+1; j++) { // facev
+            for (int j = i+3; j < i+faces[i]+1; j++) { // facev
                 vs[1] = faces[j];
-                
-                area += doublearea(vs[0],vs[1],vs[2]);
-                
+                double o[3];
+                doublecross(vs[0],vs[1],vs[2],o);
+                area += sqrt(o[0]*o[0]+o[1]*o[1]+o[2]*o[2]);
+                n[0] += o[0]; n[1] += o[1]; n[2] += o[2];
                 vs[2] = vs[1];
             }
+            face_areas[fi] = area*.5;
+            double len = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+            for (int k=0; k<3; k++) {
+                face_normals[fi*3+k] = len > 0 ? n[k]/len : 0;
+            }
         }
-        return area*.5;
+    }
+    double face_size(int face) {
+        if (face < 0 || face >= (int)face_areas.size()) return 0;
+        return face_areas[face];
+    }
+    glm::vec3 face_normal(int face) {
+        if (face < 0 || face >= (int)face_areas.size()) return glm::vec3(0);
+        return glm::vec3(face_normals[face*3], face_normals[face*3+1], face_normals[face*3+2]);
+    }
+    int face_vert_count(int face) {
+        if (face < 0 || face >= (int)face_starts.size()) return 0;
+        return faces[face_starts[face]];
     }
 };
 
 struct CellToTris {
-    vector<int> tri_inds; // indices into the GLBufferManager's vertices array, indicating which triangles are from this cell
-                            // i.e. if tri_inds[0]==47, then vertices[47*3] ... vertices[47*3+2] (incl.) are from this cell
-    vector<short> tri_faces;
+    bool live; // false until the cell is first computed, or once it's deleted; a live cell may still have an empty cache, if voro++ couldn't compute it
+    int chunk; // the GLBufferManager chunk holding this cell's tris and vertices
+    int tri_start, tri_cap, tri_used; // this cell's slab of its chunk's tris: tris [tri_start, tri_start+tri_cap) belong to this cell,
+                                      // the first tri_used of them are in use and the rest are degenerate
+                                      // i.e. tri k of this cell is at vertices[(tri_start+k)*9] ... vertices[(tri_start+k)*9+8] (incl.) in soup mode
+    int vert_start, vert_cap, vert_used; // indexed mode only: this cell's slab of its chunk's vertices, like the tri slab
+    PoolRange<int> vert_inds; // indexed mode only: indices into its chunk's vertices array of this cell's vertices
+                              // i.e. vertex i of the cache is stored at vertices[vert_inds[i]*3] ... vertices[vert_inds[i]*3+2] (incl.),
+                              // or vert_inds[i]==-1 if no drawn tri uses it; shares its slab with cache.vertices
     CellCache cache;
+    
+    CellToTris() : live(false), chunk(0), tri_start(0), tri_cap(0), tri_used(0), vert_start(0), vert_cap(0), vert_used(0) {}
+};
+
+struct ComputedCell { // a cell's info as voro++ computed it, on its way into the cache pools
+    bool ok; // false if voro++ couldn't compute the cell
+    vector<int> neighbors, faces;
+    vector<double> vertices;
+    
+    ComputedCell() : ok(false) {}
+    
+    void take(voro::voronoicell_neighbor &c, const glm::vec3 &pos) {
+        c.neighbors(neighbors);
+        // fills faces as (#verts in face 1, face vert ind 1, ind 2, ..., #vs in f 2, f v ind 1, etc)
+        c.face_vertices(faces);
+        // makes all the vertices for the faces to reference
+        c.vertices(pos.x, pos.y, pos.z, vertices);
+    }
 };
 
 struct Voro;
 
-struct GLBufferManager {
-    vector<float> vertices, wire_vertices, cell_sites, cell_site_sizes, colors;
-    bool want_colors;
-    int tri_count, max_tris, max_sites;
-    int wire_vert_count, wire_max_verts;
-    vector<int> cell_inds; // map from tri indices to cell indices
-    vector<short> cell_internal_inds; // map from tri indices to internal tri backref
-    voro::voronoicell_neighbor vorocell; // reused temp var, holds computed cell info
+// the most ranges a DirtyRanges keeps before merging them all into one
+#define MAX_DIRTY_RANGES 1024
+// the fewest released elements the gl buffers let pile up before asking for compaction; each chunk's SlabAllocators get an even share
+#define MIN_COMPACT_ELEMENTS 1024
+
+// tracks which elements of a gl buffer changed since the last upload, as coalesced [begin, end) ranges of element indices
+struct DirtyRanges {
+    vector<int> ranges; // packed as [begin0, end0, begin1, end1, ...]; unsorted and possibly overlapping until coalesce()
     
-    vector<CellToTris*> info;
+    void add(int begin, int end) {
+        if (begin >= end) return;
+        if (!ranges.empty() && begin <= ranges.back() && begin >= ranges[ranges.size()-2]) { // extends the latest range, e.g. for appends
+            ranges.back() = max(ranges.back(), end);
+            return;
+        }
+        ranges.push_back(begin);
+        ranges.push_back(end);
+        if (ranges.size()/2 > MAX_DIRTY_RANGES) {
+            coalesce();
+            if (ranges.size()/2 > MAX_DIRTY_RANGES/2) { // still too scattered to be worth tracking separately; also keeps coalesce() from rerunning on every add
+                int b = ranges[0], e = ranges.back();
+                ranges.clear();
+                add(b, e);
+            }
+        }
+    }
+    void add(int i) {
+        add(i, i+1);
+    }
+    void coalesce() { // sorts the ranges and merges any that overlap or touch
+        size_t n = ranges.size()/2;
+        vector<pair<int,int>> rs(n);
+        for (size_t i=0; i<n; i++) {
+            rs[i] = make_pair(ranges[i*2], ranges[i*2+1]);
+        }
+        sort(rs.begin(), rs.end());
+        ranges.clear();
+        for (auto &r : rs) {
+            if (!ranges.empty() && r.first <= ranges.back()) {
+                ranges.back() = max(ranges.back(), r.second);
+            } else {
+                ranges.push_back(r.first);
+                ranges.push_back(r.second);
+            }
+        }
+    }
+    void clear() {
+        ranges.clear();
+    }
+};
+
+// hands out contiguous slabs [start, start+cap) of a gl buffer's elements, so each cell's elements stay together and it can be rebuilt in place;
+// released slabs are reused by later cells of about the same size, and compaction (done by the owner, who knows what to move) packs the rest
+struct SlabAllocator {
+    int end; // one past the last element of any slab, i.e. the part of the buffer in use
+    int used_total; // the number of elements the owner actually uses, as reported through use()
+    int free_total; // the number of elements in released slabs
+    map<int, vector<int>> free_slabs; // starts of released slabs, by capacity
+    int min_waste; // the fewest released or spare elements worth compacting
     
-    GLBufferManager() : wire_vert_count(0), wire_max_verts(0), tri_count(0), max_tris(0), cell_inds(0), want_colors(false) {}
+    SlabAllocator() : end(0), used_total(0), free_total(0), min_waste(MIN_COMPACT_ELEMENTS) {}
     
-    explicit operator bool() { return !info.empty(); }
+    static int capacity_for(int n) { // leaves a little room, so a cell that gains an element or two is still rebuilt in place
+        return (n + n/4 + 3) & ~3;
+    }
+    static bool fits(int n, int cap) { // whether a slab of capacity cap is a reasonable home for n elements
+        return n <= cap && cap <= capacity_for(n)*3/2;
+    }
+    int alloc(int n, int &cap) { // returns the start of a slab of at least n elements, and sets cap to its capacity
+        auto it = free_slabs.lower_bound(n);
+        if (it != free_slabs.end() && fits(n, it->first)) {
+            cap = it->first;
+            int start = it->second.back();
+            it->second.pop_back();
+            if (it->second.empty()) free_slabs.erase(it);
+            free_total -= cap;
+            return start;
+        }
+        cap = capacity_for(n);
+        end += cap;
+        return end - cap;
+    }
+    void release(int start, int cap) {
+        if (cap <= 0) return;
+        if (start + cap == end) {
+            end = start;
+        } else {
+            free_slabs[cap].push_back(start);
+            free_total += cap;
+        }
+    }
+    void use(int delta) { // call as the owner starts or stops using elements of its slabs
+        used_total += delta;
+    }
+    bool fragmented() const { // true once enough of the buffer is released or spare capacity that the owner should compact
+        int waste = end - used_total;
+        return waste > min_waste && waste*3 > end;
+    }
+    void reset(int new_end) { // call after compacting everything below new_end
+        end = new_end;
+        free_total = 0;
+        free_slabs.clear();
+    }
+};
+
+// One chunk's share of the GL buffers: the tris of the cells whose sites lie in its box of the GLBufferManager's chunk grid.
+// By default the triangles are a non-indexed soup: vertices holds 9 floats per triangle.
+// In indexed mode, vertices holds each vertex used by a cell's drawn faces once (3 floats per vertex, with colors matching),
+// and indices holds 3 uint32 indices into it per triangle, so vertices shared by the fan triangles and faces of a cell are not repeated.
+// If want_normals is set, normals matches vertices: each soup tri gets its face's normal, and each indexed vertex gets
+// the area-weighted average of the normals of its cell's drawn faces around it.
+// Each cell's tris (and vertices) sit in one contiguous slab, so rebuilding a cell rewrites just its slab;
+// tris that aren't in use by any cell are degenerate, so drawing all tri_count tris is still fine.
+struct GLChunk {
+    vector<float> vertices, colors, normals;
+    vector<uint32_t> indices; // indexed mode only: 3 indices into vertices per tri
+    bool want_colors, want_normals, indexed; // copies of the GLBufferManager's settings
+    int id; // this chunk's index in the GLBufferManager's chunks, i.e. the CellToTris::chunk of its cells
+    int tri_count, max_tris; // tri_count is the end of the last tri slab, including degenerate tris
+    int vert_count, max_verts; // indexed mode only: the end of the last vertex slab, and the number of vertices allocated
+    vector<int> cell_inds; // map from tri indices to cell indices, or -1 for degenerate tris
+    vector<short> tri_faces; // map from tri indices to the face of their cell they cover
+    vector<int> vert_cell_inds; // indexed mode only: map from vertex indices to cell indices, or -1 for unused vertices
+    SlabAllocator tri_slabs, vert_slabs;
+    float bounds[6]; // min x, y, z then max x, y, z of the vertices written since the last compaction; min > max while there are none
     
-    bool sanity(string when, bool doassert=true) {
+    // changes since the last gl_clear_dirty(), so the js side can upload just those parts of the buffers:
+    DirtyRanges dirty_tris; // tri indices; covers vertices, colors and normals in soup mode, or indices in indexed mode
+    DirtyRanges dirty_verts; // indexed mode only: vertex indices; covers vertices, colors and normals
+    
+    GLChunk() : want_colors(false), want_normals(false), indexed(false), id(0), tri_count(0), max_tris(0), vert_count(0), max_verts(0) {
+        clear_bounds();
+    }
+    
+    // checks the buffers and the slabs of this chunk's cells
+    bool sanity(const vector<CellToTris> &info) {
         bool valid = true;
         if (vertices.size() != colors.size() && want_colors) {
             valid = false;
@@ -157,36 +361,452 @@ struct GLBufferManager {
             valid = false;
             cout << "don't want vertex colors, but somehow we still have " << colors.size() << " of them" << endl;
         }
+        if (normals.size() != (want_normals ? vertices.size() : 0)) {
+            valid = false;
+            cout << "normals don't match vertices: " << normals.size() << " vs " << vertices.size() << endl;
+        }
+        if (tri_count != tri_slabs.end || (indexed && vert_count != vert_slabs.end)) {
+            valid = false;
+            cout << "counts don't match the slabs: " << tri_count << " vs " << tri_slabs.end << ", " << vert_count << " vs " << vert_slabs.end << endl;
+        }
+        int used_tris = 0, used_verts = 0;
+        for (auto &c : info) {
+            if (c.chunk != id) continue;
+            used_tris += c.tri_used;
+            used_verts += c.vert_used;
+        }
+        if (used_tris != tri_slabs.used_total || used_verts != vert_slabs.used_total) {
+            valid = false;
+            cout << "slab use is off in chunk " << id << ": " << used_tris << " vs " << tri_slabs.used_total << ", " << used_verts << " vs " << vert_slabs.used_total << endl;
+        }
         for (int ci=0; ci<tri_count; ci++) {
-            if (cell_inds[ci] < 0 || cell_inds[ci] >= info.size()) {
+            if (cell_inds[ci] < -1 || cell_inds[ci] >= int(info.size())) {
                 valid = false;
                 cout << "invalid cell! " << cell_inds[ci] << " vs " << info.size() << endl;
+            } else if (cell_inds[ci] == -1) {
+                bool degenerate = true;
+                for (int k=1; k<3; k++) {
+                    if (indexed) {
+                        degenerate = degenerate && indices[ci*3+k] == indices[ci*3];
+                    } else {
+                        for (int ii=0; ii<3; ii++) degenerate = degenerate && vertices[ci*9+k*3+ii] == vertices[ci*9+ii];
+                    }
+                }
+                if (!degenerate) {
+                    valid = false;
+                    cout << "unused tri " << ci << " isn't degenerate" << endl;
+                }
+            } else if (info[cell_inds[ci]].chunk != id) {
+                valid = false;
+                cout << "tri " << ci << " of chunk " << id << " belongs to cell " << cell_inds[ci] << " of chunk " << info[cell_inds[ci]].chunk << endl;
+            } else {
+                for (int k=0; k<3; k++) {
+                    int vi = indexed ? int(indices[ci*3+k]) : ci*3+k;
+                    for (int ii=0; ii<3; ii++) {
+                        if (vertices[vi*3+ii] < bounds[ii] || vertices[vi*3+ii] > bounds[3+ii]) {
+                            valid = false;
+                            cout << "tri " << ci << " of chunk " << id << " is outside its bounds" << endl;
+                        }
+                    }
+                }
+            }
+        }
+        return valid;
+    }
+    
+    void resize_buffers() {
+        if (indexed) {
+            vertices.resize(max_verts*3);
+            vert_cell_inds.resize(max_verts, -1);
+            indices.resize(max_tris*3);
+        } else {
+            vertices.resize(max_tris*9);
+        }
+        cell_inds.resize(max_tris, -1);
+        tri_faces.resize(max_tris);
+        if (want_colors) {
+            colors.resize(vertices.size());
+        }
+        if (want_normals) {
+            normals.resize(vertices.size());
+        }
+        mark_all_tris_dirty(); // the buffers may have moved
+    }
+    void mark_all_tris_dirty() { // also marks all vertices, so use this whenever the colors all change
+        dirty_tris.clear();
+        dirty_tris.add(0, max_tris);
+        dirty_verts.clear();
+        dirty_verts.add(0, max_verts);
+    }
+    bool is_dirty() {
+        return !dirty_tris.ranges.empty() || !dirty_verts.ranges.empty();
+    }
+    
+    // vi indexes the drawn vertex stream: the vertices array in soup mode, or the indices array in indexed mode
+    int vert2cell(int vi) {
+        if (vi < 0 || vi >= tri_count*3)
+            return -1;
+        return cell_inds[vi/3];
+    }
+    
+    void clear_bounds() {
+        for (int ii=0; ii<3; ii++) {
+            bounds[ii] = INFINITY;
+            bounds[3+ii] = -INFINITY;
+        }
+    }
+    inline void grow_bounds(const float *v) {
+        for (int ii=0; ii<3; ii++) {
+            bounds[ii] = min(bounds[ii], v[ii]);
+            bounds[3+ii] = max(bounds[3+ii], v[ii]);
+        }
+    }
+    // shrinks the bounds to fit the vertices of the tris in use, as they may have grown around since-removed tris
+    void refit_bounds() {
+        clear_bounds();
+        if (indexed) {
+            for (int vi=0; vi<vert_count; vi++) {
+                if (vert_cell_inds[vi] >= 0) grow_bounds(&vertices[vi*3]);
+            }
+        } else {
+            for (int tri=0; tri<tri_count; tri++) {
+                if (cell_inds[tri] < 0) continue;
+                for (int vii=0; vii<3; vii++) grow_bounds(&vertices[tri*9+vii*3]);
+            }
+        }
+    }
+    
+    // makes the cell's tri slab hold at least n tris, moving it if it's too small or much too big; returns true if it moved to a new (all degenerate) slab
+    bool reserve_tris(vector<CellToTris> &info, CellToTris &c2t, int n) {
+        if (SlabAllocator::fits(n, c2t.tri_cap)) return false;
+        release_tris(c2t);
+        if (tri_slabs.fragmented()) {
+            compact_tris(info);
+        }
+        c2t.tri_start = tri_slabs.alloc(n, c2t.tri_cap);
+        if (tri_slabs.end > max_tris) {
+            while (max_tris < tri_slabs.end) max_tris = max(max_tris*2, 16);
+            resize_buffers();
+        }
+        tri_count = tri_slabs.end;
+        return true;
+    }
+    void release_tris(CellToTris &c2t) {
+        zero_tris(c2t.tri_start, c2t.tri_start + c2t.tri_used);
+        tri_slabs.use(-c2t.tri_used);
+        tri_slabs.release(c2t.tri_start, c2t.tri_cap);
+        c2t.tri_start = c2t.tri_cap = c2t.tri_used = 0;
+        tri_count = tri_slabs.end;
+    }
+    void zero_tris(int begin, int end) { // makes tris [begin, end) degenerate, so they draw nothing
+        if (begin >= end) return;
+        if (indexed) {
+            fill(indices.begin() + begin*3, indices.begin() + end*3, 0);
+        } else {
+            fill(vertices.begin() + begin*9, vertices.begin() + end*9, 0.0f);
+        }
+        fill(cell_inds.begin() + begin, cell_inds.begin() + end, -1);
+        dirty_tris.add(begin, end);
+    }
+    void move_tris(int from, int to, int n) { // moves n tris down the buffers, from tri from to tri to
+        if (indexed) {
+            copy(indices.begin() + from*3, indices.begin() + (from+n)*3, indices.begin() + to*3);
+        } else {
+            copy(vertices.begin() + from*9, vertices.begin() + (from+n)*9, vertices.begin() + to*9);
+            if (want_colors) {
+                copy(colors.begin() + from*9, colors.begin() + (from+n)*9, colors.begin() + to*9);
+            }
+            if (want_normals) {
+                copy(normals.begin() + from*9, normals.begin() + (from+n)*9, normals.begin() + to*9);
+            }
+        }
+        copy(cell_inds.begin() + from, cell_inds.begin() + from+n, cell_inds.begin() + to);
+        copy(tri_faces.begin() + from, tri_faces.begin() + from+n, tri_faces.begin() + to);
+    }
+    // packs all the tri slabs of this chunk's cells, in order, at the start of the buffers, trimming their spare capacity
+    void compact_tris(vector<CellToTris> &info) {
+        vector<pair<int,int>> slabs; // the start and cell of every tri slab
+        for (int i=0; i<int(info.size()); i++) {
+            if (info[i].live && info[i].chunk == id && info[i].tri_cap > 0) slabs.push_back(make_pair(info[i].tri_start, i));
+        }
+        sort(slabs.begin(), slabs.end());
+        int at = 0;
+        for (auto &slab : slabs) { // slabs only move down, and never past the next slab's old start
+            CellToTris &c2t = info[slab.second];
+            int used = c2t.tri_used;
+            if (c2t.tri_start != at) {
+                move_tris(c2t.tri_start, at, used);
+            }
+            c2t.tri_start = at;
+            c2t.tri_cap = min(c2t.tri_cap, SlabAllocator::capacity_for(used));
+            at += c2t.tri_cap;
+            zero_tris(c2t.tri_start + used, at);
+        }
+        zero_tris(at, tri_slabs.end);
+        dirty_tris.add(0, at);
+        tri_slabs.reset(at);
+        tri_count = at;
+        refit_bounds();
+    }
+    
+    // indexed mode: like reserve_tris, for the cell's vertex slab
+    bool reserve_verts(vector<CellToTris> &info, CellToTris &c2t, int n) {
+        if (SlabAllocator::fits(n, c2t.vert_cap)) return false;
+        release_verts(c2t);
+        if (vert_slabs.fragmented()) {
+            compact_verts(info);
+        }
+        c2t.vert_start = vert_slabs.alloc(n, c2t.vert_cap);
+        if (vert_slabs.end > max_verts) {
+            while (max_verts < vert_slabs.end) max_verts = max(max_verts*2, 16);
+            resize_buffers();
+        }
+        vert_count = vert_slabs.end;
+        return true;
+    }
+    void release_verts(CellToTris &c2t) {
+        fill(vert_cell_inds.begin() + c2t.vert_start, vert_cell_inds.begin() + c2t.vert_start + c2t.vert_used, -1);
+        vert_slabs.use(-c2t.vert_used);
+        vert_slabs.release(c2t.vert_start, c2t.vert_cap);
+        c2t.vert_start = c2t.vert_cap = c2t.vert_used = 0;
+        vert_count = vert_slabs.end;
+    }
+    // indexed mode: packs all the vertex slabs of this chunk's cells at the start of the buffers, and re-points the indices of the moved vertices
+    void compact_verts(vector<CellToTris> &info) {
+        vector<pair<int,int>> slabs; // the start and cell of every vertex slab
+        for (int i=0; i<int(info.size()); i++) {
+            if (info[i].live && info[i].chunk == id && info[i].vert_cap > 0) slabs.push_back(make_pair(info[i].vert_start, i));
+        }
+        sort(slabs.begin(), slabs.end());
+        int at = 0;
+        for (auto &slab : slabs) {
+            CellToTris &c2t = info[slab.second];
+            int used = c2t.vert_used, shift = c2t.vert_start - at;
+            if (shift) {
+                copy(vertices.begin() + c2t.vert_start*3, vertices.begin() + (c2t.vert_start+used)*3, vertices.begin() + at*3);
+                if (want_colors) {
+                    copy(colors.begin() + c2t.vert_start*3, colors.begin() + (c2t.vert_start+used)*3, colors.begin() + at*3);
+                }
+                if (want_normals) {
+                    copy(normals.begin() + c2t.vert_start*3, normals.begin() + (c2t.vert_start+used)*3, normals.begin() + at*3);
+                }
+                copy(vert_cell_inds.begin() + c2t.vert_start, vert_cell_inds.begin() + c2t.vert_start+used, vert_cell_inds.begin() + at);
+                for (int &vi : c2t.vert_inds) {
+                    if (vi >= 0) vi -= shift;
+                }
+                for (int ii=c2t.tri_start*3; ii<(c2t.tri_start+c2t.tri_used)*3; ii++) {
+                    indices[ii] -= shift;
+                }
+                dirty_tris.add(c2t.tri_start, c2t.tri_start+c2t.tri_used);
+            }
+            c2t.vert_start = at;
+            c2t.vert_cap = min(c2t.vert_cap, SlabAllocator::capacity_for(used));
+            at += c2t.vert_cap;
+            fill(vert_cell_inds.begin() + c2t.vert_start + used, vert_cell_inds.begin() + at, -1);
+        }
+        fill(vert_cell_inds.begin() + at, vert_cell_inds.begin() + vert_slabs.end, -1);
+        dirty_verts.add(0, at);
+        vert_slabs.reset(at);
+        vert_count = at;
+        refit_bounds();
+    }
+    
+    // writes the tri with cache vertices vs into slot tri; in indexed mode the cell's vertex slab must be filled in already
+    inline void write_tri(int tri, const PoolRange<double> &input_v, int* vs, int cell, CellToTris &c2t, int f, const glm::vec3 &color) {
+        if (indexed) {
+            uint32_t *ix = &indices[0] + tri*3;
+            for (int vii=0; vii<3; vii++) {
+                ix[vii] = c2t.vert_inds[vs[vii]];
+            }
+        } else {
+            float *v = &vertices[0] + tri*9;
+            for (int vii=0; vii<3; vii++) {
+                int ibase = vs[vii]*3;
+                for (int ii=0; ii<3; ii++) {
+                    *v = input_v[ibase+ii];
+                    v++;
+                }
+                grow_bounds(v-3);
+            }
+        }
+        if (want_colors && !indexed) {
+            assert(vertices.size() == colors.size());
+            float *c = &colors[0] + tri*9;
+            for (int vii=0; vii<3; vii++) {
+                for (int ii=0; ii<3; ii++) {
+                    *c = color[ii];
+                    c++;
+                }
+            }
+        }
+        if (want_normals && !indexed) {
+            assert(vertices.size() == normals.size());
+            float *n = &normals[0] + tri*9;
+            for (int vii=0; vii<3; vii++) {
+                for (int ii=0; ii<3; ii++) {
+                    *n = c2t.cache.face_normals[f*3+ii];
+                    n++;
+                }
             }
         }
+        cell_inds[tri] = cell;
+        tri_faces[tri] = f;
+        dirty_tris.add(tri);
+    }
+    
+    // indexed mode: writes vertex vi of a cell's cache into slot c2t.vert_inds[vi]
+    inline void write_vert(const PoolRange<double> &input_v, int vi, int cell, CellToTris &c2t, const glm::vec3 &color) {
+        int slot = c2t.vert_inds[vi];
+        for (int ii=0; ii<3; ii++) {
+            vertices[slot*3+ii] = input_v[vi*3+ii];
+        }
+        grow_bounds(&vertices[slot*3]);
+        if (want_colors) {
+            assert(vertices.size() == colors.size());
+            for (int ii=0; ii<3; ii++) {
+                colors[slot*3+ii] = color[ii];
+            }
+        }
+        vert_cell_inds[slot] = cell;
+        dirty_verts.add(slot);
+    }
+    
+    // indexed mode: sets the normals of the cell's vertices from the faces its tris cover; the tris must be written already
+    void write_vert_normals(CellToTris &c2t) {
+        const CellCache &c = c2t.cache;
+        fill(normals.begin() + c2t.vert_start*3, normals.begin() + (c2t.vert_start+c2t.vert_used)*3, 0.0f);
+        int last_face = -1;
+        for (int tri = c2t.tri_start; tri < c2t.tri_start+c2t.tri_used; tri++) {
+            int f = tri_faces[tri];
+            if (f == last_face) continue; // each face's fan of tris is written together
+            last_face = f;
+            int i = c.face_starts[f];
+            for (int j = i+1; j < i+c.faces[i]+1; j++) {
+                int slot = c2t.vert_inds[c.faces[j]];
+                for (int ii=0; ii<3; ii++) {
+                    normals[slot*3+ii] += c.face_normals[f*3+ii]*c.face_areas[f];
+                }
+            }
+        }
+        for (int slot = c2t.vert_start; slot < c2t.vert_start+c2t.vert_used; slot++) {
+            float *n = &normals[slot*3];
+            float len = sqrt(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+            if (len > 0) {
+                n[0] /= len; n[1] /= len; n[2] /= len;
+            }
+        }
+        dirty_verts.add(c2t.vert_start, c2t.vert_start+c2t.vert_used);
+    }
+};
+
+// Holds the triangles of all non-empty cells, ready to upload as GL buffers, split into chunks by a coarse grid over the domain.
+// Each cell's tris go in the chunk its site lies in, so a renderer can cull chunks by their bounds, and an edit only dirties
+// the chunks of the cells it rebuilds. With the default 1x1x1 grid, chunk 0 holds everything.
+struct GLBufferManager {
+    vector<float> wire_vertices, cell_sites, cell_site_sizes;
+    vector<GLChunk> chunks;
+    int chunk_dims[3]; // the chunk grid, set by set_chunk_grid; takes effect on the next init
+    glm::vec3 chunk_min, chunk_size; // the corner of the chunk grid, and the size of one chunk
+    bool want_colors;
+    bool want_normals;
+    bool indexed;
+    int max_sites;
+    int wire_vert_count, wire_max_verts;
+    voro::voronoicell_neighbor vorocell; // reused temp var, holds computed cell info
+    ComputedCell computed; // reused temp var, holds vorocell's info on its way into the cache pools
+    
+    vector<CellToTris> info;
+    
+    // pools holding the cells' caches, with a slab per cell in each; cache_vert_inds shares the vertex slabs, and the per-face pools share the neighbor slabs
+    vector<int> cache_faces, cache_neighbors, cache_vert_inds, cache_face_starts;
+    vector<double> cache_vertices, cache_face_areas, cache_face_normals;
+    SlabAllocator cache_face_slabs, cache_vertex_slabs, cache_neighbor_slabs;
+    
+    // changes since the last gl_clear_dirty(), besides the chunks' own:
+    DirtyRanges dirty_sites; // cell indices; covers cell_sites and cell_site_sizes
+    DirtyRanges dirty_wires; // wire vertex indices; covers wire_vertices
+    vector<int> dirty_packed; // scratch for pack_dirty() and friends
+    
+    GLBufferManager() : chunks(1), chunk_min(0), chunk_size(1), want_colors(false), want_normals(false), indexed(false), max_sites(0), wire_vert_count(0), wire_max_verts(0) {
+        chunk_dims[0] = chunk_dims[1] = chunk_dims[2] = 1;
+    }
+    
+    explicit operator bool() { return !info.empty(); }
+    
+    bool sanity(string when, bool doassert=true) {
+        bool valid = true;
+        for (auto &ch : chunks) {
+            valid = ch.sanity(info) && valid;
+        }
+        int used_cache = 0;
+        for (auto &c : info) {
+            used_cache += int(c.cache.faces.size() + c.cache.vertices.size()/3 + c.cache.neighbors.size());
+        }
+        if (used_cache != cache_face_slabs.used_total + cache_vertex_slabs.used_total + cache_neighbor_slabs.used_total) {
+            valid = false;
+            cout << "cache pool use is off" << endl;
+        }
         for (int i=0; i<info.size(); i++) {
-            if (info[i]) {
-                for (int ti : info[i]->tri_inds) {
-                    if (cell_inds[ti] != i) {
+            if (info[i].live) {
+                if (info[i].chunk < 0 || info[i].chunk >= int(chunks.size())) {
+                    valid = false;
+                    cout << "cell " << i << " is in a bad chunk " << info[i].chunk << endl;
+                    continue;
+                }
+                GLChunk &ch = chunks[info[i].chunk];
+                if (info[i].tri_used > info[i].tri_cap || info[i].tri_start + info[i].tri_cap > ch.tri_count) {
+                    valid = false;
+                    cout << "cell " << i << " has a bad tri slab" << endl;
+                    continue;
+                }
+                for (int ti=info[i].tri_start; ti<info[i].tri_start+info[i].tri_used; ti++) {
+                    if (ch.cell_inds[ti] != i) {
                         valid = false;
-                        cout << "invalid backlink " << cell_inds[ti] << " vs " << i << endl;
+                        cout << "invalid backlink " << ch.cell_inds[ti] << " vs " << i << endl;
+                    }
+                    for (int k=0; indexed && k<3; k++) {
+                        uint32_t vi = ch.indices[ti*3+k];
+                        if (vi >= uint32_t(ch.vert_count) || ch.vert_cell_inds[vi] != i) {
+                            valid = false;
+                            cout << "tri " << ti << " of cell " << i << " references invalid vertex " << vi << endl;
+                        }
+                    }
+                }
+                for (int vi : info[i].vert_inds) {
+                    if (vi >= 0 && (vi < info[i].vert_start || vi >= info[i].vert_start+info[i].vert_used || ch.vert_cell_inds[vi] != i)) {
+                        valid = false;
+                        cout << "invalid vertex backlink " << ch.vert_cell_inds[vi] << " vs " << i << endl;
+                    }
+                }
+                const CellCache &cache = info[i].cache;
+                int face_count = 0;
+                for (int fi = 0; fi < (int)cache.faces.size(); fi += cache.faces[fi]+1, face_count++) {
+                    if (face_count >= (int)cache.face_starts.size() || cache.face_starts[face_count] != fi) {
+                        valid = false;
+                        cout << "face " << face_count << " of cell " << i << " has a bad face start" << endl;
+                        break;
                     }
                 }
-                for (size_t nii=0; nii<info[i]->cache.neighbors.size(); nii++) {//(int ni : info[i]->cache.neighbors) {
-                    int ni = info[i]->cache.neighbors[nii];
+                if (face_count != (int)cache.neighbors.size() || face_count != (int)cache.face_areas.size() || face_count*3 != (int)cache.face_normals.size()) {
+                    valid = false;
+                    cout << "cell " << i << " has " << face_count << " faces but per-face info for " << cache.neighbors.size() << endl;
+                }
+                for (size_t nii=0; nii<info[i].cache.neighbors.size(); nii++) {//(int ni : info[i].cache.neighbors) {
+                    int ni = info[i].cache.neighbors[nii];
                     if (ni >= int(info.size())) {
                         valid = false;
                         cout << "neighbor index is out of bounds: " << i << ": " << ni << " vs " << info.size() << endl;
                     }
-                    if (ni >= 0 && ni < int(info.size()) && info[ni]) {
+                    if (ni >= 0 && ni < int(info.size()) && info[ni].live) {
                         bool backlink = false;
-                        for (int nni : info[ni]->cache.neighbors) {
+                        for (int nni : info[ni].cache.neighbors) {
                             if (nni == i) {
                                 backlink = true;
                             }
                         }
                         if (!backlink) {
                             cout << "neighbor " << i << " -> " << ni << " lacks backlink" << endl;
-                            double face_area = info[i]->cache.face_size(nii);
+                            double face_area = info[i].cache.face_size(nii);
                             if (face_area < 4.84704e-14) {
                                 cout << "backlink error on face so small (" << face_area  << ") so maybe we don't care?" << endl;
                             } else {
@@ -197,167 +817,256 @@ struct GLBufferManager {
                 }
             }
         }
-        
+    
         if (!valid) {
             cout << "invalid " << when << endl;
         }
-        
+    
         assert(!doassert || valid);
-        
+    
         return valid;
     }
     
-    void resize_buffers() {
-        vertices.resize(max_tris*9);
-        cell_inds.resize(max_tris);
-        cell_internal_inds.resize(max_tris);
-        if (want_colors) {
-            colors.resize(vertices.size());
-        }
-    }
     void resize_wire_buffers() {
         wire_vertices.resize(wire_max_verts*3);
+        dirty_wires.clear();
+        dirty_wires.add(0, wire_max_verts);
     }
     void resize_sites_buffers() {
         cell_sites.resize(max_sites*3);
         cell_site_sizes.resize(max_sites);
+        dirty_sites.clear();
+        dirty_sites.add(0, max_sites);
+    }
+    void mark_all_tris_dirty() {
+        for (auto &ch : chunks) {
+            ch.mark_all_tris_dirty();
+        }
+    }
+    
+    // coalesces the dirty ranges and packs them as
+    // [#tri ranges, #vert ranges, #site ranges, #wire ranges, tri begin0, tri end0, ..., vert ranges..., site ranges..., wire ranges...],
+    // where the tri and vert ranges are chunk 0's
+    uintptr_t pack_dirty() {
+        DirtyRanges *all[4] = {&chunks[0].dirty_tris, &chunks[0].dirty_verts, &dirty_sites, &dirty_wires};
+        dirty_packed.clear();
+        for (auto *d : all) {
+            d->coalesce();
+            dirty_packed.push_back(int(d->ranges.size()/2));
+        }
+        for (auto *d : all) {
+            dirty_packed.insert(dirty_packed.end(), d->ranges.begin(), d->ranges.end());
+        }
+        return reinterpret_cast<uintptr_t>(&dirty_packed[0]);
+    }
+    // like pack_dirty, for one chunk's buffers: [#tri ranges, #vert ranges, tri ranges..., vert ranges...]
+    uintptr_t pack_chunk_dirty(int chunk) {
+        GLChunk &ch = chunks[chunk];
+        DirtyRanges *all[2] = {&ch.dirty_tris, &ch.dirty_verts};
+        dirty_packed.clear();
+        for (auto *d : all) {
+            d->coalesce();
+            dirty_packed.push_back(int(d->ranges.size()/2));
+        }
+        for (auto *d : all) {
+            dirty_packed.insert(dirty_packed.end(), d->ranges.begin(), d->ranges.end());
+        }
+        return reinterpret_cast<uintptr_t>(&dirty_packed[0]);
+    }
+    // packs the chunks with dirty tris or vertices as [#chunks, chunk0, chunk1, ...]
+    uintptr_t pack_dirty_chunks() {
+        dirty_packed.assign(1, 0);
+        for (auto &ch : chunks) {
+            if (ch.is_dirty()) {
+                dirty_packed.push_back(ch.id);
+                dirty_packed[0]++;
+            }
+        }
+        return reinterpret_cast<uintptr_t>(&dirty_packed[0]);
+    }
+    void clear_dirty() {
+        for (auto &ch : chunks) {
+            ch.dirty_tris.clear();
+            ch.dirty_verts.clear();
+        }
+        dirty_sites.clear();
+        dirty_wires.clear();
     }
     void set_want_colors(Voro &src, bool yes_colors); // call to change whether you want colors
     void update_colors(Voro &src); // call whenever the palette changes to fix all existing colors
+    void set_want_normals(bool yes_normals); // call to change whether you want normals
+    
+    // splits the box [lo, hi] into an nx by ny by nz grid of chunks, from the next init on; sites outside the box go in the nearest chunk
+    void set_chunk_grid(const glm::vec3 &lo, const glm::vec3 &hi, int nx, int ny, int nz) {
+        chunk_dims[0] = max(nx, 1);
+        chunk_dims[1] = max(ny, 1);
+        chunk_dims[2] = max(nz, 1);
+        chunk_min = lo;
+        chunk_size = (hi-lo)/glm::vec3(chunk_dims[0], chunk_dims[1], chunk_dims[2]);
+    }
+    int chunk_at(const glm::vec3 &pos) {
+        int ijk[3];
+        for (int k=0; k<3; k++) {
+            ijk[k] = chunk_size[k] > 0 ? int(floor((pos[k]-chunk_min[k])/chunk_size[k])) : 0;
+            ijk[k] = min(max(ijk[k], 0), chunk_dims[k]-1);
+        }
+        return ijk[0] + chunk_dims[0]*(ijk[1] + chunk_dims[1]*ijk[2]);
+    }
     
-    void init(int numCells, int triCapacity, int wiresCapacity, int sitesCapacity, bool want_colors) {
+    void init(int numCells, int triCapacity, int wiresCapacity, int sitesCapacity, bool want_colors, bool want_normals, bool indexed) {
         clear();
-        
+    
         this->want_colors = want_colors;
-        max_tris = triCapacity;
+        this->want_normals = want_normals;
+        this->indexed = indexed;
+        int chunk_count = chunk_dims[0]*chunk_dims[1]*chunk_dims[2];
+        chunks.assign(chunk_count, GLChunk());
+        for (int i=0; i<chunk_count; i++) {
+            GLChunk &ch = chunks[i];
+            ch.id = i;
+            ch.want_colors = want_colors;
+            ch.want_normals = want_normals;
+            ch.indexed = indexed;
+            ch.max_tris = chunk_count > 1 ? max(triCapacity/chunk_count, 16) : triCapacity;
+            ch.max_verts = indexed ? ch.max_tris : 0; // cells share about 2 tris per vertex, but partly drawn cells still add all their vertices
+            ch.tri_slabs.min_waste = ch.vert_slabs.min_waste = max(MIN_COMPACT_ELEMENTS/chunk_count, 16); // so small chunks still compact
+            ch.resize_buffers();
+        }
         wire_max_verts = wiresCapacity;
         max_sites = numCells*2;
         if (max_sites < sitesCapacity) max_sites = sitesCapacity;
-        
-        resize_buffers();
+    
         resize_wire_buffers();
         resize_sites_buffers();
-        tri_count = 0;
         wire_vert_count = 0;
-        
-        info.resize(numCells, 0);
+    
+        info.resize(numCells);
     }
     
     void add_cell(Voro &src);
     
-    int vert2cell(int vi) {
-        if (vi < 0 || vi >= tri_count*3)
-            return -1;
-        return cell_inds[vi/3];
+    // vi indexes the drawn vertex stream of the chunk: its vertices array in soup mode, or its indices array in indexed mode
+    int vert2cell(int chunk, int vi) {
+        if (chunk < 0 || chunk >= int(chunks.size())) return -1;
+        return chunks[chunk].vert2cell(vi);
     }
-    int vert2cell_neighbor(int vi) {
-        if (vi < 0 || vi >= tri_count*3) return -1;
-        int tri = vi / 3;
-        int cell = cell_inds[tri];
-        CellToTris *in = info[cell];
-        if (!in) return -1;
-        int fi = in->tri_faces[cell_internal_inds[tri]];
-        return in->cache.neighbors[fi];
+    int vert2cell_neighbor(int chunk, int vi) {
+        int cell = vert2cell(chunk, vi);
+        if (cell < 0) return -1;
+        if (!info[cell].live) return -1;
+        return info[cell].cache.neighbors[chunks[chunk].tri_faces[vi/3]];
     }
     
     inline void clear_cell_tris(CellToTris &c2t) {
-        for (int tri : c2t.tri_inds) {
-            swapnpop_tri(tri);
-        }
-        c2t.tri_inds.clear();
-        c2t.tri_faces.clear();
+        GLChunk &ch = chunks[c2t.chunk];
+        ch.release_tris(c2t);
+        ch.release_verts(c2t);
+        c2t.vert_inds = PoolRange<int>();
     }
     inline void clear_cell_cache(CellToTris &c2t) {
-        c2t.cache.clear();
+        CellCache &c = c2t.cache;
+        release_from_pool(cache_face_slabs, 1, c.faces, c.face_cap);
+        release_from_pool(cache_vertex_slabs, 3, c.vertices, c.vert_cap);
+        release_from_pool(cache_neighbor_slabs, 1, c.neighbors, c.neighbor_cap);
+        c.face_starts = PoolRange<int>();
+        c.face_areas = PoolRange<double>();
+        c.face_normals = PoolRange<double>();
+        c2t.vert_inds = PoolRange<int>();
     }
     inline void clear_cell_all(CellToTris &c2t) {
         clear_cell_tris(c2t);
         clear_cell_cache(c2t);
     }
     
+    // the cell's slabs are kept, for create_cache and add_cell_tris to rewrite in place
     inline CellToTris& get_clean_cell(int cell) {
-        if (!info[cell]) {
-            info[cell] = new CellToTris();
-        } else {
-            clear_cell_all(*info[cell]);
+        info[cell].live = true;
+        return info[cell];
+    }
+    
+    // points range at n elements of pool (counted in units of per elements), in the slab it already has if they still fit
+    template<typename T>
+    void reserve_in_pool(vector<T> &pool, SlabAllocator &slabs, int per, int n, PoolRange<T> &range, int &cap) {
+        if (!SlabAllocator::fits(n, cap)) {
+            slabs.release(range.start/per, cap);
+            range.start = slabs.alloc(n, cap)*per;
+            if (slabs.end*per > int(pool.size())) {
+                pool.resize(max(slabs.end*per, int(pool.size())*2));
+            }
+        }
+        slabs.use(n - int(range.size())/per);
+        range.pool = &pool;
+        range.len = n*per;
+    }
+    template<typename T>
+    void release_from_pool(SlabAllocator &slabs, int per, PoolRange<T> &range, int &cap) {
+        slabs.use(-int(range.size())/per);
+        slabs.release(range.start/per, cap);
+        range = PoolRange<T>();
+        cap = 0;
+    }
+    template<typename T>
+    void fill_pool(vector<T> &pool, SlabAllocator &slabs, int per, const vector<T> &from, PoolRange<T> &range, int &cap) {
+        reserve_in_pool(pool, slabs, per, int(from.size())/per, range, cap);
+        copy(from.begin(), from.end(), pool.begin() + range.start);
+    }
+    
+    // fills the cell's cache from a voro++ computed cell
+    void create_cache(CellToTris &c2t, const ComputedCell &c) {
+        CellCache &cache = c2t.cache;
+        fill_pool(cache_neighbors, cache_neighbor_slabs, 1, c.neighbors, cache.neighbors, cache.neighbor_cap);
+        fill_pool(cache_faces, cache_face_slabs, 1, c.faces, cache.faces, cache.face_cap);
+        fill_pool(cache_vertices, cache_vertex_slabs, 3, c.vertices, cache.vertices, cache.vert_cap);
+        if (indexed && cache_vert_inds.size() < cache_vertices.size()/3) {
+            cache_vert_inds.resize(cache_vertices.size()/3);
+        }
+        c2t.vert_inds = PoolRange<int>();
+        if (cache_face_starts.size() < cache_neighbors.size()) {
+            cache_face_starts.resize(cache_neighbors.size());
+            cache_face_areas.resize(cache_neighbors.size());
+            cache_face_normals.resize(cache_neighbors.size()*3);
         }
-        return *info[cell];
+        int nf = cache.neighbors.size();
+        cache.face_starts = PoolRange<int>(cache_face_starts, cache.neighbors.start, nf);
+        cache.face_areas = PoolRange<double>(cache_face_areas, cache.neighbors.start, nf);
+        cache.face_normals = PoolRange<double>(cache_face_normals, cache.neighbors.start*3, nf*3);
+        cache.index_faces();
     }
     
     void recompute_neighbors(Voro &src, int cell);
     
     CellCache *get_cache(int cell) {
-        if (cell < 0 || cell >= info.size() || !info[cell]) {
+        if (cell < 0 || cell >= info.size() || !info[cell].live) {
             return 0;
         }
-        return &info[cell]->cache;
+        return &info[cell].cache;
     }
     
+    void set_cell(Voro &src, int cell, int oldtype);
     
-    inline bool add_tri(const vector<double> &input_v, int* vs, int cell, CellToTris &c2t, int f, const glm::vec3 &color) {
-        if (tri_count+1 >= max_tris) {
-            max_tris *= 2;
-            resize_buffers();
+    // type batches: set_cell's work, deferred so each affected cell is rebuilt once
+    vector<int> type_changed; // cells whose type changed since the batch began, in order and without repeats; their neighbors are added when flushing
+    vector<char> type_change_marks; // by cell, whether it's in type_changed
+    void defer_set_cell(int cell) {
+        if (type_change_marks.size() < info.size()) {
+            type_change_marks.resize(info.size(), 0);
         }
-        
-        float *v = &vertices[0] + tri_count*9;
-        for (int vii=0; vii<3; vii++) {
-            int ibase = vs[vii]*3;
-            for (int ii=0; ii<3; ii++) {
-                *v = input_v[ibase+ii];
-                v++;
-            }
-        }
-        if (want_colors) {
-            assert(vertices.size() == colors.size());
-            float *c = &colors[0] + tri_count*9;
-            for (int vii=0; vii<3; vii++) {
-                int ibase = vs[vii]*3;
-                for (int ii=0; ii<3; ii++) {
-                    *c = color[ii];
-                    c++;
-                }
-            }
+        if (!type_change_marks[cell]) {
+            type_change_marks[cell] = 1;
+            type_changed.push_back(cell);
         }
-        cell_inds[tri_count] = cell;
-        cell_internal_inds[tri_count] = (short)c2t.tri_inds.size();
-        c2t.tri_inds.push_back(tri_count);
-        c2t.tri_faces.push_back(f);
-
-        
-        tri_count++;
-        
-        return true;
     }
-    
-    void set_cell(Voro &src, int cell, int oldtype);
+    void flush_type_changes(Voro &src);
     
     void compute_cell(Voro &src, int cell); // compute caches for all cells and add tris for non-zero cells
-
-    void compute_all(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors);
-    void compute_on(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors);
+    void place_cell(Voro &src, int cell, const ComputedCell &computed); // the part of compute_cell after voro++ is done
+    void compute_cells(Voro &src, const vector<int> &cells, bool and_neighbors = false); // compute_cell for many cells, with voro++ on several threads if we can
+    void gather_neighbors(const vector<int> &cells, vector<int> &around);
+    
+    void compute_all(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors, bool want_normals, bool indexed);
+    void compute_on(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors, bool want_normals, bool indexed);
     
     void add_cell_tris(Voro &src, int cell, CellToTris &c2t);
-   
-    void swapnpop_tri(int tri) {
-        if (tri+1 != tri_count) {
-            int ts = tri_count-1;
-            assert(ts > 0);
-            for (int ii=0; ii<9; ii++) {
-                vertices[tri*9+ii] = vertices[ts*9+ii];
-            }
-            if (want_colors) {
-                assert(vertices.size() == colors.size());
-                for (int ii=0; ii<9; ii++) {
-                    colors[tri*9+ii] = colors[ts*9+ii];
-                }
-            }
-            cell_inds[tri] = cell_inds[ts];
-            cell_internal_inds[tri] = cell_internal_inds[ts];
-            info[cell_inds[tri]]->tri_inds[cell_internal_inds[tri]] = tri;
-        }
-        tri_count--;
-    }
     
     void ensure_computed(Voro &src, int cell); // if src is ready to compute things, ensures that the cell is computed
     
@@ -371,24 +1080,26 @@ struct GLBufferManager {
         cell_sites[cell*3]   = pos.x;
         cell_sites[cell*3+1] = pos.y;
         cell_sites[cell*3+2] = pos.z;
-
+        dirty_sites.add(cell);
     }
     inline void update_site_size(float size, int cell) {
         cell_site_sizes[cell] = size;
+        dirty_sites.add(cell);
     }
     
     void add_wires(Voro &src, int cell);
-    inline void add_wire_vert(const vector<double> &vertices, int vi) {
+    inline void add_wire_vert(const PoolRange<double> &vertices, int vi) {
         assert(vi*3+2 < vertices.size());
         if (wire_vert_count >= wire_max_verts) {
             wire_max_verts *= 2;
             resize_wire_buffers();
         }
         float *buf = &wire_vertices[0] + (wire_vert_count*3);
-
+    
         *buf = vertices[vi*3]; buf++;
         *buf = vertices[vi*3+1]; buf++;
         *buf = vertices[vi*3+2]; buf++;
+        dirty_wires.add(wire_vert_count);
         wire_vert_count++;
     }
     void clear_wires() {
@@ -396,20 +1107,25 @@ struct GLBufferManager {
     }
     
     void clear() {
-        vertices.clear();
-        //normals.clear();
-        cell_inds.clear();
+        chunks.assign(1, GLChunk());
         wire_vertices.clear();
         cell_sites.clear();
         cell_site_sizes.clear();
-        colors.clear();
         
-        tri_count = max_tris = max_sites = 0;
+        max_sites = 0;
+        clear_dirty();
         
-        for (auto *c : info) {
-            delete c;
-        }
         info.clear();
+        cache_faces.clear();
+        cache_neighbors.clear();
+        cache_vert_inds.clear();
+        cache_face_starts.clear();
+        cache_vertices.clear();
+        cache_face_areas.clear();
+        cache_face_normals.clear();
+        cache_face_slabs = SlabAllocator();
+        cache_vertex_slabs = SlabAllocator();
+        cache_neighbor_slabs = SlabAllocator();
     }
 };
 
@@ -417,9 +1133,13 @@ enum { SANITY_MINIMAL, SANITY_FULL, SANITY_EXCESSIVE };
 
 struct Voro {
     Voro()
-        : b_min(glm::vec3(-10)), b_max(glm::vec3(10)), con(0), sanity_level(SANITY_FULL), tracked_ids(0) {}
+        : b_min(glm::vec3(-10)), b_max(glm::vec3(10)), con(0), sanity_level(SANITY_FULL), gl_indexed(false), gl_want_normals(false), type_batch_depth(0), tracked_ids(0) {
+        gl_chunk_dims[0] = gl_chunk_dims[1] = gl_chunk_dims[2] = 1;
+    }
     Voro(glm::vec3 bound_min, glm::vec3 bound_max)
-        : b_min(bound_min), b_max(bound_max), con(0), sanity_level(SANITY_FULL), tracked_ids(0) {}
+        : b_min(bound_min), b_max(bound_max), con(0), sanity_level(SANITY_FULL), gl_indexed(false), gl_want_normals(false), type_batch_depth(0), tracked_ids(0) {
+        gl_chunk_dims[0] = gl_chunk_dims[1] = gl_chunk_dims[2] = 1;
+    }
     ~Voro() {
         clear_all();
     }
@@ -461,14 +1181,14 @@ struct Voro {
                     valid = false;
                 }
                 for (int i=0; i<cells.size(); i++) {
-                    CellCache cache;
-                    if (gl_computed.info[i]) {
+                    vector<int> neighbors;
+                    if (gl_computed.info[i].live) {
                         auto &link = links[i];
                         if (link.valid()) {
                             if (con->compute_cell(gl_computed.vorocell, link.ijk, link.q)) {
-                                cache.create(cells[i].pos, gl_computed.vorocell);
-                                auto &vs = gl_computed.info[i]->cache;
-                                valid = compare_vecs(vs.neighbors, cache.neighbors, "neighbors", i) && valid;
+                                gl_computed.vorocell.neighbors(neighbors);
+                                auto &vs = gl_computed.info[i].cache;
+                                valid = compare_vecs(vs.neighbors.to_vector(), neighbors, "neighbors", i) && valid;
 //                                bool fvalid = compare_vecs(vs.faces, cache.faces, "faces", i);
 //                                valid = fvalid && valid;
 //                                valid = compare_vecs(vs.vertices, cache.vertices, "vertices", i) && valid;
@@ -500,15 +1220,16 @@ struct Voro {
                     // build links
                     voro::c_loop_all vl(dcon);
                     voro::voronoicell_neighbor vorocell;
-                    CellCache cache;
+                    vector<int> neighbors, faces;
                     if(vl.start()) do {
                         int i = vl.pid();
                         if (dcon.compute_cell(vorocell, vl.ijk, vl.q)) {
-                            cache.create(cells[i].pos, vorocell);
-                            if (gl_computed.info[i]) {
-                                auto &vs = gl_computed.info[i]->cache;
-                                bool nvalid = compare_vecs(vs.neighbors, cache.neighbors, " full-recon neighbors", i);
-                                bool fvalid = compare_vecs(vs.faces, cache.faces, " full-recon faces", i);
+                            vorocell.neighbors(neighbors);
+                            vorocell.face_vertices(faces);
+                            if (gl_computed.info[i].live) {
+                                auto &vs = gl_computed.info[i].cache;
+                                bool nvalid = compare_vecs(vs.neighbors.to_vector(), neighbors, " full-recon neighbors", i);
+                                bool fvalid = compare_vecs(vs.faces.to_vector(), faces, " full-recon faces", i);
                                 valid = valid && nvalid && fvalid;
                                 if (!nvalid || !fvalid) {
                                     cout << "cell[" << i << "].pos = " << cells[i].pos.x << ", " << cells[i].pos.y << ", " << cells[i].pos.z << endl;
@@ -555,6 +1276,7 @@ struct Voro {
     
     void set_only_centermost(int centermost_type, int other_type) {
         if (cells.empty()) return;
+        begin_type_batch();
         int minc = 0;
         double minl = glm::length2(cells[0].pos);
         set_cell(0, other_type);
@@ -567,12 +1289,15 @@ struct Voro {
             set_cell(i, other_type);
         }
         set_cell(minc, centermost_type);
+        end_type_batch();
     }
     
     void set_all(int type) {
+        begin_type_batch();
         for (size_t i=0; i<cells.size(); i++) {
             set_cell(i, type);
         }
+        end_type_batch();
     }
     
     void set_fill(double target_fill, int rand_seed) {
@@ -588,6 +1313,7 @@ struct Voro {
         float newfill = fill;
         const float one_cell_fill = (1.0/float(cells.size()));
         int needs_more_fill = fill < target_fill;
+        begin_type_batch();
         while (needs_more_fill == (newfill < target_fill)) {
             int ci = rand() % cells.size();
             if ((!cells[ci].type) == needs_more_fill) {
@@ -595,6 +1321,7 @@ struct Voro {
                 newfill = newfill + (2*needs_more_fill-1)*one_cell_fill;
             }
         }
+        end_type_batch();
     }
     
     float get_fill() {
@@ -781,11 +1508,98 @@ struct Voro {
     
     void gl_build(int max_tris_guess, int max_wire_verts_guess, int max_sites_guess) {
         // populate gl_computed with current whole voronoi diagram
-        gl_computed.compute_on(*this, max_tris_guess, max_wire_verts_guess, max_sites_guess, has_colors());
+        gl_computed.set_chunk_grid(b_min, b_max, gl_chunk_dims[0], gl_chunk_dims[1], gl_chunk_dims[2]);
+        gl_computed.compute_on(*this, max_tris_guess, max_wire_verts_guess, max_sites_guess, has_colors(), gl_want_normals, gl_indexed);
         
     }
+    // chooses between triangle soup and indexed gl buffers; takes effect on the next gl_build
+    void set_gl_indexed(bool yes) {
+        gl_indexed = yes;
+    }
+    bool gl_is_indexed() {
+        return gl_computed.indexed;
+    }
+    // splits the gl buffers into an nx by ny by nz grid of chunks over the bounds, which can be drawn, culled and uploaded separately;
+    // takes effect on the next gl_build. The default 1x1x1 grid puts everything in chunk 0, which the unchunked gl_* functions use
+    void set_gl_chunks(int nx, int ny, int nz) {
+        gl_chunk_dims[0] = max(nx, 1);
+        gl_chunk_dims[1] = max(ny, 1);
+        gl_chunk_dims[2] = max(nz, 1);
+    }
+    int gl_chunk_count() {
+        return int(gl_computed.chunks.size());
+    }
+    uintptr_t gl_chunk_vertices(int chunk) {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[chunk].vertices[0]);
+    }
+    uintptr_t gl_chunk_colors(int chunk) {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[chunk].colors[0]);
+    }
+    uintptr_t gl_chunk_normals(int chunk) {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[chunk].normals[0]);
+    }
+    uintptr_t gl_chunk_indices(int chunk) {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[chunk].indices[0]);
+    }
+    int gl_chunk_tri_count(int chunk) {
+        return gl_computed.chunks[chunk].tri_count;
+    }
+    int gl_chunk_max_tris(int chunk) {
+        return gl_computed.chunks[chunk].max_tris;
+    }
+    int gl_chunk_vert_count(int chunk) {
+        return gl_computed.chunks[chunk].vert_count;
+    }
+    int gl_chunk_max_verts(int chunk) {
+        return gl_computed.chunks[chunk].max_verts;
+    }
+    // returns a pointer to 6 floats: the min x, y, z then max x, y, z of the chunk's drawn vertices (min > max if it has none);
+    // may be a little loose until the chunk is next compacted, but always holds everything drawn
+    uintptr_t gl_chunk_bounds(int chunk) {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[chunk].bounds[0]);
+    }
+    // returns a pointer to the int32 list of chunks with changes since the last gl_clear_dirty(), packed as [#chunks, chunk0, chunk1, ...]
+    uintptr_t gl_dirty_chunks() {
+        return gl_computed.pack_dirty_chunks();
+    }
+    // like gl_dirty_ranges, for one chunk: [#tri ranges, #vert ranges, then [begin, end) pairs for each]; see gl_dirty_ranges for sites and wires
+    uintptr_t gl_chunk_dirty_ranges(int chunk) {
+        return gl_computed.pack_chunk_dirty(chunk);
+    }
+    // chooses whether the gl buffers include normals; takes effect right away
+    void set_gl_normals(bool yes) {
+        gl_want_normals = yes;
+        if (gl_computed) {
+            gl_computed.set_want_normals(yes);
+        }
+    }
+    bool has_normals() {
+        return gl_computed.want_normals;
+    }
+    uintptr_t gl_normals() {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[0].normals[0]);
+    }
     uintptr_t gl_vertices() {
-        return reinterpret_cast<uintptr_t>(&gl_computed.vertices[0]);
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[0].vertices[0]);
+    }
+    uintptr_t gl_indices() {
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[0].indices[0]);
+    }
+    int gl_vert_count() {
+        return gl_computed.chunks[0].vert_count;
+    }
+    int gl_max_verts() {
+        return gl_computed.chunks[0].max_verts;
+    }
+    // returns a pointer to the int32 ranges of the gl buffers that changed since the last gl_clear_dirty(),
+    // packed as [#tri ranges, #vert ranges, #site ranges, #wire ranges, then [begin, end) pairs for each in that order], with chunk 0's tris and vertices
+    // units are elements: tris (9 floats each in vertices/colors/normals, or 3 entries in indices), vertices (3 floats), sites and wire vertices;
+    // ranges that reach past the current counts just cover unused buffer space
+    uintptr_t gl_dirty_ranges() {
+        return gl_computed.pack_dirty();
+    }
+    void gl_clear_dirty() {
+        gl_computed.clear_dirty();
     }
     void gl_add_wires(int cell) {
         gl_computed.add_wires(*this, cell);
@@ -816,16 +1630,16 @@ struct Voro {
         return gl_computed.max_sites;
     }
     int gl_tri_count() {
-        return gl_computed.tri_count;
+        return gl_computed.chunks[0].tri_count;
     }
     int gl_max_tris() {
-        return gl_computed.max_tris;
+        return gl_computed.chunks[0].max_tris;
     }
     int cell_count() {
         return cells.size();
     }
     uintptr_t gl_colors() {
-        return reinterpret_cast<uintptr_t>(&gl_computed.colors[0]);
+        return reinterpret_cast<uintptr_t>(&gl_computed.chunks[0].colors[0]);
     }
     bool has_colors() {
         return !palette.empty();
@@ -849,7 +1663,13 @@ struct Voro {
         
         int oldtype = cells[cell].type;
         cells[cell].type = oldtype ? 0 : nonzero_type;
-        gl_computed.set_cell(*this, cell, oldtype);
+        if (cell < gl_computed.info.size()) {
+            if (type_batch_depth) {
+                gl_computed.defer_set_cell(cell);
+            } else {
+                gl_computed.set_cell(*this, cell, oldtype);
+            }
+        }
     }
     void set_cell(int cell, int type) {
         if (cell < 0 || cell >= cells.size() || type==cells[cell].type)
@@ -858,14 +1678,37 @@ struct Voro {
         int oldtype = cells[cell].type;
         cells[cell].type = type;
         if (cell < gl_computed.info.size()) {
-            gl_computed.set_cell(*this, cell, oldtype);
+            if (type_batch_depth) {
+                gl_computed.defer_set_cell(cell);
+            } else {
+                gl_computed.set_cell(*this, cell, oldtype);
+            }
+        }
+    }
+    // between these calls, set_cell and toggle_cell only change the cell types,
+    // and the outermost end_type_batch() rebuilds each affected cell's tris once.
+    // don't add, delete or move cells inside a batch.
+    void begin_type_batch() {
+        type_batch_depth++;
+    }
+    void end_type_batch() {
+        assert(type_batch_depth > 0);
+        if (--type_batch_depth == 0 && gl_computed) {
+            gl_computed.flush_type_changes(*this);
+            SANITY("after type batch");
         }
     }
     int cell_from_vertex(int vert_ind) {
-        return gl_computed.vert2cell(vert_ind);
+        return gl_computed.vert2cell(0, vert_ind);
     }
     int cell_neighbor_from_vertex(int vert_ind) {
-        return gl_computed.vert2cell_neighbor(vert_ind);
+        return gl_computed.vert2cell_neighbor(0, vert_ind);
+    }
+    int cell_from_chunk_vertex(int chunk, int vert_ind) {
+        return gl_computed.vert2cell(chunk, vert_ind);
+    }
+    int cell_neighbor_from_chunk_vertex(int chunk, int vert_ind) {
+        return gl_computed.vert2cell_neighbor(chunk, vert_ind);
     }
     glm::vec3 cell_pos(int cell) {
         assert(cell>=0 && cell<cells.size());
@@ -878,8 +1721,8 @@ struct Voro {
     bool cell_affects_shape(int cell) {
         assert(cell>=0 && cell<cells.size());
         auto cellType = cells[cell].type;
-        if (gl_computed.info[cell]) {
-            for (auto ni : gl_computed.info[cell]->cache.neighbors) {
+        if (gl_computed.info[cell].live) {
+            for (auto ni : gl_computed.info[cell].cache.neighbors) {
                 if (ni >= 0 && cells[ni].type != cellType) {
                     return true;
                 }
@@ -893,10 +1736,14 @@ struct Voro {
     }
     
     size_t stable_id(int cell) {
-        if (!cell_to_id.count(cell)) {
+        if (cell < 0 || cell >= int(cells.size())) {
+            return NO_STABLE_ID;
+        }
+        if (id_of(cell) == NO_STABLE_ID) {
             auto id = tracked_ids++;
+            id_to_cell.push_back(cell);
+            if (cell >= int(cell_to_id.size())) cell_to_id.resize(cell+1, NO_STABLE_ID);
             cell_to_id[cell] = id;
-            id_to_cell[id] = cell;
         }
         assert(id_to_cell[cell_to_id[cell]] == cell);
         return cell_to_id[cell];
@@ -906,15 +1753,16 @@ struct Voro {
     // id must be one that has already been used (< tracked_ids) so that it will not collide with new ids.
     void set_stable_id(int cell, size_t id) {
         // only allow setting id for cells that do not have an id yet
-        assert(!id_to_cell.count(id));
-        assert(!cell_to_id.count(cell));
         assert(id < tracked_ids);
+        assert(id_to_cell[id] < 0);
+        assert(id_of(cell) == NO_STABLE_ID);
         
         id_to_cell[id] = cell;
+        if (cell >= int(cell_to_id.size())) cell_to_id.resize(cell+1, NO_STABLE_ID);
         cell_to_id[cell] = id;
     }
     int index_from_id(size_t id) {
-        if (!id_to_cell.count(id)) {
+        if (id >= id_to_cell.size() || id_to_cell[id] < 0) {
             return -1;
         } else {
             assert(cell_to_id[id_to_cell[id]] == id);
@@ -937,26 +1785,35 @@ protected:
     
     voro::container *con;
     int sanity_level; // level of error checking.  define "INSANITY" for zero error checking
+    bool gl_indexed; // whether gl_build makes indexed buffers
+    bool gl_want_normals; // whether the gl buffers include normals
+    int gl_chunk_dims[3]; // the grid of chunks gl_build splits the gl buffers into
+    int type_batch_depth; // how many begin_type_batch() calls are still open
     // note: links vector MUST be kept in 1:1, ordered correspondence with the cells vector
     vector<CellConLink> links; // link cells to container
     GLBufferManager gl_computed;
     
-    // this sparse mapping gives stable ids to cells as needed (via the stable_id() function)
+    // this mapping gives stable ids to cells as needed (via the stable_id() function)
     // use stable ids to track cells externally -- cell indices will change on deletion, but stable ids remain as long as the cell does.
-    unordered_map<int, size_t> cell_to_id;
-    unordered_map<size_t, int> id_to_cell;
+    // ids are handed out in order and never reused, so both directions are plain arrays:
+    vector<size_t> cell_to_id; // id of each cell index, or NO_STABLE_ID; may be shorter than cells, if the last cells have no ids
+    vector<int> id_to_cell; // cell index of each id handed out so far, or -1 if its cell is gone
     size_t tracked_ids;
     
+    inline size_t id_of(int cell) {
+        return cell < int(cell_to_id.size()) ? cell_to_id[cell] : NO_STABLE_ID;
+    }
+    
     // this puts the old_index into the new_index and removes everything related to what used to be at the new_index
     void update_stable_id(int old_index, int new_index) {
-        if (cell_to_id.count(new_index)) {
-            auto id_to_remove = cell_to_id[new_index];
-            id_to_cell.erase(id_to_remove);
-            cell_to_id.erase(new_index);
-        }
-        if (cell_to_id.count(old_index)) {
-            auto id = cell_to_id[old_index];
-            cell_to_id.erase(old_index);
+        size_t id_to_remove = id_of(new_index);
+        if (id_to_remove != NO_STABLE_ID) {
+            id_to_cell[id_to_remove] = -1;
+            cell_to_id[new_index] = NO_STABLE_ID;
+        }
+        size_t id = id_of(old_index);
+        if (id != NO_STABLE_ID) {
+            cell_to_id[old_index] = NO_STABLE_ID;
             if (old_index!=new_index) {
                 cell_to_id[new_index] = id;
                 id_to_cell[id] = new_index;
@@ -970,50 +1827,199 @@ void GLBufferManager::compute_cell(Voro &src, int cell) { // compute caches for
     assert(cell >= 0 && cell < info.size());
     auto &link = src.links[cell];
     
-    if (!link.valid()) {
-        if (info[cell]) { clear_cell_all(*info[cell]); }
+    if (link.valid()) {
+        computed.ok = src.con->compute_cell(vorocell, link.ijk, link.q);
+        if (computed.ok) {
+            computed.take(vorocell, src.cells[cell].pos);
+        }
+    }
+    place_cell(src, cell, computed);
+}
+
+void GLBufferManager::place_cell(Voro &src, int cell, const ComputedCell &computed) {
+    if (!src.links[cell].valid()) {
+        if (info[cell].live) { clear_cell_all(info[cell]); }
         return;
     }
     CellToTris &c = get_clean_cell(cell);
-    if (src.con->compute_cell(vorocell, link.ijk, link.q)) {
-        c.cache.create(src.cells[cell].pos, vorocell);
+    if (computed.ok) {
+        create_cache(c, computed);
         
         add_cell_tris(src, cell, c);
+    } else {
+        clear_cell_all(c);
     }
     update_site(src, cell);
 }
 
-void GLBufferManager::compute_all(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors) {
+#ifdef BUILD_WITH_THREADS
+// hands the cells of each batch of a compute_cells() call to the worker threads in order, and their computed cells back to the calling thread in the same order;
+// a worker only takes a cell while fewer than BUILD_CHUNK_CELLS computed cells are waiting to be placed, and waits for the next batch until the queue is closed
+struct CellComputeQueue {
+    const vector<int> *cells; // the batch of cells to compute
+    size_t count; // how many cells there are in the batch
+    vector<ComputedCell> slots; // ring of computed cells: the i'th cell goes in slot i % slots.size()
+    vector<char> done; // whether each slot holds a computed cell that hasn't been placed yet
+    size_t next, placed; // the next cell to hand out, and to place
+    bool closed; // whether there are no more batches
+    mutex m;
+    condition_variable ready, space;
+    
+    CellComputeQueue(const vector<int> &first, size_t slot_count) : cells(&first), count(first.size()), slots(slot_count), done(slot_count, 0), next(0), placed(0), closed(false) {}
+    
+    bool take(size_t &i, int &cell) { // for workers: hands out the next cell to compute, or returns false once the queue is closed
+        unique_lock<mutex> g(m);
+        while (!closed && (next >= count || next >= placed + slots.size())) {
+            space.wait(g);
+        }
+        if (next >= count) return false;
+        i = next++;
+        cell = (*cells)[i];
+        return true;
+    }
+    void finish(size_t i) { // for workers: marks the i'th cell computed
+        {
+            lock_guard<mutex> g(m);
+            done[i % slots.size()] = 1;
+        }
+        ready.notify_one();
+    }
+    ComputedCell &wait_next() { // for the calling thread: waits for the next cell to place
+        unique_lock<mutex> g(m);
+        while (!done[placed % slots.size()]) {
+            ready.wait(g);
+        }
+        return slots[placed % slots.size()];
+    }
+    void advance() { // for the calling thread: frees the slot of the cell just placed
+        {
+            lock_guard<mutex> g(m);
+            done[placed % slots.size()] = 0;
+            placed++;
+        }
+        space.notify_all();
+    }
+    void start(const vector<int> &batch) { // for the calling thread, once every cell of the last batch is placed: hands out a new batch
+        {
+            lock_guard<mutex> g(m);
+            cells = &batch;
+            count = batch.size();
+            next = placed = 0;
+        }
+        space.notify_all();
+    }
+    void close() { // for the calling thread, once every cell is placed: lets the workers return
+        {
+            lock_guard<mutex> g(m);
+            closed = true;
+        }
+        space.notify_all();
+    }
+};
+#endif
+
+// adds to around the neighbors of the given cells that aren't live and aren't in around yet
+void GLBufferManager::gather_neighbors(const vector<int> &cells, vector<int> &around) {
+    vector<char> queued(info.size(), 0);
+    for (int i : cells) {
+        if (info[i].live) {
+            for (auto ni : info[i].cache.neighbors) {
+                if (ni >= 0 && !info[ni].live && !queued[ni]) {
+                    queued[ni] = 1;
+                    around.push_back(ni);
+                }
+            }
+        }
+    }
+}
+
+// voro++ only reads the container while computing a cell, so worker threads compute the cells with their own voro_compute and voronoicell, while
+// this thread places them into the pools and buffers, in order, so the result is the same as calling compute_cell on each.
+// with and_neighbors, the neighbors that the cells leave unbuilt are computed next by the same workers, as one more batch
+void GLBufferManager::compute_cells(Voro &src, const vector<int> &cells, bool and_neighbors) {
+    vector<int> around;
+#ifdef BUILD_WITH_THREADS
+    int workers = BUILD_THREADS > 0 ? BUILD_THREADS : voro::voro_thread_count(0);
+#ifdef __EMSCRIPTEN_PTHREADS__
+    workers = min(workers, BUILD_PTHREAD_POOL_SIZE);
+#endif
+    if (workers > 1 && cells.size() > 1) {
+        CellComputeQueue queue(cells, and_neighbors ? BUILD_CHUNK_CELLS : min(cells.size(), size_t(BUILD_CHUNK_CELLS)));
+        auto run = [&](int t) {
+            if (t == 0) { // the calling thread
+                const vector<int> *batch = &cells;
+                for (;;) {
+                    for (size_t i=0; i<batch->size(); i++) {
+                        place_cell(src, (*batch)[i], queue.wait_next());
+                        queue.advance();
+                    }
+                    if (batch == &around || !and_neighbors) break;
+                    gather_neighbors(cells, around);
+                    if (around.empty()) break;
+                    batch = &around;
+                    queue.start(around);
+                }
+                queue.close();
+                return;
+            }
+            voro::par_voro_compute<voro::container> vc(*src.con);
+            voro::voronoicell_neighbor c;
+            size_t i;
+            int cell;
+            while (queue.take(i, cell)) {
+                auto &link = src.links[cell];
+                ComputedCell &computed = queue.slots[i % queue.slots.size()];
+                computed.ok = link.valid() && vc.compute_cell(c, link.ijk, link.q);
+                if (computed.ok) {
+                    computed.take(c, src.cells[cell].pos);
+                }
+                queue.finish(i);
+            }
+        };
+        voro::voro_run_threads(workers+1, run);
+        return;
+    }
+#endif
+    for (int cell : cells) {
+        compute_cell(src, cell);
+    }
+    if (and_neighbors) {
+        gather_neighbors(cells, around);
+        for (int cell : around) {
+            compute_cell(src, cell);
+        }
+    }
+}
+
+void GLBufferManager::compute_all(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors, bool want_normals, bool indexed) {
     if (!src.con) {
         src.build_container();
     }
-    init(src.cells.size(), tricap, wirecap, sitescap, want_colors);
+    init(src.cells.size(), tricap, wirecap, sitescap, want_colors, want_normals, indexed);
     
     assert(src.cells.size()==src.links.size());
+    vector<int> cells(src.cells.size());
     for (size_t i=0; i < src.cells.size(); i++) {
-        compute_cell(src, i);
+        cells[i] = i;
     }
+    compute_cells(src, cells);
 }
 
-void GLBufferManager::compute_on(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors) {
+void GLBufferManager::compute_on(Voro &src, int tricap, int wirecap, int sitescap, bool want_colors, bool want_normals, bool indexed) {
     if (!src.con) {
         src.build_container();
     }
-    init(src.cells.size(), tricap, wirecap, sitescap, want_colors);
+    init(src.cells.size(), tricap, wirecap, sitescap, want_colors, want_normals, indexed);
     
     assert(src.cells.size()==src.links.size());
+    // the non-zero cells first, then all their neighbors that aren't among them
+    vector<int> cells;
     for (size_t i=0; i < src.cells.size(); i++) {
         if (src.cells[i].type != 0) {
-            compute_cell(src, i);
-            if (info[i]) {
-                for (auto ni : info[i]->cache.neighbors) {
-                    if (ni >= 0 && !info[ni]) {
-                        compute_cell(src, ni);
-                    }
-                }
-            }
+            cells.push_back(i);
         }
     }
+    compute_cells(src, cells, true);
     for (size_t i=0; i < src.cells.size(); i++) {
         update_site(src, i);
     }
@@ -1022,12 +2028,12 @@ void GLBufferManager::compute_on(Voro &src, int tricap, int wirecap, int sitesca
 
 void GLBufferManager::add_wires(Voro &src, int cell) {
     assert(cell >= 0 && cell < info.size());
-    if (!info[cell]) {
+    if (!info[cell].live) {
         compute_cell(src, cell);
-        if (!info[cell]) return; // happens if cell couldn't be computed -- e.g., if the cell is out of bounds
+        if (!info[cell].live) return; // happens if cell couldn't be computed -- e.g., if the cell is out of bounds
     }
-    const vector<int> &faces = info[cell]->cache.faces;
-    const vector<double> &vertices = info[cell]->cache.vertices;
+    const PoolRange<int> &faces = info[cell].cache.faces;
+    const PoolRange<double> &vertices = info[cell].cache.vertices;
     for (int i=0; i<faces.size(); i+=faces[i]+1) {
         int len = faces[i];
         for (int fi=0; fi<len; fi++) {
@@ -1038,28 +2044,81 @@ void GLBufferManager::add_wires(Voro &src, int cell) {
 }
 
 
-void GLBufferManager::add_cell_tris(Voro &src, int cell, CellToTris &c2t) { // assuming the cache is fine, just add the tris for it
+// assuming the cache is fine, (re)writes the tris for it into its slab, which only moves if they no longer fit
+void GLBufferManager::add_cell_tris(Voro &src, int cell, CellToTris &c2t) {
     assert(cell >= 0 && cell < info.size());
+    int chunk = chunk_at(src.cells[cell].pos);
+    if (chunk != c2t.chunk) { // the site moved to another chunk, so the tris move with it
+        clear_cell_tris(c2t);
+        c2t.chunk = chunk;
+    }
+    GLChunk &ch = chunks[chunk];
     CellCache &c = c2t.cache;
     int type = src.cells[cell].type;
-    if (type == 0) return;
+    auto draws_face = [&](int ni) {
+        int nbr = c.neighbors[ni];
+        int nbr_type = nbr < 0 ? 0 : src.cells[nbr].type;
+        return nbr_type == 0 || ADD_ALL_FACES_ALL_THE_TIME;
+    };
+    
+    int n = 0;
+    for (int i = 0, ni = 0; type != 0 && i < (int)c.faces.size(); i+=c.faces[i]+1, ni++) {
+        if (draws_face(ni)) n += c.faces[i]-2;
+    }
+    if (n == 0) {
+        clear_cell_tris(c2t);
+        return;
+    }
     glm::vec3 color = src.get_color(type);
     
+    int old_used = c2t.tri_used;
+    if (ch.reserve_tris(info, c2t, n)) {
+        old_used = 0;
+    }
+    if (indexed) { // give each vertex of the drawn faces a slot in the cell's vertex slab, then fill them in
+        c2t.vert_inds = PoolRange<int>(cache_vert_inds, c.vertices.start/3, c.vertices.size()/3);
+        c2t.vert_inds.fill(-1);
+        int nv = 0;
+        for (int i = 0, ni = 0; i < (int)c.faces.size(); i+=c.faces[i]+1, ni++) {
+            for (int j = i+1; draws_face(ni) && j < i+c.faces[i]+1; j++) {
+                if (c2t.vert_inds[c.faces[j]] < 0) c2t.vert_inds[c.faces[j]] = nv++;
+            }
+        }
+        int old_vused = c2t.vert_used;
+        if (ch.reserve_verts(info, c2t, nv)) {
+            old_vused = 0;
+        }
+        if (old_vused > nv) {
+            fill(ch.vert_cell_inds.begin() + c2t.vert_start + nv, ch.vert_cell_inds.begin() + c2t.vert_start + old_vused, -1);
+        }
+        ch.vert_slabs.use(nv - c2t.vert_used);
+        c2t.vert_used = nv;
+        for (int vi = 0; vi < (int)c2t.vert_inds.size(); vi++) {
+            if (c2t.vert_inds[vi] >= 0) {
+                c2t.vert_inds[vi] += c2t.vert_start;
+                ch.write_vert(c.vertices, vi, cell, c2t, color);
+            }
+        }
+    }
+    
+    ch.tri_slabs.use(n - c2t.tri_used);
+    c2t.tri_used = n;
+    int tri = c2t.tri_start;
     for (int i = 0, ni = 0; i < (int)c.faces.size(); i+=c.faces[i]+1, ni++) {
-        int nbr = c.neighbors[ni];
-        int nbr_type = nbr < 0 ? 0 : src.cells[nbr].type;
-
-        if (nbr_type == 0 || ADD_ALL_FACES_ALL_THE_TIME) {
+        if (draws_face(ni)) {
             // make a fan of triangles to cover the face
-            int vicount = (i+c.faces[i]+1)-(i+1);
             int vs[3] = {c.faces[i+1], 0, c.faces[i+2]};
             for (int j = i+3; j < i+c.faces[i]+1; j++) { // facev
                 vs[1] = c.faces[j];
-                add_tri(c.vertices, vs, cell, c2t, ni, color);
+                ch.write_tri(tri++, c.vertices, vs, cell, c2t, ni, color);
                 vs[2] = vs[1];
             }
         }
     }
+    ch.zero_tris(tri, c2t.tri_start + old_used);
+    if (indexed && want_normals) {
+        ch.write_vert_normals(c2t);
+    }
 }
 
 void GLBufferManager::set_cell(Voro &src, int cell, int oldtype) {
@@ -1067,19 +2126,17 @@ void GLBufferManager::set_cell(Voro &src, int cell, int oldtype) {
     if (oldtype == src.cells[cell].type) return;
     int type = src.cells[cell].type;
     
-    if (info[cell]) {
-        if (oldtype) clear_cell_tris(*info[cell]);
+    if (info[cell].live) {
         if (!ADD_ALL_FACES_ALL_THE_TIME) { // re-add neighbors faces to manage internal faces
             // (we could try to optimize this to just look at shared faces but this seems 'fast enough' for me now)
-            for (int ni : info[cell]->cache.neighbors) {
+            for (int ni : info[cell].cache.neighbors) {
                 if (ni >= 0) {
-                    if (!info[ni]) {
+                    if (!info[ni].live) {
                         compute_cell(src, ni);
                     } else {
                         update_site(src, ni);
                         if (src.cells[ni].type) {
-                            clear_cell_tris(*info[ni]);
-                            add_cell_tris(src, ni, *info[ni]);
+                            add_cell_tris(src, ni, info[ni]);
                         }
                     }
                 }
@@ -1087,19 +2144,55 @@ void GLBufferManager::set_cell(Voro &src, int cell, int oldtype) {
         }
     }
     
-    if (!info[cell]) {
+    if (!info[cell].live) {
         compute_cell(src, cell);
     } else {
-        add_cell_tris(src, cell, *info[cell]);
+        add_cell_tris(src, cell, info[cell]);
         update_site(src, cell);
     }
     
 }
 
+void GLBufferManager::flush_type_changes(Voro &src) {
+    if (!ADD_ALL_FACES_ALL_THE_TIME) { // neighbors' faces shared with changed cells may appear or vanish
+        size_t changed_count = type_changed.size();
+        for (size_t i=0; i<changed_count; i++) {
+            int cell = type_changed[i];
+            if (!info[cell].live) continue;
+            for (int ni : info[cell].cache.neighbors) {
+                if (ni >= 0 && !type_change_marks[ni]) {
+                    type_change_marks[ni] = 1;
+                    type_changed.push_back(ni);
+                }
+            }
+        }
+    }
+    for (int cell : type_changed) {
+        if (!info[cell].live) {
+            compute_cell(src, cell);
+        } else {
+            add_cell_tris(src, cell, info[cell]);
+            update_site(src, cell);
+        }
+        type_change_marks[cell] = 0;
+    }
+    type_changed.clear();
+    
+    // a good time to pack the slabs, if a big change left many of them empty
+    for (auto &ch : chunks) {
+        if (ch.tri_slabs.fragmented()) {
+            ch.compact_tris(info);
+        }
+        if (indexed && ch.vert_slabs.fragmented()) {
+            ch.compact_verts(info);
+        }
+    }
+}
+
 void GLBufferManager::recompute_neighbors(Voro &src, int cell) {
     assert(cell >= 0 && cell < info.size());
-    if (info[cell]) {
-        for (int ni : info[cell]->cache.neighbors) {
+    if (info[cell].live) {
+        for (int ni : info[cell].cache.neighbors) {
             if (ni >= 0) {
                 compute_cell(src, ni);
             }
@@ -1108,7 +2201,7 @@ void GLBufferManager::recompute_neighbors(Voro &src, int cell) {
 }
 
 void GLBufferManager::ensure_computed(Voro &src, int cell) {
-    if (*this && !src.links.empty() && !info[cell]) {
+    if (*this && !src.links.empty() && !info[cell].live) {
         compute_cell(src, cell);
     }
 }
@@ -1116,25 +2209,28 @@ void GLBufferManager::ensure_computed(Voro &src, int cell) {
 void GLBufferManager::swapnpop_cell(Voro &src, int cell, int lasti) {
     if (!(*this)) return;
     vector<int> to_recompute;
-    if (info[cell]) {
-        to_recompute = info[cell]->cache.neighbors;
-        clear_cell_all(*info[cell]); // clears everything pointing to cell
-        delete info[cell]; info[cell] = 0;
+    if (info[cell].live) {
+        to_recompute = info[cell].cache.neighbors.to_vector();
+        clear_cell_all(info[cell]); // clears everything pointing to cell
+        info[cell] = CellToTris();
     }
     
     info[cell] = info[lasti]; // overwrite cell
-    if (info[cell]) { // if the swap cell exists, fix backpointers to it
-        for (int ni : info[cell]->cache.neighbors) { // redirect neighbor backptrs
+    info[lasti] = CellToTris(); // cell owns the slabs now
+    if (info[cell].live) { // if the swap cell exists, fix backpointers to it
+        for (int ni : info[cell].cache.neighbors) { // redirect neighbor backptrs
             if (ni >= 0) {
-                for (int nii=0; info[ni] && nii < info[ni]->cache.neighbors.size(); nii++) {
-                    if (info[ni]->cache.neighbors[nii] == lasti) {
-                        info[ni]->cache.neighbors[nii] = cell;
+                for (int nii=0; info[ni].live && nii < info[ni].cache.neighbors.size(); nii++) {
+                    if (info[ni].cache.neighbors[nii] == lasti) {
+                        info[ni].cache.neighbors[nii] = cell;
                     }
                 }
             }
         }
-        for (int ti : info[cell]->tri_inds) { // redirect tri backptrs
-            cell_inds[ti] = cell;
+        GLChunk &ch = chunks[info[cell].chunk];
+        fill(ch.cell_inds.begin() + info[cell].tri_start, ch.cell_inds.begin() + info[cell].tri_start + info[cell].tri_used, cell); // redirect tri backptrs
+        for (int vi : info[cell].vert_inds) { // redirect vertex backptrs
+            if (vi >= 0) ch.vert_cell_inds[vi] = cell;
         }
     }
     for (int ni : to_recompute) { // recompute former cell neighbors
@@ -1149,22 +2245,22 @@ void GLBufferManager::swapnpop_cell(Voro &src, int cell, int lasti) {
 }
 
 void GLBufferManager::move_cell(Voro &src, int cell) {
-    if (info[cell]) {
-        for (int ni : info[cell]->cache.neighbors) { if (ni >= 0) { compute_cell(src, ni); } }
+    if (info[cell].live) {
+        for (int ni : info[cell].cache.neighbors) { if (ni >= 0) { compute_cell(src, ni); } }
     }
     compute_cell(src, cell);
     update_site(src, cell);
-    if (info[cell]) {
+    if (info[cell].live) {
         // todo: possible optimization: don't recompute a neighbor here if it was already computed above.
-        for (int ni : info[cell]->cache.neighbors) { if (ni >= 0) { compute_cell(src, ni); } }
+        for (int ni : info[cell].cache.neighbors) { if (ni >= 0) { compute_cell(src, ni); } }
     }
 }
 
 void GLBufferManager::update_site(Voro &src, int cell) {
     update_site_pos(src.cells[cell].pos, cell);
     float size = 0;
-    if (info[cell]) {
-        for (auto ni : info[cell]->cache.neighbors) {
+    if (info[cell].live) {
+        for (auto ni : info[cell].cache.neighbors) {
             if (ni >= 0) {
                 size = float(size > 0 || src.cells[ni].type > 0);
             }
@@ -1178,20 +2274,71 @@ void GLBufferManager::set_want_colors(Voro &src, bool yes_colors) {
         return; // no change
     }
     want_colors = yes_colors;
-    colors.resize(want_colors ? vertices.size() : 0);
+    for (auto &ch : chunks) {
+        ch.want_colors = want_colors;
+        ch.colors.resize(want_colors ? ch.vertices.size() : 0);
+    }
     
     update_colors(src);
+    mark_all_tris_dirty(); // the colors buffer may have moved
+}
+
+void GLBufferManager::set_want_normals(bool yes_normals) {
+    if (yes_normals == want_normals) {
+        return; // no change
+    }
+    want_normals = yes_normals;
+    for (auto &ch : chunks) {
+        ch.want_normals = want_normals;
+        ch.normals.resize(want_normals ? ch.vertices.size() : 0);
+    }
+    
+    if (want_normals && indexed) {
+        for (auto &c2t : info) {
+            if (c2t.live && c2t.tri_used > 0) {
+                chunks[c2t.chunk].write_vert_normals(c2t);
+            }
+        }
+    } else if (want_normals) {
+        for (auto &ch : chunks) {
+            for (int tri=0; tri<ch.tri_count; tri++) {
+                int cell = ch.cell_inds[tri];
+                if (cell < 0) continue;
+                const CellCache &c = info[cell].cache;
+                for (int ii=0; ii<9; ii++) {
+                    ch.normals[tri*9+ii] = c.face_normals[ch.tri_faces[tri]*3+ii%3];
+                }
+            }
+        }
+    }
+    mark_all_tris_dirty(); // the normals buffer may have moved
 }
 
 void GLBufferManager::update_colors(Voro &src) {
-    if (want_colors) { // fill in the current colors
-        for (size_t i=0; i<tri_count; i++) {
-            int cell = cell_inds[i];
-            int nbr = vert2cell_neighbor(i*3);
-            int type_src = nbr > 0 && src.cells[nbr].type > src.cells[cell].type ? nbr : cell;
-            glm::vec3 c = src.get_color(src.cells[type_src].type);
-            for (size_t ii=0; ii<9; ii++) {
-                colors[i*9+ii] = c[ii%3];
+    if (!want_colors) {
+        return;
+    }
+    for (auto &ch : chunks) {
+        ch.dirty_tris.add(0, ch.tri_count);
+        ch.dirty_verts.add(0, ch.vert_count);
+        if (indexed) { // vertices aren't shared between cells, so they just take their cell's color
+            for (int i=0; i<ch.vert_count; i++) {
+                if (ch.vert_cell_inds[i] < 0) continue;
+                glm::vec3 c = src.get_color(src.cells[ch.vert_cell_inds[i]].type);
+                for (int ii=0; ii<3; ii++) {
+                    ch.colors[i*3+ii] = c[ii];
+                }
+            }
+        } else { // fill in the current colors
+            for (size_t i=0; i<ch.tri_count; i++) {
+                int cell = ch.cell_inds[i];
+                if (cell < 0) continue;
+                int nbr = vert2cell_neighbor(ch.id, i*3);
+                int type_src = nbr > 0 && src.cells[nbr].type > src.cells[cell].type ? nbr : cell;
+                glm::vec3 c = src.get_color(src.cells[type_src].type);
+                for (size_t ii=0; ii<9; ii++) {
+                    ch.colors[i*9+ii] = c[ii%3];
+                }
             }
         }
     }
@@ -1200,8 +2347,8 @@ void GLBufferManager::update_colors(Voro &src) {
 void GLBufferManager::move_cells(Voro &src, const unordered_set<int> &cells) {
     unordered_set<int> computed;
     for (int cell : cells) {
-        if (info[cell]) {
-            for (int ni : info[cell]->cache.neighbors) { if (ni >= 0 && !cells.count(ni) && !computed.count(ni)) { compute_cell(src, ni); computed.insert(ni); } }
+        if (info[cell].live) {
+            for (int ni : info[cell].cache.neighbors) { if (ni >= 0 && !cells.count(ni) && !computed.count(ni)) { compute_cell(src, ni); computed.insert(ni); } }
         }
     }
     for (int cell : cells) {
@@ -1210,8 +2357,8 @@ void GLBufferManager::move_cells(Voro &src, const unordered_set<int> &cells) {
         computed.insert(cell);
     }
     for (int cell : cells) {
-        if (info[cell]) {
-            for (int ni : info[cell]->cache.neighbors) { if (ni >= 0 && !cells.count(ni) && !computed.count(ni)) { compute_cell(src, ni); computed.insert(ni); } }
+        if (info[cell].live) {
+            for (int ni : info[cell].cache.neighbors) { if (ni >= 0 && !cells.count(ni) && !computed.count(ni)) { compute_cell(src, ni); computed.insert(ni); } }
         }
     }
 }
@@ -1219,7 +2366,7 @@ void GLBufferManager::move_cells(Voro &src, const unordered_set<int> &cells) {
 void GLBufferManager::add_cell(Voro &src) {
     if (!(*this)) return;
     int id = (int)info.size();
-    info.push_back(0);
+    info.push_back(CellToTris());
     if (info.size() > max_sites) {
         max_sites *= 2;
         resize_sites_buffers();
@@ -1252,6 +2399,29 @@ EMSCRIPTEN_BINDINGS(voro) {
     .function("build_container", &Voro::build_container)
     .function("gl_build", &Voro::gl_build)
     .function("gl_vertices", &Voro::gl_vertices)
+    .function("gl_indices", &Voro::gl_indices)
+    .function("gl_vert_count", &Voro::gl_vert_count)
+    .function("gl_max_verts", &Voro::gl_max_verts)
+    .function("set_gl_indexed", &Voro::set_gl_indexed)
+    .function("gl_is_indexed", &Voro::gl_is_indexed)
+    .function("set_gl_chunks", &Voro::set_gl_chunks)
+    .function("gl_chunk_count", &Voro::gl_chunk_count)
+    .function("gl_chunk_vertices", &Voro::gl_chunk_vertices)
+    .function("gl_chunk_colors", &Voro::gl_chunk_colors)
+    .function("gl_chunk_normals", &Voro::gl_chunk_normals)
+    .function("gl_chunk_indices", &Voro::gl_chunk_indices)
+    .function("gl_chunk_tri_count", &Voro::gl_chunk_tri_count)
+    .function("gl_chunk_max_tris", &Voro::gl_chunk_max_tris)
+    .function("gl_chunk_vert_count", &Voro::gl_chunk_vert_count)
+    .function("gl_chunk_max_verts", &Voro::gl_chunk_max_verts)
+    .function("gl_chunk_bounds", &Voro::gl_chunk_bounds)
+    .function("gl_dirty_chunks", &Voro::gl_dirty_chunks)
+    .function("gl_chunk_dirty_ranges", &Voro::gl_chunk_dirty_ranges)
+    .function("set_gl_normals", &Voro::set_gl_normals)
+    .function("has_normals", &Voro::has_normals)
+    .function("gl_normals", &Voro::gl_normals)
+    .function("gl_dirty_ranges", &Voro::gl_dirty_ranges)
+    .function("gl_clear_dirty", &Voro::gl_clear_dirty)
     .function("gl_tri_count", &Voro::gl_tri_count)
     .function("gl_max_tris", &Voro::gl_max_tris)
     .function("gl_cell_sites", &Voro::gl_cell_sites)
@@ -1265,11 +2435,15 @@ EMSCRIPTEN_BINDINGS(voro) {
     .function("toggle_cell", &Voro::toggle_cell)
     .function("cell_neighbor_from_vertex", &Voro::cell_neighbor_from_vertex)
     .function("cell_from_vertex", &Voro::cell_from_vertex)
+    .function("cell_neighbor_from_chunk_vertex", &Voro::cell_neighbor_from_chunk_vertex)
+    .function("cell_from_chunk_vertex", &Voro::cell_from_chunk_vertex)
     .function("delete_cell", &Voro::delete_cell)
     .function("move_cell", &Voro::move_cell)
     .function("move_cells", &Voro::move_cells)
     .function("set_cell", &Voro::set_cell)
     .function("set_all", &Voro::set_all)
+    .function("begin_type_batch", &Voro::begin_type_batch)
+    .function("end_type_batch", &Voro::end_type_batch)
     .function("sanity", &Voro::sanity)
     .function("set_sanity_level", &Voro::set_sanity_level)
     .function("set_fill", &Voro::set_fill)